@@ -0,0 +1,120 @@
+/**
+ * Allocation Tracker
+ * ==================
+ * --alloc: global operator new/delete count allocations and bytes into
+ * per-thread counters, and live bytes into one process-wide counter.
+ * PerfPhase snapshots both, so every phase reports what its own thread
+ * allocated and the process heap's high-water mark while it ran. Live
+ * bytes have to be process-wide: a producer whose packets are freed by
+ * the consumer would otherwise never see a free, and its "peak" would
+ * only be the total it allocated. Frees are sized with
+ * malloc_usable_size so they cancel the allocation exactly.
+ * When --alloc is off each new/delete pays one relaxed load.
+ *
+ * This header defines the replacement operator new/delete, so include
+ * it from exactly one translation unit per executable.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#ifdef __linux__
+#include <malloc.h>
+#include <sys/resource.h>
+#endif
+
+struct AllocCounters {
+    uint64_t allocs = 0;
+    uint64_t bytes = 0;   // allocated, not net
+};
+
+inline std::atomic<bool> g_alloc_tracking{false};
+inline thread_local AllocCounters t_alloc;
+inline std::atomic<int64_t> g_alloc_live{0};  // allocated - freed, all threads
+inline std::atomic<int64_t> g_alloc_peak{0};  // high-water mark of g_alloc_live
+
+inline void raiseAllocPeak(int64_t live) {
+    int64_t peak = g_alloc_peak.load(std::memory_order_relaxed);
+    while (live > peak &&
+           !g_alloc_peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+inline size_t allocUsableSize(void* p, size_t requested) {
+#ifdef __linux__
+    (void)requested;
+    return malloc_usable_size(p);
+#else
+    (void)p;
+    return requested;
+#endif
+}
+
+// The C allocator stays out of line: once std::free is inlined into
+// operator delete, GCC pairs it with the operator new at each call site
+// and warns (-Wmismatched-new-delete) although the pair is ours.
+[[gnu::noinline]] inline void* rawAlloc(size_t n, size_t align) {
+    if (align <= alignof(std::max_align_t)) return std::malloc(n ? n : 1);
+    size_t size = (std::max<size_t>(n, 1) + align - 1) / align * align;
+    return std::aligned_alloc(align, size);
+}
+
+[[gnu::noinline]] inline void rawFree(void* p) noexcept { std::free(p); }
+
+inline void* trackedAlloc(size_t n, size_t align = alignof(std::max_align_t)) {
+    void* p = rawAlloc(n, align);
+    if (!p) throw std::bad_alloc();
+    if (g_alloc_tracking.load(std::memory_order_relaxed)) {
+        AllocCounters& c = t_alloc;
+        auto size = static_cast<int64_t>(allocUsableSize(p, n));
+        c.allocs++;
+        c.bytes += static_cast<uint64_t>(size);
+        raiseAllocPeak(g_alloc_live.fetch_add(size, std::memory_order_relaxed) + size);
+    }
+    return p;
+}
+
+inline void trackedFree(void* p) noexcept {
+    if (p && g_alloc_tracking.load(std::memory_order_relaxed)) {
+        g_alloc_live.fetch_sub(static_cast<int64_t>(allocUsableSize(p, 0)),
+                               std::memory_order_relaxed);
+    }
+    rawFree(p);
+}
+
+void* operator new(std::size_t n) { return trackedAlloc(n); }
+void* operator new[](std::size_t n) { return trackedAlloc(n); }
+
+// Aligned forms too: std::pmr::new_delete_resource allocates through them
+void* operator new(std::size_t n, std::align_val_t al) {
+    return trackedAlloc(n, static_cast<size_t>(al));
+}
+void* operator new[](std::size_t n, std::align_val_t al) {
+    return trackedAlloc(n, static_cast<size_t>(al));
+}
+
+void operator delete(void* p) noexcept { trackedFree(p); }
+void operator delete[](void* p) noexcept { trackedFree(p); }
+void operator delete(void* p, std::size_t) noexcept { trackedFree(p); }
+void operator delete[](void* p, std::size_t) noexcept { trackedFree(p); }
+void operator delete(void* p, std::align_val_t) noexcept { trackedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { trackedFree(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { trackedFree(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { trackedFree(p); }
+
+// Process peak resident set so far, in KiB
+inline long peakRssKb() {
+#ifdef __linux__
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+#else
+    return 0;
+#endif
+}
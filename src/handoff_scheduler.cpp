@@ -13,23 +13,40 @@
  *   A user terminal moves through multiple satellite coverage zones.
  *   Each satellite has a visibility window with varying signal quality.
  *   Schedule handoffs to:
- *     1. Maximize minimum signal quality (worst-case guarantee)
- *     2. Ensure ≥ OVERLAP_SECONDS of overlap for seamless transition
- *     3. Minimize total number of handoffs
+ *     1. Cover the longest span of the horizon without a gap
+ *     2. Among equally long chains, maximize the minimum signal quality
+ *        (worst-case guarantee)
+ *     3. Ensure ≥ OVERLAP_SECONDS of overlap for seamless transition
  *
  * This is the exact problem Starlink ground software solves every
  * few seconds for every active user terminal.
  */
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <numeric>
 #include <optional>
 #include <random>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "alloc_tracker.h"
+#include "perf_counters.h"
+
 // ============================================================
 // Types
 // ============================================================
@@ -87,14 +104,129 @@ public:
      * Algorithm:
      *   1. Sort windows by start time
      *   2. For each window, find compatible next windows (sufficient overlap)
-     *   3. Use DP to find schedule maximizing minimum signal quality
+     *   3. Use DP to find the chain covering the longest span, breaking
+     *      ties by the best minimum signal quality
      *   4. Backtrack to extract the optimal schedule
      *
+     * Coverage comes first: ranking by minimum signal alone always picks
+     * the single strongest pass, since a handoff can never raise the
+     * minimum, and leaves the terminal dark for the rest of the horizon.
+     *
+     * Coverage and gap time are counted up to `horizon` only: the last
+     * pass usually runs on past the end of the simulated period.
+     *
      * Time complexity: O(N² log N) where N = number of visibility windows
      */
-    static ScheduleResult schedule(std::vector<VisibilityWindow> windows) {
+    static ScheduleResult schedule(std::vector<VisibilityWindow> windows,
+                                   double horizon = INFINITY) {
         if (windows.empty()) return {{}, 0, 0, 0, 0};
 
+        TransitionGraph graph = buildGraph(std::move(windows));
+        double min_signal = 0.0;
+        auto selected = bestChain(graph, std::vector<Busy>(graph.windows.size()),
+                                  min_signal);
+        return describeChain(graph.windows, selected, min_signal, horizon);
+    }
+
+    struct ServingSegment {
+        int satellite_id;
+        double start_time;
+        double end_time;
+    };
+
+    /**
+     * The primary chain plus up to k-1 alternates, each flattened into the
+     * satellite that serves each instant.
+     */
+    struct BackupSchedule {
+        std::vector<ScheduleResult> chains;               // [0] = primary
+        std::vector<std::vector<ServingSegment>> serving;  // per chain, by time
+
+        /**
+         * Failover as a lookup: the first chain whose satellite at time t
+         * is not the failed one. Returns nullptr if no chain covers t.
+         */
+        const ServingSegment* failover(int failed_satellite, double t) const {
+            for (const auto& segments : serving) {
+                auto it = std::upper_bound(
+                    segments.begin(), segments.end(), t,
+                    [](double v, const ServingSegment& s) { return v < s.start_time; });
+                if (it == segments.begin()) continue;
+                --it;
+                if (t <= it->end_time && it->satellite_id != failed_satellite) return &*it;
+            }
+            return nullptr;
+        }
+    };
+
+    /**
+     * Schedule a primary chain and k-1 link-disjoint alternates.
+     *
+     * Alternate r reruns the DP with each satellite excluded only while
+     * chains 0..r-1 are served by it: a pass splits into the stretches
+     * before and after those serving segments, and an alternate may use
+     * them. So at no instant does it depend on a satellite an earlier
+     * chain is using, yet it can still take over a pass the primary is
+     * about to enter or has just left.
+     * The candidate handoffs and their crossover searches — the bulk of
+     * the O(N²) work — are computed once and shared by every chain.
+     */
+    static BackupSchedule scheduleWithBackups(std::vector<VisibilityWindow> windows,
+                                              int k, double horizon = INFINITY) {
+        BackupSchedule backups;
+        if (windows.empty() || k < 1) return backups;
+
+        TransitionGraph graph = buildGraph(std::move(windows));
+        std::vector<Busy> busy(graph.windows.size());
+        for (int r = 0; r < k; r++) {
+            double min_signal = 0.0;
+            auto selected = bestChain(graph, busy, min_signal);
+            if (selected.empty()) break;
+            backups.chains.push_back(
+                describeChain(graph.windows, selected, min_signal, horizon));
+
+            const ScheduleResult& chain = backups.chains.back();
+            std::vector<ServingSegment> segments;
+            for (size_t s = 0; s < selected.size(); s++) {
+                const Piece& piece = selected[s];
+                double from = s == 0 ? piece.start_time : chain.handoffs[s - 1].handoff_time;
+                double to = s + 1 == selected.size() ? piece.end_time
+                                                     : chain.handoffs[s].handoff_time;
+                segments.push_back({graph.windows[piece.window].satellite_id, from, to});
+                Busy& b = busy[piece.window];
+                b.insert(std::upper_bound(b.begin(), b.end(), std::make_pair(from, to)),
+                         {from, to});
+            }
+            backups.serving.push_back(std::move(segments));
+        }
+        return backups;
+    }
+
+private:
+    struct Transition {
+        int from;
+        double time;    // optimal handoff time
+        double signal;  // at that time
+    };
+
+    // Per window, the (start, end) times earlier chains serve from it
+    using Busy = std::vector<std::pair<double, double>>;
+
+    // The stretch of a window a chain serves from: the whole pass unless
+    // an earlier chain is using the satellite for part of it
+    struct Piece {
+        int window;
+        double start_time;
+        double end_time;
+    };
+
+    // Windows sorted by start, and for each one the windows it can take over from
+    struct TransitionGraph {
+        std::vector<VisibilityWindow> windows;
+        std::vector<std::vector<Transition>> into;
+    };
+
+    static TransitionGraph buildGraph(std::vector<VisibilityWindow> windows) {
         // Sort by start time
         std::sort(windows.begin(), windows.end(),
                   [](const auto& a, const auto& b) {
@@ -102,17 +234,7 @@ public:
                   });
 
         int n = static_cast<int>(windows.size());
-
-        // dp[i] = best minimum signal quality achievable ending at window i
-        std::vector<double> dp(n, 0.0);
-        std::vector<int> parent(n, -1);
-
-        // Base case: each window alone has its peak signal quality
-        for (int i = 0; i < n; i++) {
-            dp[i] = windows[i].peak_signal_quality;
-        }
-
-        // DP transition: try extending from each previous window
+        std::vector<std::vector<Transition>> into(n);
         for (int i = 1; i < n; i++) {
             for (int j = 0; j < i; j++) {
                 // Check if window j can hand off to window i
@@ -131,42 +253,112 @@ public:
                     windows[i].signalAt(best_handoff_time));
 
                 if (signal_at_handoff < MIN_SIGNAL_DB) continue;  // Too weak
+                into[i].push_back({j, best_handoff_time, signal_at_handoff});
+            }
+        }
+        return {std::move(windows), std::move(into)};
+    }
 
-                // min_signal through this path
-                double path_signal = std::min(dp[j], signal_at_handoff);
+    // DP over the free pieces of every window; returns the chosen chain
+    static std::vector<Piece> bestChain(const TransitionGraph& graph,
+                                        const std::vector<Busy>& busy,
+                                        double& min_signal) {
+        const auto& windows = graph.windows;
+        int n = static_cast<int>(windows.size());
 
-                if (path_signal > dp[i]) {
-                    dp[i] = path_signal;
-                    parent[i] = j;
+        // Split each window around the times it is busy, in window order so
+        // every transition source precedes its target
+        std::vector<Piece> pieces;
+        std::vector<int> first_piece(n + 1, 0);
+        for (int i = 0; i < n; i++) {
+            first_piece[i] = static_cast<int>(pieces.size());
+            double from = windows[i].start_time;
+            for (const auto& [busy_from, busy_to] : busy[i]) {
+                if (busy_from > from) pieces.push_back({i, from, busy_from});
+                from = std::max(from, busy_to);
+            }
+            if (from < windows[i].end_time) {
+                pieces.push_back({i, from, windows[i].end_time});
+            }
+        }
+        first_piece[n] = static_cast<int>(pieces.size());
+        auto pieceAt = [&](int i, double t) {
+            for (int p = first_piece[i]; p < first_piece[i + 1]; p++) {
+                if (pieces[p].start_time <= t && t <= pieces[p].end_time) return p;
+            }
+            return -1;
+        };
+        int m = static_cast<int>(pieces.size());
+
+        // dp[p] = best minimum signal quality of the chain ending at piece p,
+        // chain_start[p] = when that chain's first piece opens
+        std::vector<double> dp(m, 0.0);
+        std::vector<double> chain_start(m, 0.0);
+        std::vector<int> parent(m, -1);
+
+        // Base case: each piece alone has its window's peak signal quality
+        for (int p = 0; p < m; p++) {
+            dp[p] = windows[pieces[p].window].peak_signal_quality;
+            chain_start[p] = pieces[p].start_time;
+        }
+
+        // DP transition: try extending from each previous window, through
+        // whichever of its pieces is free at the handoff
+        for (int q = 0; q < m; q++) {
+            const Piece& to = pieces[q];
+            for (const auto& tr : graph.into[to.window]) {
+                if (tr.time < to.start_time || tr.time > to.end_time) continue;
+                int p = pieceAt(tr.from, tr.time);
+                if (p < 0) continue;
+
+                // min_signal through this path; longer coverage wins first
+                double path_signal = std::min(dp[p], tr.signal);
+
+                if (chain_start[p] < chain_start[q] ||
+                    (chain_start[p] == chain_start[q] && path_signal > dp[q])) {
+                    dp[q] = path_signal;
+                    chain_start[q] = chain_start[p];
+                    parent[q] = p;
                 }
             }
         }
 
-        // Find the best ending window
-        int best_end = 0;
-        for (int i = 1; i < n; i++) {
-            if (dp[i] > dp[best_end]) best_end = i;
+        // Find the best ending piece: longest span, then strongest
+        int best_end = -1;
+        auto span = [&](int p) { return pieces[p].end_time - chain_start[p]; };
+        for (int p = 0; p < m; p++) {
+            if (best_end < 0 || span(p) > span(best_end) ||
+                (span(p) == span(best_end) && dp[p] > dp[best_end])) {
+                best_end = p;
+            }
         }
 
         // Backtrack to find the schedule
-        std::vector<int> selected;
+        std::vector<Piece> selected;
+        if (best_end < 0) return selected;
+        min_signal = dp[best_end];
         int cur = best_end;
         while (cur != -1) {
-            selected.push_back(cur);
+            selected.push_back(pieces[cur]);
             cur = parent[cur];
         }
         std::reverse(selected.begin(), selected.end());
+        return selected;
+    }
 
+    static ScheduleResult describeChain(const std::vector<VisibilityWindow>& windows,
+                                        const std::vector<Piece>& selected,
+                                        double min_signal, double horizon) {
         // Build handoff decisions
         ScheduleResult result;
-        result.min_signal_quality = dp[best_end];
+        result.min_signal_quality = min_signal;
         result.num_handoffs = static_cast<int>(selected.size()) - 1;
         result.total_coverage_time = 0;
         result.total_gap_time = 0;
 
         for (int k = 0; k + 1 < static_cast<int>(selected.size()); k++) {
-            int j = selected[k];
-            int i = selected[k + 1];
+            int j = selected[k].window;
+            int i = selected[k + 1].window;
 
             double handoff_time = findOptimalHandoffTime(windows[j], windows[i]);
             double overlap = windows[j].end_time - windows[i].start_time;
@@ -179,38 +371,28 @@ public:
                 std::min(windows[j].signalAt(handoff_time),
                          windows[i].signalAt(handoff_time))
             });
-
-            // Coverage time for window j (up to handoff)
-            if (k == 0) {
-                result.total_coverage_time += handoff_time - windows[j].start_time;
-            } else {
-                double prev_handoff = result.handoffs[k - 1].handoff_time;
-                result.total_coverage_time += handoff_time - prev_handoff;
-            }
         }
 
-        // Add coverage for last window
-        if (!selected.empty()) {
-            int last = selected.back();
-            if (result.handoffs.empty()) {
-                result.total_coverage_time = windows[last].duration();
-            } else {
-                result.total_coverage_time +=
-                    windows[last].end_time - result.handoffs.back().handoff_time;
-            }
+        // Coverage: each window serves from its entry handoff to its exit
+        // handoff, clipped to the horizon
+        for (size_t s = 0; s < selected.size(); s++) {
+            const Piece& piece = selected[s];
+            double from = s == 0 ? piece.start_time : result.handoffs[s - 1].handoff_time;
+            double to = s + 1 == selected.size() ? piece.end_time
+                                                 : result.handoffs[s].handoff_time;
+            result.total_coverage_time += std::max(0.0, std::min(to, horizon) - from);
         }
 
         // Gap time = total timeline - coverage time
         if (!selected.empty()) {
-            double total_time = windows[selected.back()].end_time -
-                               windows[selected.front()].start_time;
-            result.total_gap_time = total_time - result.total_coverage_time;
+            double total_time = std::min(selected.back().end_time, horizon) -
+                                selected.front().start_time;
+            result.total_gap_time = std::max(0.0, total_time - result.total_coverage_time);
         }
 
         return result;
     }
 
-private:
     /**
      * Find the optimal handoff time between two overlapping windows.
      * The optimal point is where the weaker signal is maximized —
@@ -284,20 +466,1119 @@ std::vector<VisibilityWindow> generateWindows(int num_satellites,
 }
 
 // ============================================================
-// Main
+// Terminal Fleet: Per-Cell Schedule Cache
 // ============================================================
+// Terminals a few kilometres apart see the same passes, so a fleet front
+// end quantizes each terminal into a geographic cell and computes the
+// windows and the optimal schedule once per (cell, horizon). Terminals
+// in the same cell receive the same immutable schedule object.
 
-int main() {
-    std::cout << "╔══════════════════════════════════════════════╗\n";
-    std::cout << "║  Satellite Handoff Scheduler                ║\n";
-    std::cout << "║  Stuart Ray — Starlink Interview Prep       ║\n";
-    std::cout << "╚══════════════════════════════════════════════╝\n\n";
+struct Terminal {
+    int id;
+    double lat_deg;
+    double lon_deg;
+};
+
+struct CellKey {
+    int32_t lat_idx;
+    int32_t lon_idx;
+    int64_t horizon_sec;
+
+    bool operator==(const CellKey& o) const {
+        return lat_idx == o.lat_idx && lon_idx == o.lon_idx &&
+               horizon_sec == o.horizon_sec;
+    }
+};
+
+// MurmurHash3 64-bit finalizer
+inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+struct CellKeyHash {
+    size_t operator()(const CellKey& k) const {
+        uint64_t cell = (static_cast<uint64_t>(static_cast<uint32_t>(k.lat_idx)) << 32) |
+                        static_cast<uint32_t>(k.lon_idx);
+        return mix64(cell ^ mix64(static_cast<uint64_t>(k.horizon_sec)));
+    }
+};
+
+struct CellSchedule {
+    std::vector<VisibilityWindow> windows;
+    ScheduleResult result;
+};
+
+class ScheduleCache {
+public:
+    static constexpr double KM_PER_DEG_LAT = 111.32;
+
+    ScheduleCache(double cell_km, int num_satellites, unsigned seed)
+        : cell_deg_(cell_km / KM_PER_DEG_LAT),
+          num_satellites_(num_satellites),
+          seed_(seed) {}
+
+    // Equal-area-ish grid: longitude cells widen toward the poles so a
+    // cell stays about cell_km across at every latitude
+    CellKey cellOf(const Terminal& t, double horizon_sec) const {
+        auto lat_idx = static_cast<int32_t>(std::floor(t.lat_deg / cell_deg_));
+        double lat_center = (lat_idx + 0.5) * cell_deg_;
+        double lon_deg = cell_deg_ /
+            std::max(0.01, std::cos(lat_center * M_PI / 180.0));
+        auto lon_idx = static_cast<int32_t>(std::floor((t.lon_deg + 180.0) / lon_deg));
+        return {lat_idx, lon_idx, static_cast<int64_t>(std::llround(horizon_sec))};
+    }
 
+    // Every terminal in a cell shares the returned schedule
+    std::shared_ptr<const CellSchedule> scheduleFor(const Terminal& t,
+                                                    double horizon_sec) {
+        CellKey key = cellOf(t, horizon_sec);
+        auto it = cache_.find(key);
+        if (it != cache_.end()) {
+            hits_++;
+            return it->second;
+        }
+        misses_++;
+        auto start = std::chrono::steady_clock::now();
+        auto cell = std::make_shared<CellSchedule>();
+        cell->windows = windowsForCell(key, horizon_sec);
+        cell->result = HandoffScheduler::schedule(cell->windows, horizon_sec);
+        compute_sec_ += std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        std::shared_ptr<const CellSchedule> shared = std::move(cell);
+        cache_.emplace(key, shared);
+        return shared;
+    }
+
+    // The passes over a cell; stands in for propagating the constellation
+    // against the cell centre, and is what an uncached front end would
+    // compute for each terminal
+    std::vector<VisibilityWindow> windowsForCell(const CellKey& key,
+                                                 double horizon_sec) const {
+        unsigned cell_seed = static_cast<unsigned>(
+            mix64(CellKeyHash{}(key) ^ seed_));
+        return generateWindows(num_satellites_, horizon_sec, cell_seed);
+    }
+
+    uint64_t hits() const { return hits_; }
+    uint64_t misses() const { return misses_; }
+    size_t cells() const { return cache_.size(); }
+    double computeSec() const { return compute_sec_; }
+
+private:
+    double cell_deg_;
+    int num_satellites_;
+    unsigned seed_;
+    std::unordered_map<CellKey, std::shared_ptr<const CellSchedule>, CellKeyHash> cache_;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    double compute_sec_ = 0.0;
+};
+
+/**
+ * Terminal positions shaped like a subscriber base: most cluster around
+ * population centres (Gaussian, ~15 km sigma, so suburbs share cells
+ * with their neighbours) and the rest are scattered rural sites.
+ */
+std::vector<Terminal> generateFleet(int num_terminals, unsigned seed) {
+    struct City {
+        double lat, lon, weight;
+    };
+    static const City CITIES[] = {
+        {47.61, -122.33, 3}, {40.71, -74.01, 8}, {34.05, -118.24, 6},
+        {51.51, -0.13, 5},   {48.86, 2.35, 4},   {-33.87, 151.21, 3},
+        {-23.55, -46.63, 5}, {19.43, -99.13, 4}, {35.68, 139.69, 6},
+        {-1.29, 36.82, 2},   {59.33, 18.07, 1},  {64.84, -147.72, 1},
+    };
+    constexpr double RURAL_FRACTION = 0.15;
+    constexpr double CITY_SIGMA_DEG = 0.15;
+
+    std::mt19937 rng(seed);
+    std::vector<double> weights;
+    for (const auto& c : CITIES) weights.push_back(c.weight);
+    std::discrete_distribution<int> city_dist(weights.begin(), weights.end());
+    std::normal_distribution<double> spread(0.0, CITY_SIGMA_DEG);
+    std::uniform_real_distribution<double> prob(0.0, 1.0);
+    std::uniform_real_distribution<double> rural_lat(-56.0, 56.0);
+    std::uniform_real_distribution<double> rural_lon(-180.0, 180.0);
+
+    std::vector<Terminal> fleet;
+    fleet.reserve(num_terminals);
+    for (int i = 0; i < num_terminals; i++) {
+        if (prob(rng) < RURAL_FRACTION) {
+            fleet.push_back({i, rural_lat(rng), rural_lon(rng)});
+        } else {
+            const City& c = CITIES[city_dist(rng)];
+            fleet.push_back({i, c.lat + spread(rng), c.lon + spread(rng)});
+        }
+    }
+    return fleet;
+}
+
+/**
+ * Writes the windows and the chosen handoffs as CSV, one record per line:
+ *   window,<sat>,<start_s>,<end_s>,<peak_db>
+ *   handoff,<from>,<to>,<time_s>,<overlap_s>,<signal_db>
+ * packet_router --mode handoff replays this plan as a packet stream.
+ */
+bool writePlan(const std::string& path,
+               const std::vector<VisibilityWindow>& windows,
+               const ScheduleResult& result) {
+    std::ofstream out(path);
+    if (!out) return false;
+    out.precision(17);
+    out << "# satellite handoff plan\n";
+    for (const auto& w : windows) {
+        out << "window," << w.satellite_id << "," << w.start_time << ","
+            << w.end_time << "," << w.peak_signal_quality << "\n";
+    }
+    for (const auto& h : result.handoffs) {
+        out << "handoff," << h.from_satellite << "," << h.to_satellite << ","
+            << h.handoff_time << "," << h.overlap_duration << ","
+            << h.signal_at_handoff << "\n";
+    }
+    return static_cast<bool>(out);
+}
+
+// ============================================================
+// Moving Terminals: Trajectory Planning
+// ============================================================
+// Aircraft and ships see passes that depend on where they are, so their
+// windows come from propagating the constellation and the terminal
+// together along a time-stamped track. To keep a long flight cheap the
+// track is cut into segments; for each segment the terminal's swept
+// corridor (its path plus the coverage radius) prunes whole orbital
+// planes by their distance to the corridor, then satellites by their
+// along-track arc. Only survivors are sampled, and window edges are
+// refined by bisection between samples.
+
+constexpr double EARTH_RADIUS_KM = 6371.0;
+constexpr double DEG_TO_RAD = M_PI / 180.0;
+constexpr double RAD_TO_DEG = 180.0 / M_PI;
+constexpr double EARTH_MU_KM3_S2 = 398600.4418;
+constexpr double EARTH_ROTATION_RAD_S = 7.2921159e-5;
+
+struct Vec3 {
+    double x, y, z;
+
+    Vec3 operator-(const Vec3& o) const { return {x - o.x, y - o.y, z - o.z}; }
+    Vec3 operator+(const Vec3& o) const { return {x + o.x, y + o.y, z + o.z}; }
+    Vec3 operator*(double k) const { return {x * k, y * k, z * k}; }
+    double dot(const Vec3& o) const { return x * o.x + y * o.y + z * o.z; }
+    double norm() const { return std::sqrt(dot(*this)); }
+};
+
+Vec3 geoToEcef(double lat_deg, double lon_deg, double alt_km) {
+    double lat = lat_deg * DEG_TO_RAD;
+    double lon = lon_deg * DEG_TO_RAD;
+    double r = EARTH_RADIUS_KM + alt_km;
+    return {r * std::cos(lat) * std::cos(lon), r * std::cos(lat) * std::sin(lon),
+            r * std::sin(lat)};
+}
+
+struct TrackPoint {
+    double time_sec;
+    double lat_deg;
+    double lon_deg;
+    double alt_km;
+};
+
+// Terminal position at time t: great-circle interpolation between the
+// bracketing track points (clamped to the ends of the track)
+Vec3 trackPosition(const std::vector<TrackPoint>& track, double t) {
+    auto it = std::upper_bound(track.begin(), track.end(), t,
+                               [](double v, const TrackPoint& p) { return v < p.time_sec; });
+    if (it == track.begin()) return geoToEcef(it->lat_deg, it->lon_deg, it->alt_km);
+    if (it == track.end()) {
+        const auto& b = track.back();
+        return geoToEcef(b.lat_deg, b.lon_deg, b.alt_km);
+    }
+    const TrackPoint& a = *(it - 1);
+    const TrackPoint& b = *it;
+    double f = (t - a.time_sec) / std::max(1e-9, b.time_sec - a.time_sec);
+    Vec3 pa = geoToEcef(a.lat_deg, a.lon_deg, 0.0) * (1.0 / EARTH_RADIUS_KM);
+    Vec3 pb = geoToEcef(b.lat_deg, b.lon_deg, 0.0) * (1.0 / EARTH_RADIUS_KM);
+    double omega = std::acos(std::clamp(pa.dot(pb), -1.0, 1.0));
+    Vec3 dir = omega < 1e-12
+        ? pa
+        : pa * (std::sin((1 - f) * omega) / std::sin(omega)) +
+          pb * (std::sin(f * omega) / std::sin(omega));
+    double alt = a.alt_km + f * (b.alt_km - a.alt_km);
+    return dir * (EARTH_RADIUS_KM + alt);
+}
+
+/**
+ * Great-circle flight at constant speed, one track point per minute —
+ * what a flight plan or ADS-B feed would provide.
+ */
+std::vector<TrackPoint> greatCircleTrack(double lat0, double lon0,
+                                         double lat1, double lon1,
+                                         double speed_kmh, double alt_km) {
+    Vec3 a = geoToEcef(lat0, lon0, 0.0) * (1.0 / EARTH_RADIUS_KM);
+    Vec3 b = geoToEcef(lat1, lon1, 0.0) * (1.0 / EARTH_RADIUS_KM);
+    double omega = std::acos(std::clamp(a.dot(b), -1.0, 1.0));
+    double duration = omega * EARTH_RADIUS_KM / speed_kmh * 3600.0;
+    std::vector<TrackPoint> track;
+    for (double t = 0.0;; t = std::min(duration, t + 60.0)) {
+        double f = duration > 0 ? t / duration : 1.0;
+        Vec3 p = omega < 1e-12
+            ? a
+            : a * (std::sin((1 - f) * omega) / std::sin(omega)) +
+              b * (std::sin(f * omega) / std::sin(omega));
+        track.push_back({t, std::asin(std::clamp(p.z, -1.0, 1.0)) * RAD_TO_DEG,
+                         std::atan2(p.y, p.x) * RAD_TO_DEG, alt_km});
+        if (t >= duration) break;
+    }
+    return track;
+}
+
+struct WalkerShell {
+    int num_planes;
+    int sats_per_plane;
+    double altitude_km;
+    double inclination_deg;
+};
+
+// Circular Walker-delta orbits in an Earth-fixed frame
+class ShellPropagator {
+public:
+    explicit ShellPropagator(const WalkerShell& shell)
+        : shell_(shell),
+          radius_km_(EARTH_RADIUS_KM + shell.altitude_km),
+          mean_motion_(std::sqrt(EARTH_MU_KM3_S2 /
+                                 (radius_km_ * radius_km_ * radius_km_))),
+          sin_inc_(std::sin(shell.inclination_deg * DEG_TO_RAD)),
+          cos_inc_(std::cos(shell.inclination_deg * DEG_TO_RAD)) {}
+
+    int numSatellites() const { return shell_.num_planes * shell_.sats_per_plane; }
+    int numPlanes() const { return shell_.num_planes; }
+    int planeOf(int sat) const { return sat / shell_.sats_per_plane; }
+    double meanMotion() const { return mean_motion_; }
+
+    // Right ascension of the node, as seen from the rotating Earth
+    double raan(int plane, double t) const {
+        return 2 * M_PI * plane / shell_.num_planes - EARTH_ROTATION_RAD_S * t;
+    }
+
+    // Argument of latitude (Walker F=1 phasing)
+    double argLat(int sat, double t) const {
+        int plane = planeOf(sat);
+        int slot = sat % shell_.sats_per_plane;
+        double u0 = 2 * M_PI * slot / shell_.sats_per_plane +
+                    2 * M_PI * plane / numSatellites();
+        return u0 + mean_motion_ * t;
+    }
+
+    Vec3 position(int sat, double t) const {
+        double raan_t = raan(planeOf(sat), t);
+        double u = argLat(sat, t);
+        double cu = std::cos(u), su = std::sin(u);
+        double co = std::cos(raan_t), so = std::sin(raan_t);
+        return {radius_km_ * (cu * co - su * cos_inc_ * so),
+                radius_km_ * (cu * so + su * cos_inc_ * co),
+                radius_km_ * (su * sin_inc_)};
+    }
+
+    // Unit normal of the orbital plane, and its in-plane basis
+    // (ascending node, 90 degrees ahead of it)
+    void planeFrame(int plane, double t, Vec3& normal, Vec3& node, Vec3& ahead) const {
+        double raan_t = raan(plane, t);
+        double co = std::cos(raan_t), so = std::sin(raan_t);
+        normal = {sin_inc_ * so, -sin_inc_ * co, cos_inc_};
+        node = {co, so, 0.0};
+        ahead = {-cos_inc_ * so, cos_inc_ * co, sin_inc_};
+    }
+
+    // Earth central angle within which the satellite is above min_elev
+    double coverageAngle(double min_elev_deg) const {
+        double e = min_elev_deg * DEG_TO_RAD;
+        return std::acos(EARTH_RADIUS_KM * std::cos(e) / radius_km_) - e;
+    }
+
+private:
+    WalkerShell shell_;
+    double radius_km_;
+    double mean_motion_;
+    double sin_inc_;
+    double cos_inc_;
+};
+
+struct TrackPlanStats {
+    uint64_t segments = 0;
+    uint64_t candidate_pairs = 0;     // (satellite, segment) pairs sampled
+    uint64_t total_pairs = 0;         // without pruning
+    uint64_t visibility_checks = 0;
+};
+
+class TrajectoryPlanner {
+public:
+    static constexpr double SEGMENT_SEC = 300.0;
+    static constexpr int EDGE_BISECTIONS = 10;
+
+    TrajectoryPlanner(const WalkerShell& shell, double min_elev_deg, double step_sec)
+        : prop_(shell),
+          sin_min_elev_(std::sin(min_elev_deg * DEG_TO_RAD)),
+          min_elev_deg_(min_elev_deg),
+          step_sec_(step_sec),
+          coverage_(prop_.coverageAngle(min_elev_deg)) {}
+
+    /**
+     * Visibility windows along `track`. With prune=false every satellite
+     * is sampled in every segment (the reference the pruned run must
+     * match).
+     */
+    std::vector<VisibilityWindow> windows(const std::vector<TrackPoint>& track,
+                                          bool prune, TrackPlanStats& stats) const {
+        const int num_sats = prop_.numSatellites();
+        double t_begin = track.front().time_sec;
+        double t_end = track.back().time_sec;
+
+        std::vector<std::optional<Open>> open(num_sats);
+        std::vector<int> open_ids;
+        std::vector<VisibilityWindow> result;
+        std::vector<char> candidate(num_sats);
+
+        for (double seg0 = t_begin; seg0 < t_end; seg0 += SEGMENT_SEC) {
+            double seg1 = std::min(t_end, seg0 + SEGMENT_SEC);
+            stats.segments++;
+            stats.total_pairs += num_sats;
+            std::fill(candidate.begin(), candidate.end(), prune ? 0 : 1);
+            if (prune) markCandidates(track, seg0, seg1, candidate);
+            for (int id : open_ids) candidate[id] = 1;  // follow open passes out
+
+            std::vector<int> ids;
+            for (int s = 0; s < num_sats; s++) {
+                if (candidate[s]) ids.push_back(s);
+            }
+            stats.candidate_pairs += ids.size();
+
+            // Samples on a global grid so segments line up
+            double first = t_begin + std::ceil((seg0 - t_begin) / step_sec_) * step_sec_;
+            for (double t = first; t < seg1 || (seg1 == t_end && t <= t_end); t += step_sec_) {
+                Vec3 term = trackPosition(track, t);
+                for (int s : ids) {
+                    stats.visibility_checks++;
+                    double elev = elevationDeg(s, t, term);
+                    auto& w = open[s];
+                    if (elev >= min_elev_deg_) {
+                        if (!w) {
+                            double start = t > t_begin
+                                ? refineEdge(track, s, t - step_sec_, t) : t;
+                            w = Open{start, t, elev};
+                            open_ids.push_back(s);
+                        }
+                        w->last = t;
+                        w->peak_elev = std::max(w->peak_elev, elev);
+                    } else if (w) {
+                        result.push_back(close(s, *w, refineEdge(track, s, w->last, t)));
+                        w.reset();
+                    }
+                }
+                open_ids.erase(std::remove_if(open_ids.begin(), open_ids.end(),
+                                              [&](int s) { return !open[s]; }),
+                               open_ids.end());
+            }
+        }
+        for (int s : open_ids) result.push_back(close(s, *open[s], t_end));
+        return result;
+    }
+
+private:
+    struct Open {
+        double start;
+        double last;
+        double peak_elev;
+    };
+
+    double elevationDeg(int sat, double t, const Vec3& term) const {
+        Vec3 d = prop_.position(sat, t) - term;
+        double sin_e = d.dot(term) / (d.norm() * term.norm());
+        return std::asin(std::clamp(sin_e, -1.0, 1.0)) * RAD_TO_DEG;
+    }
+
+    bool visible(const std::vector<TrackPoint>& track, int sat, double t) const {
+        Vec3 term = trackPosition(track, t);
+        Vec3 d = prop_.position(sat, t) - term;
+        return d.dot(term) >= sin_min_elev_ * d.norm() * term.norm();
+    }
+
+    // Rise/set time between a sample on each side of the edge
+    double refineEdge(const std::vector<TrackPoint>& track, int sat,
+                      double lo, double hi) const {
+        bool lo_visible = visible(track, sat, lo);
+        for (int i = 0; i < EDGE_BISECTIONS; i++) {
+            double mid = (lo + hi) / 2;
+            if (visible(track, sat, mid) == lo_visible) lo = mid; else hi = mid;
+        }
+        return (lo + hi) / 2;
+    }
+
+    // Peak elevation maps onto the 8-25 dB SNR range of generateWindows
+    VisibilityWindow close(int sat, const Open& w, double end) const {
+        double snr = 8.0 + 17.0 * (w.peak_elev - min_elev_deg_) / (90.0 - min_elev_deg_);
+        return {sat, w.start, end, snr, snr * 0.6, snr * 0.5};
+    }
+
+    /**
+     * Conservative corridor test for one segment. A satellite can only
+     * see the terminal if its sub-point comes within the coverage angle
+     * of the terminal's path: first reject planes whose ground track
+     * misses the corridor, then satellites whose arc over the segment
+     * misses it in-plane. Earth rotation during the segment is absorbed
+     * into the slack.
+     */
+    void markCandidates(const std::vector<TrackPoint>& track, double seg0,
+                        double seg1, std::vector<char>& candidate) const {
+        double mid = (seg0 + seg1) / 2;
+        Vec3 c = trackPosition(track, mid);
+        c = c * (1.0 / c.norm());
+        double swept = 0.0;
+        for (double t : {seg0, seg1}) {
+            Vec3 p = trackPosition(track, t);
+            swept = std::max(swept, std::acos(std::clamp(
+                                        c.dot(p * (1.0 / p.norm())), -1.0, 1.0)));
+        }
+        double half = (seg1 - seg0) / 2;
+        double reach = coverage_ + swept + EARTH_ROTATION_RAD_S * half + 0.01;
+        double arc_half = prop_.meanMotion() * half;
+
+        for (int plane = 0; plane < prop_.numPlanes(); plane++) {
+            Vec3 normal, node, ahead;
+            prop_.planeFrame(plane, mid, normal, node, ahead);
+            if (std::asin(std::min(1.0, std::abs(normal.dot(c)))) > reach) continue;
+
+            double u_c = std::atan2(c.dot(ahead), c.dot(node));
+            int per_plane = prop_.numSatellites() / prop_.numPlanes();
+            for (int k = 0; k < per_plane; k++) {
+                int sat = plane * per_plane + k;
+                double du = std::remainder(prop_.argLat(sat, mid) - u_c, 2 * M_PI);
+                if (std::abs(du) <= reach + arc_half) candidate[sat] = 1;
+            }
+        }
+    }
+
+    ShellPropagator prop_;
+    double sin_min_elev_;
+    double min_elev_deg_;
+    double step_sec_;
+    double coverage_;
+};
+
+/**
+ * Loads a track as CSV lines "time_sec,lat_deg,lon_deg[,alt_km]" (sorted
+ * by time; lines starting with '#' are skipped).
+ */
+bool loadTrack(const std::string& path, std::vector<TrackPoint>& track) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        TrackPoint p{0, 0, 0, 0};
+        if (std::sscanf(line.c_str(), "%lf,%lf,%lf,%lf",
+                        &p.time_sec, &p.lat_deg, &p.lon_deg, &p.alt_km) < 3) {
+            return false;
+        }
+        track.push_back(p);
+    }
+    return track.size() >= 2;
+}
+
+// ============================================================
+// Window Index
+// ============================================================
+// Operational tools ask "what is in view between t0 and t1" over
+// multi-day predictions, which a scan of the window list answers in
+// O(n). The index sorts windows by start and overlays an implicit
+// interval tree on the sorted array: node i sits at the level given by
+// its trailing one bits and stores the largest end in its subtree, so
+// the tree needs no pointers and lives in one contiguous array.
+// Queries cost O(log n + k). Times are millisecond ticks from the index
+// epoch, which keeps an entry at 16 bytes and spans 49 days.
+
+class WindowIndex {
+public:
+    struct Entry {
+        uint32_t start;
+        uint32_t end;
+        uint32_t max_end;   // over the implicit subtree rooted here
+        uint32_t id;        // caller's window number
+    };
+    static_assert(sizeof(Entry) == 16, "keep four entries per cache line");
+
+    static constexpr double TICKS_PER_SEC = 1000.0;
+
+    explicit WindowIndex(double epoch_sec = 0.0) : epoch_sec_(epoch_sec) {}
+
+    void reserve(size_t n) { entries_.reserve(n); }
+
+    // False if the window falls outside the index's 49-day range
+    bool add(double start_sec, double end_sec, uint32_t id) {
+        double s = std::floor((start_sec - epoch_sec_) * TICKS_PER_SEC);
+        double e = std::ceil((end_sec - epoch_sec_) * TICKS_PER_SEC);
+        if (s < 0 || e > UINT32_MAX || e < s) return false;
+        entries_.push_back({static_cast<uint32_t>(s), static_cast<uint32_t>(e), 0, id});
+        return true;
+    }
+
+    // Windows more than 49 days past the earliest start are left out and
+    // counted in rejected()
+    static WindowIndex fromWindows(const std::vector<VisibilityWindow>& windows) {
+        double epoch = windows.empty() ? 0.0 : windows.front().start_time;
+        for (const auto& w : windows) epoch = std::min(epoch, w.start_time);
+        WindowIndex index(epoch);
+        index.reserve(windows.size());
+        for (size_t i = 0; i < windows.size(); i++) {
+            if (!index.add(windows[i].start_time, windows[i].end_time,
+                           static_cast<uint32_t>(i))) {
+                index.rejected_++;
+            }
+        }
+        index.build();
+        return index;
+    }
+
+    // Sort by start and fill in the subtree maxima, bottom level up
+    void build() {
+        std::sort(entries_.begin(), entries_.end(),
+                  [](const Entry& a, const Entry& b) { return a.start < b.start; });
+        const size_t n = entries_.size();
+        max_level_ = 0;
+        if (n == 0) return;
+
+        size_t last_i = 0;
+        uint32_t last = 0;
+        for (size_t i = 0; i < n; i += 2) {
+            last_i = i;
+            last = entries_[i].max_end = entries_[i].end;
+        }
+        int k = 1;
+        for (; (size_t{1} << k) <= n; k++) {
+            size_t x = size_t{1} << (k - 1);
+            size_t step = x << 2;
+            for (size_t i = (x << 1) - 1; i < n; i += step) {
+                uint32_t left = entries_[i - x].max_end;
+                uint32_t right = i + x < n ? entries_[i + x].max_end : last;
+                entries_[i].max_end = std::max({entries_[i].end, left, right});
+            }
+            // Track the max of the rightmost, possibly incomplete subtree
+            last_i = (last_i >> k & 1) ? last_i - x : last_i + x;
+            if (last_i < n) last = std::max(last, entries_[last_i].max_end);
+        }
+        max_level_ = k - 1;
+    }
+
+    /**
+     * Calls f(id) for every window overlapping [t0_sec, t1_sec] (closed).
+     * Subtrees of up to 16 entries are scanned linearly, which is cheaper
+     * than descending through them.
+     */
+    template<typename F>
+    void forEachOverlapping(double t0_sec, double t1_sec, F&& f) const {
+        const size_t n = entries_.size();
+        if (n == 0) return;
+        double lo_ticks = std::floor((t0_sec - epoch_sec_) * TICKS_PER_SEC);
+        double hi_ticks = std::ceil((t1_sec - epoch_sec_) * TICKS_PER_SEC);
+        if (hi_ticks < 0 || lo_ticks > UINT32_MAX) return;
+        uint32_t lo = static_cast<uint32_t>(std::max(0.0, lo_ticks));
+        uint32_t hi = static_cast<uint32_t>(std::min<double>(UINT32_MAX, hi_ticks));
+
+        struct Frame {
+            int level;
+            size_t node;
+            bool left_done;
+        };
+        Frame stack[64];
+        int top = 0;
+        stack[top++] = {max_level_, (size_t{1} << max_level_) - 1, false};
+        while (top > 0) {
+            Frame z = stack[--top];
+            if (z.level <= 3) {
+                size_t i0 = z.node >> z.level << z.level;
+                size_t i1 = std::min(n, i0 + (size_t{1} << (z.level + 1)) - 1);
+                for (size_t i = i0; i < i1 && entries_[i].start <= hi; i++) {
+                    if (lo <= entries_[i].end) f(entries_[i].id);
+                }
+            } else if (!z.left_done) {
+                size_t left = z.node - (size_t{1} << (z.level - 1));
+                stack[top++] = {z.level, z.node, true};
+                if (left >= n || entries_[left].max_end >= lo) {
+                    stack[top++] = {z.level - 1, left, false};
+                }
+            } else if (z.node < n && entries_[z.node].start <= hi) {
+                if (lo <= entries_[z.node].end) f(entries_[z.node].id);
+                stack[top++] = {z.level - 1, z.node + (size_t{1} << (z.level - 1)), false};
+            }
+        }
+    }
+
+    void overlapping(double t0_sec, double t1_sec, std::vector<uint32_t>& out) const {
+        forEachOverlapping(t0_sec, t1_sec, [&](uint32_t id) { out.push_back(id); });
+    }
+
+    // Windows in view at time t
+    void stabbing(double t_sec, std::vector<uint32_t>& out) const {
+        overlapping(t_sec, t_sec, out);
+    }
+
+    size_t size() const { return entries_.size(); }
+    size_t rejected() const { return rejected_; }
+    size_t memoryBytes() const { return entries_.capacity() * sizeof(Entry); }
+
+private:
+    double epoch_sec_;
+    std::vector<Entry> entries_;
+    int max_level_ = 0;
+    size_t rejected_ = 0;   // fromWindows: outside the tick range
+};
+
+// ============================================================
+// Arguments
+// ============================================================
+struct Args {
+    std::string mode = "single";    // single | fleet | track | index
+    int num_satellites = 30;
+    double sim_time_sec = 3600.0;   // 1 hour of passes
+    unsigned seed = 42;
+    std::string plan_out;           // empty: don't write a plan
+    int num_terminals = 100000;     // fleet mode
+    double cell_km = 5.0;           // fleet mode dedup cell size
+    std::string track_path;         // track mode: empty = LHR -> SIN flight
+    double speed_kmh = 900.0;       // track mode cruise speed
+    double min_elev_deg = 25.0;     // track mode elevation mask
+    double step_sec = 15.0;         // track mode sampling step
+    int backups = 1;                // chains to schedule (1 = primary only)
+    size_t num_windows = 100000000; // index mode window count
+    double days = 7.0;              // index mode prediction horizon
+    bool perf = false;              // per-phase perf_event report at exit
+    bool alloc = false;             // per-phase heap allocation report at exit
+};
+
+void printUsage(const char* prog) {
+    std::cout << "Usage: " << prog << " [options]\n\n"
+              << "Options:\n"
+              << "  --mode M             single | fleet | track | index (default single)\n"
+              << "  --sats N             Satellites passing over (default 30)\n"
+              << "  --time S             Simulated time in seconds (default 3600)\n"
+              << "  --seed N             RNG seed (default 42)\n"
+              << "  --plan-out FILE      Write windows + handoffs as CSV\n"
+              << "  --terminals N        Fleet mode terminal count (default 100000)\n"
+              << "  --cell-km K          Fleet mode dedup cell size (default 5)\n"
+              << "  --track FILE         Track mode CSV: time,lat,lon[,alt_km]\n"
+              << "                       (default: London -> Singapore flight)\n"
+              << "  --speed-kmh V        Default flight cruise speed (default 900)\n"
+              << "  --min-elev D         Track mode elevation mask (default 25)\n"
+              << "  --step S             Track mode sampling step (default 15)\n"
+              << "  --backups K          Primary + K-1 link-disjoint failover chains\n"
+              << "  --windows N          Index mode window count (default 1e8)\n"
+              << "  --days D             Index mode horizon in days (default 7)\n"
+              << "  --perf               Per-phase cycles/IPC/LLC/branch report\n"
+              << "  --alloc              Per-phase heap bytes, allocation counts, peak RSS\n"
+              << "  --help               Show this help\n";
+}
+
+bool parseArgs(int argc, char** argv, Args& args) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto needValue = [&](const char* name) -> std::string {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << name << "\n";
+                return "";
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--mode") {
+            args.mode = needValue("--mode");
+        } else if (arg == "--sats") {
+            args.num_satellites = std::stoi(needValue("--sats"));
+        } else if (arg == "--time") {
+            args.sim_time_sec = std::stod(needValue("--time"));
+        } else if (arg == "--seed") {
+            args.seed = static_cast<unsigned>(std::stoul(needValue("--seed")));
+        } else if (arg == "--plan-out") {
+            args.plan_out = needValue("--plan-out");
+        } else if (arg == "--terminals") {
+            args.num_terminals = std::stoi(needValue("--terminals"));
+        } else if (arg == "--cell-km") {
+            args.cell_km = std::stod(needValue("--cell-km"));
+        } else if (arg == "--track") {
+            args.track_path = needValue("--track");
+        } else if (arg == "--speed-kmh") {
+            args.speed_kmh = std::stod(needValue("--speed-kmh"));
+        } else if (arg == "--min-elev") {
+            args.min_elev_deg = std::stod(needValue("--min-elev"));
+        } else if (arg == "--step") {
+            args.step_sec = std::stod(needValue("--step"));
+        } else if (arg == "--backups") {
+            args.backups = std::stoi(needValue("--backups"));
+        } else if (arg == "--windows") {
+            args.num_windows = static_cast<size_t>(std::stod(needValue("--windows")));
+        } else if (arg == "--days") {
+            args.days = std::stod(needValue("--days"));
+        } else if (arg == "--perf") {
+            args.perf = true;
+        } else if (arg == "--alloc") {
+            args.alloc = true;
+        } else if (arg == "--help") {
+            printUsage(argv[0]);
+            return false;
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// ============================================================
+// Runs
+// ============================================================
+
+/**
+ * Schedules a whole terminal fleet through the per-cell cache, then
+ * again the uncached way (windows + schedule per terminal) to measure
+ * what the cache saves.
+ *
+ * Windows are synthesized per cell, not propagated for each terminal's
+ * own position, so the uncached run is a timing baseline only. Its
+ * mismatch count checks the cache plumbing (every terminal is handed
+ * its own cell's schedule), not the cell approximation itself.
+ */
+int runFleet(const Args& args) {
+    auto fleet = generateFleet(args.num_terminals, args.seed);
+    ScheduleCache cache(args.cell_km, args.num_satellites, args.seed);
+    const double horizon = args.sim_time_sec;
+
+    std::vector<std::shared_ptr<const CellSchedule>> assigned;
+    assigned.reserve(fleet.size());
+    auto start = std::chrono::steady_clock::now();
+    PerfPhase perf_cached("fleet cached", fleet.size());
+    for (const auto& t : fleet) assigned.push_back(cache.scheduleFor(t, horizon));
+    perf_cached.stop();
+    double cached_sec = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    size_t mismatches = 0;
+    start = std::chrono::steady_clock::now();
+    PerfPhase perf_uncached("fleet uncached", fleet.size());
+    for (size_t i = 0; i < fleet.size(); i++) {
+        auto windows = cache.windowsForCell(cache.cellOf(fleet[i], horizon), horizon);
+        auto result = HandoffScheduler::schedule(windows, horizon);
+        if (result.num_handoffs != assigned[i]->result.num_handoffs ||
+            result.min_signal_quality != assigned[i]->result.min_signal_quality ||
+            result.total_coverage_time != assigned[i]->result.total_coverage_time) {
+            mismatches++;
+        }
+    }
+    perf_uncached.stop();
+    double uncached_sec = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    uint64_t lookups = cache.hits() + cache.misses();
+    std::cout << "=== Fleet scheduling: " << fleet.size() << " terminals, "
+              << args.cell_km << " km cells, " << horizon << " s horizon ===\n";
+    std::printf("  Cells scheduled:  %zu (%.1f terminals per cell)\n",
+                cache.cells(), static_cast<double>(fleet.size()) / cache.cells());
+    std::printf("  Cache hit rate:   %.2f%% (%llu hits, %llu misses)\n",
+                100.0 * cache.hits() / lookups,
+                static_cast<unsigned long long>(cache.hits()),
+                static_cast<unsigned long long>(cache.misses()));
+    std::printf("  Cached run:       %.3f s (%.3f s computing schedules)\n",
+                cached_sec, cache.computeSec());
+    std::printf("  Uncached run:     %.3f s\n", uncached_sec);
+    std::printf("  Compute saved:    %.3f s (%.1f%%), %.1fx faster\n",
+                uncached_sec - cached_sec,
+                100.0 * (uncached_sec - cached_sec) / uncached_sec,
+                uncached_sec / cached_sec);
+    std::printf("  Schedule copies:  %zu shared objects instead of %zu\n",
+                cache.cells(), fleet.size());
+    std::printf("  Cache mismatches: %zu (cached vs recomputed cell schedule)\n",
+                mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
+
+/**
+ * Backup chains for a window set: the alternates, the cost of computing
+ * them against replanning from scratch after each exclusion, and how
+ * often a failure of the serving primary satellite finds a backup by
+ * lookup alone. The single-terminal demo's synthetic passes overlap only
+ * pairwise, so its alternates can cover just the handoff overlaps; a
+ * track against the real shell sees several satellites at every instant.
+ */
+int reportBackups(const std::vector<VisibilityWindow>& windows, int k,
+                  double horizon) {
+    auto start = std::chrono::steady_clock::now();
+    auto backups = HandoffScheduler::scheduleWithBackups(windows, k, horizon);
+    double shared_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+
+    // Reference cost: replan from scratch for each alternate, rebuilding
+    // the candidate handoffs every time
+    start = std::chrono::steady_clock::now();
+    for (size_t r = 1; r <= backups.chains.size(); r++) {
+        HandoffScheduler::scheduleWithBackups(windows, static_cast<int>(r), horizon);
+    }
+    double replan_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "\n=== Backup Chains (k=" << k << ") ===\n";
+    for (size_t r = 0; r < backups.chains.size(); r++) {
+        const auto& c = backups.chains[r];
+        std::printf("  %s %zu: %d handoffs, min signal %.2f dB, coverage %.0f s, "
+                    "gaps %.0f s\n", r == 0 ? "Primary  " : "Alternate", r,
+                    c.num_handoffs, c.min_signal_quality, c.total_coverage_time,
+                    c.total_gap_time);
+    }
+
+    // Fail the serving primary satellite at every second of the primary chain
+    const auto& primary = backups.serving.front();
+    uint64_t failures = 0, covered = 0, shared = 0;
+    start = std::chrono::steady_clock::now();
+    for (const auto& seg : primary) {
+        for (double t = seg.start_time; t < std::min(seg.end_time, horizon); t += 1.0) {
+            failures++;
+            if (backups.failover(seg.satellite_id, t)) covered++;
+        }
+    }
+    double lookup_ns = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count() / std::max<uint64_t>(1, failures);
+
+    // Audit: no alternate may serve from a primary satellite at the same time
+    for (const auto& seg : primary) {
+        for (size_t r = 1; r < backups.serving.size(); r++) {
+            for (const auto& other : backups.serving[r]) {
+                if (other.satellite_id == seg.satellite_id &&
+                    other.start_time < seg.end_time && seg.start_time < other.end_time) {
+                    shared++;
+                }
+            }
+        }
+    }
+
+    std::printf("  Failover coverage: %.2f%% of %llu primary-satellite failures\n",
+                100.0 * covered / std::max<uint64_t>(1, failures),
+                static_cast<unsigned long long>(failures));
+    std::printf("  Shared satellites: %llu overlapping segments\n",
+                static_cast<unsigned long long>(shared));
+    std::printf("  Scheduling:        %.2f ms for all chains (replanning: %.2f ms)\n",
+                shared_ms, replan_ms);
+    std::printf("  Failover lookup:   %.0f ns\n", lookup_ns);
+    return shared == 0 ? 0 : 1;
+}
+
+/**
+ * Plans a moving terminal against the Gen1 main shell: windows along the
+ * track with corridor pruning, the handoff schedule over them, and the
+ * unpruned planner as the reference both for speed and for the windows.
+ */
+int runTrack(const Args& args) {
+    std::vector<TrackPoint> track;
+    std::string label;
+    if (!args.track_path.empty()) {
+        if (!loadTrack(args.track_path, track)) {
+            std::cerr << "Failed to load track " << args.track_path << "\n";
+            return 1;
+        }
+        label = args.track_path;
+    } else {
+        track = greatCircleTrack(51.47, -0.45, 1.36, 103.99, args.speed_kmh, 11.0);
+        label = "LHR -> SIN";
+    }
+    const WalkerShell shell{72, 22, 550.0, 53.0};
+    TrajectoryPlanner planner(shell, args.min_elev_deg, args.step_sec);
+    double duration = track.back().time_sec - track.front().time_sec;
+
+    TrackPlanStats pruned_stats;
+    auto start = std::chrono::steady_clock::now();
+    PerfPhase perf_windows("track windows", track.size());
+    auto windows = planner.windows(track, true, pruned_stats);
+    perf_windows.stop();
+    double windows_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    PerfPhase perf_schedule("track schedule", windows.size());
+    auto result = HandoffScheduler::schedule(windows, track.back().time_sec);
+    perf_schedule.stop();
+    double schedule_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+
+    TrackPlanStats full_stats;
+    start = std::chrono::steady_clock::now();
+    auto reference = planner.windows(track, false, full_stats);
+    double full_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+
+    auto byStart = [](const VisibilityWindow& a, const VisibilityWindow& b) {
+        return std::tie(a.satellite_id, a.start_time) < std::tie(b.satellite_id, b.start_time);
+    };
+    std::sort(windows.begin(), windows.end(), byStart);
+    std::sort(reference.begin(), reference.end(), byStart);
+    size_t mismatches = windows.size() == reference.size()
+        ? 0 : std::max(windows.size(), reference.size());
+    for (size_t i = 0; mismatches == 0 && i < windows.size(); i++) {
+        if (windows[i].satellite_id != reference[i].satellite_id ||
+            std::abs(windows[i].start_time - reference[i].start_time) > 0.1 ||
+            std::abs(windows[i].end_time - reference[i].end_time) > 0.1) {
+            mismatches++;
+        }
+    }
+
+    std::cout << "=== Track planning: " << label << ", " << track.size()
+              << " track points, " << duration / 3600.0 << " h ===\n";
+    std::printf("  Shell:            %d satellites, %.0f deg mask, %.0f s step\n",
+                shell.num_planes * shell.sats_per_plane, args.min_elev_deg, args.step_sec);
+    std::printf("  Windows:          %zu\n", windows.size());
+    std::printf("  Corridor pruning: %.1f%% of satellite-segments skipped "
+                "(%llu of %llu sampled)\n",
+                100.0 * (1.0 - static_cast<double>(pruned_stats.candidate_pairs) /
+                               pruned_stats.total_pairs),
+                static_cast<unsigned long long>(pruned_stats.candidate_pairs),
+                static_cast<unsigned long long>(pruned_stats.total_pairs));
+    std::printf("  Visibility checks: %llu pruned vs %llu unpruned\n",
+                static_cast<unsigned long long>(pruned_stats.visibility_checks),
+                static_cast<unsigned long long>(full_stats.visibility_checks));
+    std::printf("  Windows time:     %.1f ms (unpruned %.1f ms, %.1fx)\n",
+                windows_ms, full_ms, full_ms / windows_ms);
+    std::printf("  Schedule time:    %.1f ms\n", schedule_ms);
+    std::printf("  Plan total:       %.1f ms\n", windows_ms + schedule_ms);
+    std::printf("  Handoffs:         %d, min signal %.2f dB\n",
+                result.num_handoffs, result.min_signal_quality);
+    std::printf("  Coverage:         %.0f s (%.2f%%), gaps %.0f s\n",
+                result.total_coverage_time,
+                100.0 * result.total_coverage_time / duration, result.total_gap_time);
+    std::printf("  Mismatches:       %zu\n", mismatches);
+
+    if (!args.plan_out.empty()) {
+        if (!writePlan(args.plan_out, windows, result)) {
+            std::cerr << "Failed to write " << args.plan_out << "\n";
+            return 1;
+        }
+        std::cout << "\nPlan written to " << args.plan_out << "\n";
+    }
+    if (args.backups > 1 &&
+        reportBackups(windows, args.backups, track.back().time_sec) != 0) {
+        return 1;
+    }
+    return mismatches == 0 ? 0 : 1;
+}
+
+/**
+ * Builds a window index over a synthetic multi-day prediction set and
+ * measures build cost and stabbing/range query throughput. A handful of
+ * queries are checked against a full scan of the same windows.
+ */
+int runIndexBench(const Args& args) {
+    const size_t n = args.num_windows;
+    const double horizon = args.days * 86400.0;
+    if (horizon * WindowIndex::TICKS_PER_SEC + 600e3 > UINT32_MAX) {
+        std::cerr << "--days exceeds the index's 49-day range\n";
+        return 1;
+    }
+    auto generate = [&](auto&& emit) {
+        std::mt19937_64 rng(args.seed);
+        std::uniform_real_distribution<double> start_dist(0.0, horizon);
+        std::uniform_real_distribution<double> dur_dist(180.0, 600.0);
+        for (size_t i = 0; i < n; i++) {
+            double s = start_dist(rng);
+            emit(s, s + dur_dist(rng), static_cast<uint32_t>(i));
+        }
+    };
+
+    WindowIndex index;
+    auto start = std::chrono::steady_clock::now();
+    index.reserve(n);
+    generate([&](double s, double e, uint32_t id) { index.add(s, e, id); });
+    double gen_sec = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    PerfPhase perf_build("index build", n);
+    index.build();
+    perf_build.stop();
+    double build_sec = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    const int QUERIES = 20000;
+    std::mt19937_64 qrng(args.seed + 1);
+    std::uniform_real_distribution<double> t_dist(0.0, horizon);
+    std::vector<double> times(QUERIES);
+    for (auto& t : times) t = t_dist(qrng);
+
+    uint64_t stab_hits = 0, range_hits = 0;
+    start = std::chrono::steady_clock::now();
+    PerfPhase perf_stab("index stabbing", QUERIES);
+    for (double t : times) {
+        index.forEachOverlapping(t, t, [&](uint32_t) { stab_hits++; });
+    }
+    perf_stab.stop();
+    double stab_sec = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    PerfPhase perf_range("index range", QUERIES);
+    for (double t : times) {
+        index.forEachOverlapping(t, t + 60.0, [&](uint32_t) { range_hits++; });
+    }
+    perf_range.stop();
+    double range_sec = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    // Check a few stabbing and range queries against one full scan
+    const int CHECKS = 8;
+    std::vector<uint64_t> expect(2 * CHECKS, 0), got(2 * CHECKS, 0);
+    for (int c = 0; c < CHECKS; c++) {
+        index.forEachOverlapping(times[c], times[c], [&](uint32_t) { got[c]++; });
+        index.forEachOverlapping(times[c], times[c] + 60.0,
+                                 [&](uint32_t) { got[CHECKS + c]++; });
+    }
+    auto ticks = [](double sec, bool up) {
+        return up ? std::ceil(sec * WindowIndex::TICKS_PER_SEC)
+                  : std::floor(sec * WindowIndex::TICKS_PER_SEC);
+    };
+    start = std::chrono::steady_clock::now();
+    generate([&](double s, double e, uint32_t) {
+        double st = ticks(s, false), en = ticks(e, true);
+        for (int c = 0; c < CHECKS; c++) {
+            double t0 = ticks(times[c], false);
+            if (st <= ticks(times[c], true) && t0 <= en) expect[c]++;
+            if (st <= ticks(times[c] + 60.0, true) && t0 <= en) expect[CHECKS + c]++;
+        }
+    });
+    double scan_sec = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    size_t mismatches = 0;
+    for (int c = 0; c < 2 * CHECKS; c++) mismatches += expect[c] != got[c];
+
+    std::cout << "=== Window index: " << n << " windows over " << args.days
+              << " days ===\n";
+    std::printf("  Generate:         %.2f s\n", gen_sec);
+    std::printf("  Build:            %.2f s (%.1f M windows/s), %.0f MB\n",
+                build_sec, n / build_sec / 1e6, index.memoryBytes() / 1e6);
+    std::printf("  Stabbing queries: %.0f /s, %.1f windows in view on average "
+                "(%.0f M results/s)\n", QUERIES / stab_sec,
+                static_cast<double>(stab_hits) / QUERIES, stab_hits / stab_sec / 1e6);
+    std::printf("  60 s range:       %.0f /s, %.1f windows on average "
+                "(%.0f M results/s)\n", QUERIES / range_sec,
+                static_cast<double>(range_hits) / QUERIES, range_hits / range_sec / 1e6);
+    std::printf("  Full scan:        %.2f s for %d queries (%.0f /s)\n",
+                scan_sec, 2 * CHECKS, 2 * CHECKS / scan_sec);
+    std::printf("  Mismatches:       %zu of %d checked queries\n", mismatches, 2 * CHECKS);
+    return mismatches == 0 ? 0 : 1;
+}
+
+// The original demo: one terminal, one hour of passes
+int runSingleTerminal(const Args& args) {
     // Simulate 1 hour of satellite passes for a user terminal
-    constexpr double SIMULATION_TIME = 3600.0;  // 1 hour
-    constexpr int MAX_SATELLITES = 30;
+    const double SIMULATION_TIME = args.sim_time_sec;
+    const int MAX_SATELLITES = args.num_satellites;
 
-    auto windows = generateWindows(MAX_SATELLITES, SIMULATION_TIME);
+    PerfPhase perf_generate("generate windows", MAX_SATELLITES);
+    auto windows = generateWindows(MAX_SATELLITES, SIMULATION_TIME, args.seed);
+    perf_generate.stop();
 
     std::cout << "Generated " << windows.size() << " visibility windows "
               << "over " << SIMULATION_TIME / 60.0 << " minutes\n\n";
@@ -313,7 +1594,9 @@ int main() {
 
     // Run scheduler
     std::cout << "\n=== Running Handoff Scheduler ===\n";
-    auto result = HandoffScheduler::schedule(windows);
+    PerfPhase perf_schedule("schedule", windows.size());
+    auto result = HandoffScheduler::schedule(windows, SIMULATION_TIME);
+    perf_schedule.stop();
 
     // Print results
     std::cout << "\nOptimal Schedule:\n";
@@ -350,5 +1633,45 @@ int main() {
         std::cout << "  All constraints satisfied ✓\n";
     }
 
+    if (!args.plan_out.empty()) {
+        if (!writePlan(args.plan_out, windows, result)) {
+            std::cerr << "Failed to write " << args.plan_out << "\n";
+            return 1;
+        }
+        std::cout << "\nPlan written to " << args.plan_out << "\n";
+    }
+
+    if (args.backups > 1) return reportBackups(windows, args.backups, SIMULATION_TIME);
     return 0;
 }
+
+// ============================================================
+// Main
+// ============================================================
+
+int main(int argc, char** argv) {
+    Args args;
+    if (!parseArgs(argc, argv, args)) {
+        return 0;
+    }
+
+    std::cout << "╔══════════════════════════════════════════════╗\n";
+    std::cout << "║  Satellite Handoff Scheduler                ║\n";
+    std::cout << "║  Stuart Ray — Starlink Interview Prep       ║\n";
+    std::cout << "╚══════════════════════════════════════════════╝\n\n";
+
+    if (args.perf) PerfReport::instance().enable();
+    if (args.alloc) PerfReport::instance().enableAlloc();
+    int rc;
+    if (args.mode == "fleet") {
+        rc = runFleet(args);
+    } else if (args.mode == "track") {
+        rc = runTrack(args);
+    } else if (args.mode == "index") {
+        rc = runIndexBench(args);
+    } else {
+        rc = runSingleTerminal(args);
+    }
+    PerfReport::instance().print();
+    return rc;
+}
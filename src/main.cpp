@@ -18,17 +18,31 @@
 #include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <climits>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <memory_resource>
 #include <mutex>
+#include <new>
 #include <numeric>
 #include <optional>
 #include <queue>
 #include <random>
+#include <string>
 #include <thread>
+#include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include "alloc_tracker.h"
+#include "perf_counters.h"
+
 // ============================================================
 // Constants
 // ============================================================
@@ -37,6 +51,227 @@ constexpr double MIN_ELEVATION_DEG = 25.0;
 constexpr double DEG_TO_RAD = M_PI / 180.0;
 constexpr double RAD_TO_DEG = 180.0 / M_PI;
 
+// ============================================================
+// Polynomial Trig
+// ============================================================
+// Branch-free minimax kernels for the per-pair geometry, selected at
+// runtime against libm through the Trig template parameter. sin/cos use
+// Cody-Waite reduction to [-pi/4, pi/4] and the Cephes minimax
+// polynomials; asin/acos fold onto [0, 0.5] (asin(x) = pi/2 -
+// 2 asin(sqrt((1-x)/2)) above it) with a degree-11 Remez fit in x²;
+// atan2 reduces to |t| <= tan(pi/12) with a degree-7 fit. Both branches
+// of each fold share one polynomial evaluation: no data-dependent
+// branches, so loops over them vectorize where the target ISA allows.
+//
+// Max error against long double libm over 2e7 random arguments
+// (asserted in test_visibility):
+//   sin, cos  < 2.5 ulp for |x| <= 1e5
+//   asin      < 3 ulp, acos < 1.5 ulp on [-1, 1]
+//   atan2     < 4.5 ulp
+// Elevation errors stay below 1e-11 degrees, far below any mask,
+// and the visibility edge set is unchanged.
+struct LibmTrig {
+    template<typename T> static T sin(T x) { return std::sin(x); }
+    template<typename T> static T cos(T x) { return std::cos(x); }
+    template<typename T> static T asin(T x) { return std::asin(x); }
+    template<typename T> static T acos(T x) { return std::acos(x); }
+    template<typename T> static T atan2(T y, T x) { return std::atan2(y, x); }
+};
+
+struct PolyTrig {
+    static double sin(double x) { return sinCosQuadrant(x, 0); }
+    static double cos(double x) { return sinCosQuadrant(x, 1); }
+
+    static double asin(double x) {
+        double a = std::abs(x);
+        bool small = a <= 0.5;
+        double z = small ? a * a : (1.0 - a) * 0.5;
+        double s = small ? a : std::sqrt(z);
+        double p = s + s * z * asinPoly(z);
+        double r = small ? p : PIO2_HI - (2.0 * p - PIO2_LO);
+        return std::copysign(r, x);
+    }
+
+    static double acos(double x) {
+        double a = std::abs(x);
+        bool small = a <= 0.5;
+        double z = small ? x * x : (1.0 - a) * 0.5;
+        double s = small ? x : std::sqrt(z);
+        double p = s + s * z * asinPoly(z);
+        if (small) return PIO2_HI - (p - PIO2_LO);
+        return x > 0 ? 2.0 * p : PI_HI - (2.0 * p - PI_LO);
+    }
+
+    static double atan2(double y, double x) {
+        double ax = std::abs(x), ay = std::abs(y);
+        double hi = std::max(ax, ay), lo = std::min(ax, ay);
+        double t = hi > 0 ? lo / hi : 0.0;                     // [0, 1]
+        bool fold = t > TAN_PI_12;
+        double u = fold ? (t * SQRT3 - 1.0) / (t + SQRT3) : t;  // |u| <= tan(pi/12)
+        double w = u * u;
+        double r = u + u * w * atanPoly(w) + (fold ? PI_6 : 0.0);
+        r = ay > ax ? PIO2_HI - r + PIO2_LO : r;
+        r = x < 0 ? PI_HI - r + PI_LO : r;
+        return std::copysign(r, y);
+    }
+
+private:
+    static constexpr double PIO2_HI = 1.57079632679489655800e+00;
+    static constexpr double PIO2_LO = 6.12323399573676588613e-17;
+    static constexpr double PI_HI = 3.14159265358979311600e+00;
+    static constexpr double PI_LO = 1.22464679914735317720e-16;
+    static constexpr double PI_6 = 5.23598775598298815658e-01;
+    static constexpr double SQRT3 = 1.73205080756887719318e+00;
+    static constexpr double TAN_PI_12 = 2.67949192431122706473e-01;
+
+    // x = k pi/2 + r, then the quadrant picks sin/cos and sign
+    static double sinCosQuadrant(double x, int shift) {
+        constexpr double TWO_OVER_PI = 6.36619772367581382433e-01;
+        constexpr double PIO2_1 = 1.57079632673412561417e+00;   // first 33 bits
+        constexpr double PIO2_2 = 6.07710050630396597660e-11;   // next 33 bits
+        constexpr double PIO2_3 = 2.02226624871116645580e-21;   // tail
+        constexpr double ROUND = 6755399441055744.0;            // 1.5 * 2^52
+        double k = (x * TWO_OVER_PI + ROUND) - ROUND;
+        double r = ((x - k * PIO2_1) - k * PIO2_2) - k * PIO2_3;
+        int q = static_cast<int>(static_cast<int64_t>(k)) + shift;
+        double z = r * r;
+        double s = r + r * z * (-1.66666666666666307295e-1 + z * (8.33333333332211858878e-3 +
+                   z * (-1.98412698295895385996e-4 + z * (2.75573136213857245213e-6 +
+                   z * (-2.50507477628578072866e-8 + z * 1.58962301576546568060e-10)))));
+        double c = 1.0 - 0.5 * z + z * z * (4.16666666666665929218e-2 +
+                   z * (-1.38888888888730564116e-3 + z * (2.48015872888517045348e-5 +
+                   z * (-2.75573141792967388112e-7 + z * (2.08757008419747316778e-9 +
+                   z * -1.13585365213876817300e-11)))));
+        double v = (q & 1) ? c : s;
+        return (q & 2) ? -v : v;
+    }
+
+    // (asin(sqrt z) - sqrt z) / z^1.5 on [0, 0.25]
+    static double asinPoly(double z) {
+        return 0.16666666666666646 + z * (0.075000000000232631 + z * (0.044642857099408392 +
+               z * (0.030381947618578847 + z * (0.022372039558540002 +
+               z * (0.017355411078687454 + z * (0.013927890026116782 +
+               z * (0.011888696520972233 + z * (0.0077394544038220806 +
+               z * (0.016225090021533179 + z * (-0.01106884778146988 +
+               z * 0.028402137158083294))))))))));
+    }
+
+    // (atan(sqrt w) - sqrt w) / w^1.5 on [0, tan²(pi/12)]
+    static double atanPoly(double w) {
+        return -0.33333333333333248 + w * (0.19999999999846665 + w * (-0.14285714240489927 +
+               w * (0.11111106023348163 + w * (-0.090906272982633721 +
+               w * (0.076837908710856925 + w * (-0.065226117213869617 +
+               w * 0.04580788442090232))))));
+    }
+};
+
+enum class TrigMode { LIBM, POLY };
+
+// ============================================================
+// Tick Arena
+// ============================================================
+// Everything the graph analyses build is dead by the end of a tick, so
+// it comes from a bump allocator instead of the heap. The arena keeps
+// one block across ticks; an allocation past its end takes an overflow
+// chunk from upstream, and the next reset() regrows the block to the
+// high-water mark, so after the first tick or two nothing reaches
+// malloc. reset() is O(1) unless there are overflow chunks to return.
+// deallocate() is a no-op. Not thread-safe: one arena per worker.
+class TickArena : public std::pmr::memory_resource {
+public:
+    explicit TickArena(size_t initial_bytes = 64 * 1024)
+        : block_(new std::byte[initial_bytes]), capacity_(initial_bytes) {}
+
+    TickArena(TickArena&&) = default;
+    TickArena& operator=(TickArena&&) = default;
+
+    ~TickArena() override { releaseOverflow(); }
+
+    void reset() {
+        high_water_ = std::max(high_water_, used_ + overflow_bytes_);
+        if (!overflow_.empty()) {
+            releaseOverflow();
+            capacity_ = high_water_ * 2;
+            block_.reset(new std::byte[capacity_]);
+            regrows_++;
+        }
+        used_ = 0;
+        overflow_bytes_ = 0;
+    }
+
+    uint64_t allocations() const { return allocations_; }
+    uint64_t upstreamAllocations() const { return upstream_allocations_; }
+    uint64_t regrows() const { return regrows_; }
+    size_t capacity() const { return capacity_; }
+    size_t highWater() const { return std::max(high_water_, used_ + overflow_bytes_); }
+
+private:
+    void* do_allocate(size_t bytes, size_t align) override {
+        allocations_++;
+        size_t start = (used_ + align - 1) & ~(align - 1);
+        if (align <= alignof(std::max_align_t) && start + bytes <= capacity_) {
+            used_ = start + bytes;
+            return block_.get() + start;
+        }
+        upstream_allocations_++;
+        overflow_bytes_ += bytes;
+        void* p = std::pmr::new_delete_resource()->allocate(bytes, align);
+        overflow_.push_back({p, bytes, align});
+        return p;
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    void releaseOverflow() {
+        for (const auto& c : overflow_) {
+            std::pmr::new_delete_resource()->deallocate(c.ptr, c.bytes, c.align);
+        }
+        overflow_.clear();
+    }
+
+    struct Chunk {
+        void* ptr;
+        size_t bytes;
+        size_t align;
+    };
+
+    std::unique_ptr<std::byte[]> block_;
+    size_t capacity_;
+    size_t used_ = 0;
+    size_t overflow_bytes_ = 0;
+    size_t high_water_ = 0;
+    std::vector<Chunk> overflow_;
+    uint64_t allocations_ = 0;
+    uint64_t upstream_allocations_ = 0;
+    uint64_t regrows_ = 0;
+};
+
+// new/delete with a counter, the per-tick baseline the arena replaces
+class CountingResource : public std::pmr::memory_resource {
+public:
+    uint64_t allocations() const { return allocations_.load(std::memory_order_relaxed); }
+
+private:
+    void* do_allocate(size_t bytes, size_t align) override {
+        allocations_.fetch_add(1, std::memory_order_relaxed);
+        return std::pmr::new_delete_resource()->allocate(bytes, align);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t align) override {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    std::atomic<uint64_t> allocations_{0};
+};
+
 // ============================================================
 // Data Structures
 // ============================================================
@@ -76,16 +311,17 @@ struct VisibilityEdge {
  * Compute great-circle distance between two points on Earth's surface.
  * Uses Haversine formula — accurate for all distances.
  */
+template<typename Trig = LibmTrig>
 double haversineDistanceKm(const GeoCoord& a, const GeoCoord& b) {
     double dlat = (b.lat_deg - a.lat_deg) * DEG_TO_RAD;
     double dlon = (b.lon_deg - a.lon_deg) * DEG_TO_RAD;
     double lat1 = a.lat_deg * DEG_TO_RAD;
     double lat2 = b.lat_deg * DEG_TO_RAD;
 
-    double h = std::sin(dlat / 2) * std::sin(dlat / 2) +
-               std::cos(lat1) * std::cos(lat2) *
-               std::sin(dlon / 2) * std::sin(dlon / 2);
-    double c = 2 * std::asin(std::sqrt(h));
+    double h = Trig::sin(dlat / 2) * Trig::sin(dlat / 2) +
+               Trig::cos(lat1) * Trig::cos(lat2) *
+               Trig::sin(dlon / 2) * Trig::sin(dlon / 2);
+    double c = 2 * Trig::asin(std::sqrt(h));
     return EARTH_RADIUS_KM * c;
 }
 
@@ -99,9 +335,10 @@ double haversineDistanceKm(const GeoCoord& a, const GeoCoord& b) {
  * Elevation > 25° is typical minimum for reliable Starlink links
  * (atmospheric attenuation, multipath, and rain fade worsen at low angles).
  */
+template<typename Trig = LibmTrig>
 double computeElevationAngle(const GeoCoord& station, const GeoCoord& sat_pos,
                               double sat_altitude_km) {
-    double ground_dist_km = haversineDistanceKm(station, sat_pos);
+    double ground_dist_km = haversineDistanceKm<Trig>(station, sat_pos);
 
     // Central angle subtended at Earth's center
     double central_angle = ground_dist_km / EARTH_RADIUS_KM;
@@ -113,7 +350,7 @@ double computeElevationAngle(const GeoCoord& station, const GeoCoord& sat_pos,
     double slant_range = std::sqrt(
         EARTH_RADIUS_KM * EARTH_RADIUS_KM +
         r_sat * r_sat -
-        2 * EARTH_RADIUS_KM * r_sat * std::cos(central_angle));
+        2 * EARTH_RADIUS_KM * r_sat * Trig::cos(central_angle));
 
     if (slant_range < 1e-6) return 90.0;  // directly overhead
 
@@ -124,7 +361,7 @@ double computeElevationAngle(const GeoCoord& station, const GeoCoord& sat_pos,
                            (2 * slant_range * EARTH_RADIUS_KM);
 
     // Elevation is complement of the angle at the station
-    double angle_at_station = std::acos(std::clamp(cos_elevation, -1.0, 1.0));
+    double angle_at_station = Trig::acos(std::clamp(cos_elevation, -1.0, 1.0));
     return (angle_at_station * RAD_TO_DEG) - 90.0;
 }
 
@@ -144,9 +381,25 @@ class VisibilityGraph {
 public:
     VisibilityGraph(const std::vector<Satellite>& sats,
                     const std::vector<GroundStation>& stations,
-                    int num_threads = std::thread::hardware_concurrency())
-        : satellites_(sats), stations_(stations) {
-        buildGraph(num_threads);
+                    int num_threads = std::thread::hardware_concurrency(),
+                    TrigMode trig = TrigMode::POLY,
+                    bool verbose = true)
+        : satellites_(sats), stations_(stations), trig_(trig) {
+        build(num_threads, nullptr, verbose);
+    }
+
+    /**
+     * Recompute edges for new satellite positions. With `thread_mem`
+     * (one resource per thread) the build's scratch and per-thread
+     * results come from there; edges_ keeps its capacity, so with tick
+     * arenas a steady-state rebuild does not touch the heap for graph
+     * state.
+     */
+    void rebuild(const std::vector<Satellite>& sats, int num_threads,
+                 std::pmr::memory_resource* const* thread_mem = nullptr) {
+        satellites_ = sats;
+        edges_.clear();
+        build(num_threads, thread_mem, false);
     }
 
     /** Get all edges (satellite-station pairs with visibility) */
@@ -181,18 +434,20 @@ public:
      * At Starlink scale this runs in the constellation management software
      * to compute minimum active satellites for coverage guarantees.
      */
-    std::vector<int> minimumCoverageSatellites() const {
+    std::pmr::vector<int> minimumCoverageSatellites(
+        std::pmr::memory_resource* mem = std::pmr::new_delete_resource()) const {
+        PerfPhase perf("min coverage", edges_.size());
         int M = static_cast<int>(stations_.size());
-        std::unordered_set<int> uncovered;
+        std::pmr::unordered_set<int> uncovered(mem);
         for (int j = 0; j < M; j++) uncovered.insert(j);
 
         // Build coverage map: satellite_id -> set of station_ids
-        std::unordered_map<int, std::vector<int>> coverage;
+        std::pmr::unordered_map<int, std::pmr::vector<int>> coverage(mem);
         for (const auto& edge : edges_) {
             coverage[edge.satellite_id].push_back(edge.station_id);
         }
 
-        std::vector<int> selected;
+        std::pmr::vector<int> selected(mem);
 
         while (!uncovered.empty()) {
             // Find satellite covering most uncovered stations
@@ -231,10 +486,12 @@ public:
      * A satellite is critical if removing it leaves a station with
      * zero coverage. Uses articulation point detection on bipartite graph.
      */
-    std::vector<int> findCriticalSatellites() const {
+    std::pmr::vector<int> findCriticalSatellites(
+        std::pmr::memory_resource* mem = std::pmr::new_delete_resource()) const {
+        PerfPhase perf("critical satellites", edges_.size());
         // Count how many satellites cover each station
-        std::unordered_map<int, int> station_coverage_count;
-        std::unordered_map<int, std::vector<int>> station_to_sats;
+        std::pmr::unordered_map<int, int> station_coverage_count(mem);
+        std::pmr::unordered_map<int, std::pmr::vector<int>> station_to_sats(mem);
 
         for (const auto& edge : edges_) {
             station_coverage_count[edge.station_id]++;
@@ -243,21 +500,23 @@ public:
 
         // A satellite is critical if it's the ONLY satellite covering
         // at least one station
-        std::unordered_set<int> critical;
+        std::pmr::unordered_set<int> critical(mem);
         for (const auto& [station_id, count] : station_coverage_count) {
             if (count == 1) {
                 critical.insert(station_to_sats[station_id][0]);
             }
         }
 
-        return std::vector<int>(critical.begin(), critical.end());
+        return std::pmr::vector<int>(critical.begin(), critical.end(), mem);
     }
 
-    void printStats() const {
-        std::cout << "=== Visibility Graph Statistics ===\n";
-        std::cout << "Satellites: " << satellites_.size() << "\n";
-        std::cout << "Ground Stations: " << stations_.size() << "\n";
-        std::cout << "Visibility Edges: " << edges_.size() << "\n";
+    void printStats(std::ostream& os = std::cout,
+                    std::pmr::memory_resource* mem = std::pmr::new_delete_resource()) const {
+        PerfPhase perf("graph stats", edges_.size());
+        os << "=== Visibility Graph Statistics ===\n";
+        os << "Satellites: " << satellites_.size() << "\n";
+        os << "Ground Stations: " << stations_.size() << "\n";
+        os << "Visibility Edges: " << edges_.size() << "\n";
 
         if (!edges_.empty()) {
             double avg_elev = 0, min_elev = 90, max_elev = 0;
@@ -273,14 +532,14 @@ public:
             avg_elev /= edges_.size();
             avg_lat /= edges_.size();
 
-            std::cout << "Elevation: min=" << min_elev << "° avg=" << avg_elev
-                      << "° max=" << max_elev << "°\n";
-            std::cout << "Latency:   min=" << min_lat << "ms avg=" << avg_lat
-                      << "ms max=" << max_lat << "ms\n";
+            os << "Elevation: min=" << min_elev << "° avg=" << avg_elev
+               << "° max=" << max_elev << "°\n";
+            os << "Latency:   min=" << min_lat << "ms avg=" << avg_lat
+               << "ms max=" << max_lat << "ms\n";
         }
 
         // Coverage density
-        std::unordered_map<int, int> sats_per_station;
+        std::pmr::unordered_map<int, int> sats_per_station(mem);
         for (const auto& e : edges_) {
             sats_per_station[e.station_id]++;
         }
@@ -293,48 +552,120 @@ public:
                 avg_cov += count;
             }
             avg_cov /= sats_per_station.size();
-            std::cout << "Satellites per station: min=" << min_cov
-                      << " avg=" << avg_cov << " max=" << max_cov << "\n";
+            os << "Satellites per station: min=" << min_cov
+               << " avg=" << avg_cov << " max=" << max_cov << "\n";
         }
     }
 
 private:
-    void buildGraph(int num_threads) {
+    // The elevation of one pair is a single dependent chain (sin -> asin
+    // -> cos -> acos, several hundred cycles of latency), so evaluating it
+    // pair by pair leaves the FP units idle. pairBlock runs the same math
+    // as computeElevationAngle, bit for bit, as short passes over a block
+    // of satellites, letting consecutive pairs overlap in the pipeline.
+    static constexpr int PAIR_BLOCK = 64;
+
+    template<typename Trig>
+    void pairBlock(const GroundStation& gs, int begin, int n,
+                   const std::pmr::vector<double>& sat_cos_lat,
+                   double* elev, double* slant) const {
+        double gs_cos_lat = Trig::cos(gs.position.lat_deg * DEG_TO_RAD);
+        for (int k = 0; k < n; k++) {
+            const auto& sat = satellites_[begin + k];
+            double dlat = (sat.position.lat_deg - gs.position.lat_deg) * DEG_TO_RAD;
+            double dlon = (sat.position.lon_deg - gs.position.lon_deg) * DEG_TO_RAD;
+            double sin_dlat = Trig::sin(dlat / 2);
+            double sin_dlon = Trig::sin(dlon / 2);
+            elev[k] = sin_dlat * sin_dlat +
+                      gs_cos_lat * sat_cos_lat[begin + k] * sin_dlon * sin_dlon;
+        }
+        for (int k = 0; k < n; k++) {
+            double ground_dist_km = EARTH_RADIUS_KM * (2 * Trig::asin(std::sqrt(elev[k])));
+            elev[k] = ground_dist_km / EARTH_RADIUS_KM;  // central angle
+        }
+        for (int k = 0; k < n; k++) {
+            double r_sat = EARTH_RADIUS_KM + satellites_[begin + k].altitude_km;
+            slant[k] = std::sqrt(
+                EARTH_RADIUS_KM * EARTH_RADIUS_KM +
+                r_sat * r_sat -
+                2 * EARTH_RADIUS_KM * r_sat * Trig::cos(elev[k]));
+        }
+        for (int k = 0; k < n; k++) {
+            double r_sat = EARTH_RADIUS_KM + satellites_[begin + k].altitude_km;
+            double cos_elevation = (slant[k] * slant[k] +
+                                    EARTH_RADIUS_KM * EARTH_RADIUS_KM -
+                                    r_sat * r_sat) /
+                                   (2 * slant[k] * EARTH_RADIUS_KM);
+            double angle_at_station = Trig::acos(std::clamp(cos_elevation, -1.0, 1.0));
+            elev[k] = slant[k] < 1e-6 ? 90.0 : (angle_at_station * RAD_TO_DEG) - 90.0;
+        }
+    }
+
+    void build(int num_threads, std::pmr::memory_resource* const* thread_mem,
+               bool verbose) {
+        if (trig_ == TrigMode::POLY) {
+            buildGraph<PolyTrig>(num_threads, thread_mem, verbose);
+        } else {
+            buildGraph<LibmTrig>(num_threads, thread_mem, verbose);
+        }
+    }
+
+    template<typename Trig>
+    void buildGraph(int num_threads, std::pmr::memory_resource* const* thread_mem,
+                    bool verbose) {
         int N = static_cast<int>(satellites_.size());
         int chunk_size = (N + num_threads - 1) / num_threads;
-
-        std::vector<std::thread> threads;
-        std::vector<std::vector<VisibilityEdge>> thread_results(num_threads);
+        auto memFor = [thread_mem](int t) {
+            return thread_mem ? thread_mem[t] : std::pmr::new_delete_resource();
+        };
+
+        // Each worker's results live in its own arena; the wrapper keeps
+        // the outer vector from handing its allocator down to them.
+        struct ThreadEdges {
+            std::pmr::vector<VisibilityEdge> edges;
+        };
+        std::pmr::vector<std::thread> threads(memFor(0));
+        threads.reserve(num_threads);
+        std::pmr::vector<ThreadEdges> thread_results(memFor(0));
+        thread_results.reserve(num_threads);
+        for (int t = 0; t < num_threads; t++) {
+            thread_results.push_back({std::pmr::vector<VisibilityEdge>(memFor(t))});
+        }
 
         auto start = std::chrono::high_resolution_clock::now();
 
+        std::pmr::vector<double> sat_cos_lat(N, memFor(0));
+        for (int i = 0; i < N; i++) {
+            sat_cos_lat[i] = Trig::cos(satellites_[i].position.lat_deg * DEG_TO_RAD);
+        }
+
         for (int t = 0; t < num_threads; t++) {
             int begin = t * chunk_size;
             int end = std::min(begin + chunk_size, N);
 
-            threads.emplace_back([this, begin, end, t, &thread_results]() {
-                for (int i = begin; i < end; i++) {
-                    const auto& sat = satellites_[i];
-                    for (int j = 0; j < static_cast<int>(stations_.size()); j++) {
-                        const auto& gs = stations_[j];
-                        double elev = computeElevationAngle(
-                            gs.position, sat.position, sat.altitude_km);
-
-                        if (elev >= gs.min_elevation_deg) {
-                            // Compute slant range for latency
-                            double ground_dist = haversineDistanceKm(
-                                gs.position, sat.position);
-                            double central_angle = ground_dist / EARTH_RADIUS_KM;
-                            double r_sat = EARTH_RADIUS_KM + sat.altitude_km;
-                            double slant = std::sqrt(
-                                EARTH_RADIUS_KM * EARTH_RADIUS_KM +
-                                r_sat * r_sat -
-                                2 * EARTH_RADIUS_KM * r_sat *
-                                    std::cos(central_angle));
-
-                            thread_results[t].push_back({
-                                sat.id, gs.id, elev, slant,
-                                computeLatencyMs(slant)});
+            std::pmr::memory_resource* mem = memFor(t);
+            threads.emplace_back([this, begin, end, t, mem, &thread_results, &sat_cos_lat]() {
+                int M = static_cast<int>(stations_.size());
+                PerfPhase perf("visibility build", static_cast<uint64_t>(end - begin) * M);
+                std::pmr::vector<double> elev(static_cast<size_t>(M) * PAIR_BLOCK, mem);
+                std::pmr::vector<double> slant(elev.size(), mem);
+
+                for (int b = begin; b < end; b += PAIR_BLOCK) {
+                    int n = std::min(PAIR_BLOCK, end - b);
+                    for (int j = 0; j < M; j++) {
+                        pairBlock<Trig>(stations_[j], b, n, sat_cos_lat,
+                                        &elev[j * PAIR_BLOCK], &slant[j * PAIR_BLOCK]);
+                    }
+                    // Emit satellite-major, as the per-pair loop did
+                    for (int k = 0; k < n; k++) {
+                        for (int j = 0; j < M; j++) {
+                            double e = elev[j * PAIR_BLOCK + k];
+                            if (e >= stations_[j].min_elevation_deg) {
+                                double s = slant[j * PAIR_BLOCK + k];
+                                thread_results[t].edges.push_back({
+                                    satellites_[b + k].id, stations_[j].id, e, s,
+                                    computeLatencyMs(s)});
+                            }
                         }
                     }
                 }
@@ -345,27 +676,32 @@ private:
 
         // Merge results
         for (const auto& results : thread_results) {
-            edges_.insert(edges_.end(), results.begin(), results.end());
+            edges_.insert(edges_.end(), results.edges.begin(), results.edges.end());
         }
 
         auto elapsed = std::chrono::high_resolution_clock::now() - start;
         double ms = std::chrono::duration<double, std::milli>(elapsed).count();
-        std::cout << "Visibility graph built in " << ms << " ms ("
-                  << num_threads << " threads)\n";
+        if (verbose) {
+            std::cout << "Visibility graph built in " << ms << " ms ("
+                      << num_threads << " threads)\n";
+        }
     }
 
     std::vector<Satellite> satellites_;
     std::vector<GroundStation> stations_;
     std::vector<VisibilityEdge> edges_;
+    TrigMode trig_;
 };
 
 // ============================================================
 // Constellation Generator (Starlink-like Walker constellation)
 // ============================================================
 
+template<typename Trig = LibmTrig>
 std::vector<Satellite> generateStarlinkConstellation(
     int num_planes, int sats_per_plane, double altitude_km,
     double inclination_deg) {
+    PerfPhase perf("constellation", static_cast<uint64_t>(num_planes) * sats_per_plane);
     std::vector<Satellite> sats;
     int id = 0;
 
@@ -377,8 +713,8 @@ std::vector<Satellite> generateStarlinkConstellation(
 
             // Convert orbital elements to lat/lon (simplified)
             double angle = (raan + true_anomaly) * DEG_TO_RAD;
-            double lat = inclination_deg * std::sin(angle);
-            double lon = std::fmod(raan + true_anomaly * std::cos(inclination_deg * DEG_TO_RAD), 360.0) - 180.0;
+            double lat = inclination_deg * Trig::sin(angle);
+            double lon = std::fmod(raan + true_anomaly * Trig::cos(inclination_deg * DEG_TO_RAD), 360.0) - 180.0;
 
             sats.push_back({
                 id++,
@@ -430,11 +766,239 @@ std::vector<GroundStation> generateGroundStations(int count) {
     return stations;
 }
 
+// ============================================================
+// Trig Benchmark
+// ============================================================
+
+struct Args {
+    std::string trig = "poly";  // libm | poly
+    bool trig_bench = false;
+    bool perf = false;
+    bool alloc = false;
+    int ticks = 0;              // > 0: 10 Hz rebuild + analysis loop, heap vs arena
+};
+
+void printUsage(const char* prog) {
+    std::cout << "Usage: " << prog << " [options]\n\n"
+              << "Options:\n"
+              << "  --trig MODE     Trig kernels: poly (default) | libm\n"
+              << "  --trig-bench    Time libm vs poly per satellite-station pair\n"
+              << "  --ticks N       Run N 10 Hz ticks, heap vs per-tick arena\n"
+              << "  --perf          Per-phase hardware counters (IPC, LLC/branch misses)\n"
+              << "  --alloc         Per-phase heap bytes, allocation counts, peak RSS\n"
+              << "  --help          Show this message\n";
+}
+
+bool parseArgs(int argc, char** argv, Args& args) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--trig" && i + 1 < argc) {
+            args.trig = argv[++i];
+        } else if (arg == "--trig-bench") {
+            args.trig_bench = true;
+        } else if (arg == "--perf") {
+            args.perf = true;
+        } else if (arg == "--alloc") {
+            args.alloc = true;
+        } else if (arg == "--ticks" && i + 1 < argc) {
+            args.ticks = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return false;
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    if (args.trig != "libm" && args.trig != "poly") {
+        std::cerr << "--trig must be libm or poly\n";
+        return false;
+    }
+    return true;
+}
+
+// Full Gen1 shell against the 20 stations, single-threaded so the
+// per-pair cost is not hidden behind thread start-up.
+int runTrigBench() {
+    constexpr int REPS = 20;
+    auto satellites = generateStarlinkConstellation(72, 22, 550.0, 53.0);
+    auto stations = generateGroundStations(20);
+    double pairs = static_cast<double>(satellites.size()) * stations.size();
+
+    auto time_mode = [&](TrigMode mode, std::vector<VisibilityEdge>& edges) {
+        double best = 1e300;
+        for (int r = 0; r < REPS; r++) {
+            auto start = std::chrono::steady_clock::now();
+            VisibilityGraph graph(satellites, stations, 1, mode, false);
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, std::chrono::duration<double, std::nano>(elapsed).count());
+            if (r == 0) edges = graph.edges();
+        }
+        return best / pairs;
+    };
+
+    std::vector<VisibilityEdge> libm_edges, poly_edges;
+    double libm_ns = time_mode(TrigMode::LIBM, libm_edges);
+    double poly_ns = time_mode(TrigMode::POLY, poly_edges);
+
+    size_t mismatches = libm_edges.size() == poly_edges.size() ? 0
+        : std::max(libm_edges.size(), poly_edges.size());
+    double max_elev_diff = 0.0;
+    for (size_t i = 0; mismatches == 0 && i < libm_edges.size(); i++) {
+        const auto& a = libm_edges[i];
+        const auto& b = poly_edges[i];
+        if (a.satellite_id != b.satellite_id || a.station_id != b.station_id) mismatches++;
+        max_elev_diff = std::max(max_elev_diff, std::abs(a.elevation_deg - b.elevation_deg));
+    }
+
+    // Constellation generator: same positions to within a few ulp
+    auto sats_libm = generateStarlinkConstellation<LibmTrig>(72, 22, 550.0, 53.0);
+    auto sats_poly = generateStarlinkConstellation<PolyTrig>(72, 22, 550.0, 53.0);
+    double max_pos_diff = 0.0;
+    for (size_t i = 0; i < sats_libm.size(); i++) {
+        max_pos_diff = std::max({max_pos_diff,
+            std::abs(sats_libm[i].position.lat_deg - sats_poly[i].position.lat_deg),
+            std::abs(sats_libm[i].position.lon_deg - sats_poly[i].position.lon_deg)});
+    }
+
+    std::printf("Trig kernels: %zu sats x %zu stations, best of %d\n",
+                satellites.size(), stations.size(), REPS);
+    std::printf("  libm  %6.1f ns/pair  %zu edges\n", libm_ns, libm_edges.size());
+    std::printf("  poly  %6.1f ns/pair  %zu edges  (%.2fx)\n",
+                poly_ns, poly_edges.size(), libm_ns / poly_ns);
+    std::printf("  edge mismatches: %zu, max elevation diff %.3g deg, "
+                "max position diff %.3g deg\n", mismatches, max_elev_diff, max_pos_diff);
+    return mismatches == 0 ? 0 : 1;
+}
+
+// ============================================================
+// Tick Loop
+// ============================================================
+// The solver's real duty cycle: every 100 ms advance the constellation,
+// rebuild the graph and rerun the analyses. Run once with every
+// transient container on a counting new/delete resource and once on
+// per-thread TickArenas reset at the end of each tick.
+int runTicks(int ticks, TrigMode trig) {
+    constexpr double TICK_SEC = 0.1;
+    constexpr double TRACK_DEG_PER_SEC = 360.0 / 5730.0;  // ~95.5 min period at 550 km
+    const int num_threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+    auto base = generateStarlinkConstellation(36, 20, 550.0, 53.0);
+    auto stations = generateGroundStations(20);
+    std::vector<Satellite> sats = base;
+    std::ostream sink(nullptr);  // printStats output is discarded
+
+    struct ModeResult {
+        double us_per_tick = 0;
+        double analysis_us_per_tick = 0;  // the three analyses + arena reset
+        uint64_t heap_allocations = 0;
+        uint64_t checksum = 0;  // edges, cover set and critical set sizes
+    };
+
+    auto runMode = [&](std::pmr::memory_resource* const* thread_mem,
+                       const std::function<void()>& end_tick) {
+        VisibilityGraph graph(base, stations, num_threads, trig, false);
+        ModeResult result;
+        auto start = std::chrono::steady_clock::now();
+        for (int tick = 0; tick < ticks; tick++) {
+            double shift = tick * TICK_SEC * TRACK_DEG_PER_SEC;
+            for (size_t i = 0; i < sats.size(); i++) {
+                sats[i].position.lon_deg =
+                    std::fmod(base[i].position.lon_deg + 180.0 + shift, 360.0) - 180.0;
+            }
+            graph.rebuild(sats, num_threads, thread_mem);
+            auto analysis_start = std::chrono::steady_clock::now();
+            {
+                auto cover = graph.minimumCoverageSatellites(thread_mem[0]);
+                auto critical = graph.findCriticalSatellites(thread_mem[0]);
+                graph.printStats(sink, thread_mem[0]);
+                result.checksum = result.checksum * 31 + graph.edges().size();
+                result.checksum = result.checksum * 31 + cover.size();
+                result.checksum = result.checksum * 31 + critical.size();
+            }
+            end_tick();
+            result.analysis_us_per_tick += std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - analysis_start).count();
+        }
+        result.analysis_us_per_tick /= ticks;
+        result.us_per_tick = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - start).count() / ticks;
+        return result;
+    };
+
+    // minimumCoverageSatellites warns on every tick it cannot cover
+    std::streambuf* cerr_buf = std::cerr.rdbuf(nullptr);
+
+    std::vector<CountingResource> counters(num_threads);
+    std::vector<std::pmr::memory_resource*> counter_mem;
+    for (auto& c : counters) counter_mem.push_back(&c);
+    ModeResult heap = runMode(counter_mem.data(), [] {});
+    for (const auto& c : counters) heap.heap_allocations += c.allocations();
+
+    std::vector<TickArena> arenas(num_threads);
+    std::vector<std::pmr::memory_resource*> arena_mem;
+    for (auto& a : arenas) arena_mem.push_back(&a);
+    ModeResult arena = runMode(arena_mem.data(), [&] {
+        for (auto& a : arenas) a.reset();
+    });
+    uint64_t served = 0, upstream = 0, regrows = 0;
+    size_t block = 0;
+    for (const auto& a : arenas) {
+        served += a.allocations();
+        upstream += a.upstreamAllocations();
+        regrows += a.regrows();
+        block += a.capacity();
+    }
+    arena.heap_allocations = upstream;
+
+    std::cerr.rdbuf(cerr_buf);
+
+    std::printf("Tick loop: %d ticks at %.0f Hz, %zu sats x %zu stations, %d threads\n",
+                ticks, 1.0 / TICK_SEC, base.size(), stations.size(), num_threads);
+    std::printf("  heap   %8.1f us/tick (analyses %6.1f us)  %8.1f heap allocations/tick\n",
+                heap.us_per_tick, heap.analysis_us_per_tick,
+                static_cast<double>(heap.heap_allocations) / ticks);
+    std::printf("  arena  %8.1f us/tick (analyses %6.1f us)  %8.1f heap allocations/tick "
+                "(%llu total, %llu regrows, %zu KB of blocks)\n",
+                arena.us_per_tick, arena.analysis_us_per_tick,
+                static_cast<double>(arena.heap_allocations) / ticks,
+                static_cast<unsigned long long>(upstream),
+                static_cast<unsigned long long>(regrows), block / 1024);
+    std::printf("  dropped %.1f heap allocations and %.1f us of analysis time per tick "
+                "(%.1f%%), %.1f arena allocations/tick, results %s\n",
+                static_cast<double>(heap.heap_allocations - arena.heap_allocations) / ticks,
+                heap.analysis_us_per_tick - arena.analysis_us_per_tick,
+                100.0 * (heap.analysis_us_per_tick - arena.analysis_us_per_tick) /
+                    heap.analysis_us_per_tick,
+                static_cast<double>(served) / ticks,
+                heap.checksum == arena.checksum ? "identical" : "MISMATCH");
+    return heap.checksum == arena.checksum ? 0 : 1;
+}
+
 // ============================================================
 // Main
 // ============================================================
 
-int main() {
+int main(int argc, char** argv) {
+    Args args;
+    if (!parseArgs(argc, argv, args)) {
+        return 0;
+    }
+    if (args.perf) PerfReport::instance().enable();
+    if (args.alloc) PerfReport::instance().enableAlloc();
+    if (args.trig_bench) {
+        int rc = runTrigBench();
+        PerfReport::instance().print();
+        return rc;
+    }
+    TrigMode trig = args.trig == "libm" ? TrigMode::LIBM : TrigMode::POLY;
+    if (args.ticks > 0) {
+        int rc = runTicks(args.ticks, trig);
+        PerfReport::instance().print();
+        return rc;
+    }
+
     std::cout << "╔══════════════════════════════════════════════╗\n";
     std::cout << "║  Starlink Constellation Visibility Solver    ║\n";
     std::cout << "║  Stuart Ray — Interview Prep Project         ║\n";
@@ -453,12 +1017,16 @@ int main() {
               << SATS_PER_PLANE << " sats = " << NUM_PLANES * SATS_PER_PLANE
               << " satellites at " << ALTITUDE_KM << " km\n\n";
 
-    auto satellites = generateStarlinkConstellation(
-        NUM_PLANES, SATS_PER_PLANE, ALTITUDE_KM, INCLINATION_DEG);
+    auto satellites = trig == TrigMode::POLY
+        ? generateStarlinkConstellation<PolyTrig>(
+              NUM_PLANES, SATS_PER_PLANE, ALTITUDE_KM, INCLINATION_DEG)
+        : generateStarlinkConstellation<LibmTrig>(
+              NUM_PLANES, SATS_PER_PLANE, ALTITUDE_KM, INCLINATION_DEG);
     auto stations = generateGroundStations(NUM_GROUND_STATIONS);
 
     // Build visibility graph
-    VisibilityGraph graph(satellites, stations);
+    VisibilityGraph graph(satellites, stations,
+                          std::thread::hardware_concurrency(), trig);
     graph.printStats();
 
     // Find minimum coverage set
@@ -490,5 +1058,6 @@ int main() {
                   << "°): " << visible.size() << " satellites visible\n";
     }
 
+    PerfReport::instance().print();
     return 0;
 }
@@ -0,0 +1,307 @@
+/**
+ * Perf Counters
+ * =============
+ * --perf: hardware counters around named phases. Every thread that
+ * runs part of a phase opens its own perf_event_open group (this thread,
+ * user space only), so workers count their own work and the report
+ * merges them by phase name.
+ *
+ * Events the kernel or the container refuses are left out. With none
+ * at all (perf_event_paranoid, seccomp, no PMU in the VM) the report
+ * keeps wall and task-clock time and marks the rest n/a. When --perf
+ * is off a PerfPhase is one branch.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "alloc_tracker.h"
+
+enum PerfEvent { PERF_TASK_CLOCK, PERF_CYCLES, PERF_INSTRUCTIONS,
+                 PERF_LLC_MISSES, PERF_BRANCH_MISSES, PERF_NUM_EVENTS };
+
+struct PerfSample {
+    uint64_t value[PERF_NUM_EVENTS] = {};
+    bool valid[PERF_NUM_EVENTS] = {};
+};
+
+struct AllocSample {
+    uint64_t allocs = 0;
+    uint64_t bytes = 0;
+    int64_t peak_bytes = 0;
+    long rss_kb = 0;
+};
+
+class PerfCounterGroup {
+public:
+    PerfCounterGroup() {
+#ifdef __linux__
+        const std::pair<uint32_t, uint64_t> events[PERF_NUM_EVENTS] = {
+            {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL |
+                                 (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        };
+        for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = events[e].first;
+            attr.config = events[e].second;
+            attr.disabled = leader_ < 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader_, 0));
+            if (fd < 0) continue;
+            if (leader_ < 0) leader_ = fd;
+            fds_[count_] = fd;
+            slot_[count_++] = e;
+        }
+#endif
+    }
+
+    ~PerfCounterGroup() {
+#ifdef __linux__
+        for (int i = 0; i < count_; i++) close(fds_[i]);
+#endif
+    }
+
+    PerfCounterGroup(const PerfCounterGroup&) = delete;
+    PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+    void start() {
+#ifdef __linux__
+        if (leader_ < 0) return;
+        ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+    PerfSample stop() {
+        PerfSample s;
+#ifdef __linux__
+        if (leader_ < 0) return s;
+        ioctl(leader_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        uint64_t buf[1 + PERF_NUM_EVENTS] = {};
+        if (read(leader_, buf, sizeof(buf)) < static_cast<ssize_t>(sizeof(uint64_t))) return s;
+        for (uint64_t i = 0; i < buf[0] && i < static_cast<uint64_t>(count_); i++) {
+            s.value[slot_[i]] = buf[1 + i];
+            s.valid[slot_[i]] = true;
+        }
+#endif
+        return s;
+    }
+
+private:
+    int leader_ = -1;
+    int count_ = 0;
+    int fds_[PERF_NUM_EVENTS] = {};
+    int slot_[PERF_NUM_EVENTS] = {};
+};
+
+class PerfReport {
+public:
+    static PerfReport& instance() {
+        static PerfReport report;
+        return report;
+    }
+
+    bool enabled() const { return counters_ || alloc_; }
+    bool counters() const { return counters_; }
+    bool alloc() const { return alloc_; }
+    void enable() { counters_ = true; }
+    void enableAlloc() {
+        alloc_ = true;
+        g_alloc_tracking.store(true, std::memory_order_relaxed);
+    }
+
+    void add(const char* phase, double wall_ms, uint64_t items, const PerfSample& s,
+             const AllocSample& a) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find_if(phases_.begin(), phases_.end(),
+                               [&](const Phase& p) { return p.name == phase; });
+        if (it == phases_.end()) it = phases_.insert(phases_.end(), Phase{phase});
+        it->scopes++;
+        it->wall_ms += wall_ms;  // summed over scopes, so parallel workers add up
+        it->items += items;
+        for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+            if (!s.valid[e]) continue;
+            it->value[e] += s.value[e];
+            it->samples[e]++;
+        }
+        it->allocs += a.allocs;
+        it->alloc_bytes += a.bytes;
+        it->peak_bytes = std::max(it->peak_bytes, a.peak_bytes);
+        it->rss_kb = std::max(it->rss_kb, a.rss_kb);
+    }
+
+    void print() const {
+        if (counters_) printCounters();
+        if (alloc_) printAlloc();
+    }
+
+private:
+    struct Phase {
+        std::string name;
+        int scopes = 0;  // PerfPhase instances, one per thread per call
+        double wall_ms = 0;
+        uint64_t items = 0;
+        uint64_t value[PERF_NUM_EVENTS] = {};
+        int samples[PERF_NUM_EVENTS] = {};
+        uint64_t allocs = 0;
+        uint64_t alloc_bytes = 0;
+        int64_t peak_bytes = 0;  // largest single scope
+        long rss_kb = 0;
+    };
+
+    void printCounters() const {
+        if (phases_.empty()) return;
+        std::printf("\n=== Perf counters ===\n");
+        std::printf("%-22s %5s %9s %9s %10s %6s %10s %11s\n", "phase", "n", "wall ms",
+                    "cpu ms", "items", "IPC", "LLC/item", "brmiss/item");
+        bool any_hw = false;
+        for (const auto& p : phases_) {
+            auto full = [&](int e) { return p.samples[e] == p.scopes; };
+            auto perItem = [&](int e, char* out) {
+                if (full(e) && p.items > 0) {
+                    std::snprintf(out, 16, "%.3f", static_cast<double>(p.value[e]) / p.items);
+                } else {
+                    std::snprintf(out, 16, "n/a");
+                }
+            };
+            char cpu[16], ipc[16], llc[16], br[16];
+            if (full(PERF_TASK_CLOCK)) {
+                std::snprintf(cpu, sizeof(cpu), "%.2f", p.value[PERF_TASK_CLOCK] / 1e6);
+            } else {
+                std::snprintf(cpu, sizeof(cpu), "n/a");
+            }
+            if (full(PERF_CYCLES) && full(PERF_INSTRUCTIONS) && p.value[PERF_CYCLES] > 0) {
+                std::snprintf(ipc, sizeof(ipc), "%.2f",
+                              static_cast<double>(p.value[PERF_INSTRUCTIONS]) /
+                                  p.value[PERF_CYCLES]);
+                any_hw = true;
+            } else {
+                std::snprintf(ipc, sizeof(ipc), "n/a");
+            }
+            perItem(PERF_LLC_MISSES, llc);
+            perItem(PERF_BRANCH_MISSES, br);
+            std::printf("%-22s %5d %9.2f %9s %10llu %6s %10s %11s\n", p.name.c_str(),
+                        p.scopes, p.wall_ms, cpu, static_cast<unsigned long long>(p.items),
+                        ipc, llc, br);
+        }
+        if (!any_hw) {
+            std::printf("(hardware counters unavailable here - perf_event_paranoid, "
+                        "container seccomp or no PMU; wall/cpu time only)\n");
+        }
+    }
+
+    // Peak MB is the largest growth of live heap within one scope; RSS
+    // is the process high-water mark when the phase ended.
+    void printAlloc() const {
+        if (phases_.empty()) return;
+        std::printf("\n=== Heap allocations ===\n");
+        std::printf("%-22s %5s %10s %10s %9s %9s %9s\n", "phase", "n", "allocs",
+                    "alloc MB", "peak MB", "B/item", "RSS MB");
+        for (const auto& p : phases_) {
+            char per_item[16];
+            if (p.items > 0) {
+                std::snprintf(per_item, sizeof(per_item), "%.1f",
+                              static_cast<double>(p.alloc_bytes) / p.items);
+            } else {
+                std::snprintf(per_item, sizeof(per_item), "n/a");
+            }
+            std::printf("%-22s %5d %10llu %10.2f %9.2f %9s %9.1f\n", p.name.c_str(),
+                        p.scopes, static_cast<unsigned long long>(p.allocs),
+                        p.alloc_bytes / 1048576.0, p.peak_bytes / 1048576.0, per_item,
+                        p.rss_kb / 1024.0);
+        }
+        std::printf("%-22s %5s %10s %10s %9s %9s %9.1f\n", "(process)", "", "", "", "",
+                    "", peakRssKb() / 1024.0);
+    }
+
+    bool counters_ = false;
+    bool alloc_ = false;
+    mutable std::mutex mutex_;
+    std::vector<Phase> phases_;
+};
+
+// Counts the enclosing scope (or until stop()) on the calling thread
+// as part of `phase`
+class PerfPhase {
+public:
+    PerfPhase(const char* phase, uint64_t items = 0) : phase_(phase), items_(items) {
+        PerfReport& report = PerfReport::instance();
+        if (!report.enabled()) return;
+        active_ = true;
+        if (report.counters()) group_ = std::make_unique<PerfCounterGroup>();
+        if (report.alloc()) {
+            // Peak restarts at the current live size; stop() folds it back
+            // into the enclosing phase's peak. The heap is process-wide, so
+            // a phase overlapping one on another thread may lose the part
+            // of its peak reached before the other phase started
+            alloc_start_ = t_alloc;
+            live_start_ = g_alloc_live.load(std::memory_order_relaxed);
+            peak_saved_ = g_alloc_peak.exchange(live_start_, std::memory_order_relaxed);
+        }
+        start_ = std::chrono::steady_clock::now();
+        if (group_) group_->start();
+    }
+
+    ~PerfPhase() { stop(); }
+
+    // Ends the phase before the scope does
+    void stop() {
+        if (!active_) return;
+        active_ = false;
+        PerfSample s;
+        if (group_) s = group_->stop();
+        double ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start_).count();
+        AllocSample a;
+        if (PerfReport::instance().alloc()) {
+            AllocCounters& c = t_alloc;
+            a.allocs = c.allocs - alloc_start_.allocs;
+            a.bytes = c.bytes - alloc_start_.bytes;
+            a.peak_bytes = std::max<int64_t>(
+                0, g_alloc_peak.load(std::memory_order_relaxed) - live_start_);
+            a.rss_kb = peakRssKb();
+            raiseAllocPeak(peak_saved_);
+        }
+        PerfReport::instance().add(phase_, ms, items_, s, a);
+        group_.reset();
+    }
+
+    void setItems(uint64_t items) { items_ = items; }
+
+    PerfPhase(const PerfPhase&) = delete;
+    PerfPhase& operator=(const PerfPhase&) = delete;
+
+private:
+    const char* phase_;
+    uint64_t items_;
+    bool active_ = false;
+    std::unique_ptr<PerfCounterGroup> group_;
+    AllocCounters alloc_start_;
+    int64_t live_start_ = 0;
+    int64_t peak_saved_ = 0;
+    std::chrono::steady_clock::time_point start_;
+};
@@ -9,18 +9,40 @@
  */
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <numeric>
+#include <queue>
 #include <random>
+#include <set>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "alloc_tracker.h"
+#include "perf_counters.h"
+
 #ifndef VISUALIZER_DATA_DIR
 #define VISUALIZER_DATA_DIR "."
 #endif
@@ -32,6 +54,120 @@ constexpr double EARTH_RADIUS_KM = 6371.0;
 constexpr double DEG_TO_RAD = M_PI / 180.0;
 constexpr double RAD_TO_DEG = 180.0 / M_PI;
 
+// ============================================================
+// Polynomial Trig
+// ============================================================
+// Branch-free minimax kernels for the constellation generator, selected
+// at runtime against libm through the Trig template parameter. sin/cos use
+// Cody-Waite reduction to [-pi/4, pi/4] and the Cephes minimax
+// polynomials; asin/acos fold onto [0, 0.5] (asin(x) = pi/2 -
+// 2 asin(sqrt((1-x)/2)) above it) with a degree-11 Remez fit in x²;
+// atan2 reduces to |t| <= tan(pi/12) with a degree-7 fit. Both branches
+// of each fold share one polynomial evaluation: no data-dependent
+// branches, so loops over them vectorize where the target ISA allows.
+//
+// Max error against long double libm over 2e7 random arguments
+// (asserted in test_visibility):
+//   sin, cos  < 2.5 ulp for |x| <= 1e5
+//   asin      < 3 ulp, acos < 1.5 ulp on [-1, 1]
+//   atan2     < 4.5 ulp
+// Elevation errors stay below 1e-11 degrees, far below any mask,
+// and the visibility edge set is unchanged.
+struct LibmTrig {
+    template<typename T> static T sin(T x) { return std::sin(x); }
+    template<typename T> static T cos(T x) { return std::cos(x); }
+    template<typename T> static T asin(T x) { return std::asin(x); }
+    template<typename T> static T acos(T x) { return std::acos(x); }
+    template<typename T> static T atan2(T y, T x) { return std::atan2(y, x); }
+};
+
+struct PolyTrig {
+    static double sin(double x) { return sinCosQuadrant(x, 0); }
+    static double cos(double x) { return sinCosQuadrant(x, 1); }
+
+    static double asin(double x) {
+        double a = std::abs(x);
+        bool small = a <= 0.5;
+        double z = small ? a * a : (1.0 - a) * 0.5;
+        double s = small ? a : std::sqrt(z);
+        double p = s + s * z * asinPoly(z);
+        double r = small ? p : PIO2_HI - (2.0 * p - PIO2_LO);
+        return std::copysign(r, x);
+    }
+
+    static double acos(double x) {
+        double a = std::abs(x);
+        bool small = a <= 0.5;
+        double z = small ? x * x : (1.0 - a) * 0.5;
+        double s = small ? x : std::sqrt(z);
+        double p = s + s * z * asinPoly(z);
+        if (small) return PIO2_HI - (p - PIO2_LO);
+        return x > 0 ? 2.0 * p : PI_HI - (2.0 * p - PI_LO);
+    }
+
+    static double atan2(double y, double x) {
+        double ax = std::abs(x), ay = std::abs(y);
+        double hi = std::max(ax, ay), lo = std::min(ax, ay);
+        double t = hi > 0 ? lo / hi : 0.0;                     // [0, 1]
+        bool fold = t > TAN_PI_12;
+        double u = fold ? (t * SQRT3 - 1.0) / (t + SQRT3) : t;  // |u| <= tan(pi/12)
+        double w = u * u;
+        double r = u + u * w * atanPoly(w) + (fold ? PI_6 : 0.0);
+        r = ay > ax ? PIO2_HI - r + PIO2_LO : r;
+        r = x < 0 ? PI_HI - r + PI_LO : r;
+        return std::copysign(r, y);
+    }
+
+private:
+    static constexpr double PIO2_HI = 1.57079632679489655800e+00;
+    static constexpr double PIO2_LO = 6.12323399573676588613e-17;
+    static constexpr double PI_HI = 3.14159265358979311600e+00;
+    static constexpr double PI_LO = 1.22464679914735317720e-16;
+    static constexpr double PI_6 = 5.23598775598298815658e-01;
+    static constexpr double SQRT3 = 1.73205080756887719318e+00;
+    static constexpr double TAN_PI_12 = 2.67949192431122706473e-01;
+
+    // x = k pi/2 + r, then the quadrant picks sin/cos and sign
+    static double sinCosQuadrant(double x, int shift) {
+        constexpr double TWO_OVER_PI = 6.36619772367581382433e-01;
+        constexpr double PIO2_1 = 1.57079632673412561417e+00;   // first 33 bits
+        constexpr double PIO2_2 = 6.07710050630396597660e-11;   // next 33 bits
+        constexpr double PIO2_3 = 2.02226624871116645580e-21;   // tail
+        constexpr double ROUND = 6755399441055744.0;            // 1.5 * 2^52
+        double k = (x * TWO_OVER_PI + ROUND) - ROUND;
+        double r = ((x - k * PIO2_1) - k * PIO2_2) - k * PIO2_3;
+        int q = static_cast<int>(static_cast<int64_t>(k)) + shift;
+        double z = r * r;
+        double s = r + r * z * (-1.66666666666666307295e-1 + z * (8.33333333332211858878e-3 +
+                   z * (-1.98412698295895385996e-4 + z * (2.75573136213857245213e-6 +
+                   z * (-2.50507477628578072866e-8 + z * 1.58962301576546568060e-10)))));
+        double c = 1.0 - 0.5 * z + z * z * (4.16666666666665929218e-2 +
+                   z * (-1.38888888888730564116e-3 + z * (2.48015872888517045348e-5 +
+                   z * (-2.75573141792967388112e-7 + z * (2.08757008419747316778e-9 +
+                   z * -1.13585365213876817300e-11)))));
+        double v = (q & 1) ? c : s;
+        return (q & 2) ? -v : v;
+    }
+
+    // (asin(sqrt z) - sqrt z) / z^1.5 on [0, 0.25]
+    static double asinPoly(double z) {
+        return 0.16666666666666646 + z * (0.075000000000232631 + z * (0.044642857099408392 +
+               z * (0.030381947618578847 + z * (0.022372039558540002 +
+               z * (0.017355411078687454 + z * (0.013927890026116782 +
+               z * (0.011888696520972233 + z * (0.0077394544038220806 +
+               z * (0.016225090021533179 + z * (-0.01106884778146988 +
+               z * 0.028402137158083294))))))))));
+    }
+
+    // (atan(sqrt w) - sqrt w) / w^1.5 on [0, tan²(pi/12)]
+    static double atanPoly(double w) {
+        return -0.33333333333333248 + w * (0.19999999999846665 + w * (-0.14285714240489927 +
+               w * (0.11111106023348163 + w * (-0.090906272982633721 +
+               w * (0.076837908710856925 + w * (-0.065226117213869617 +
+               w * 0.04580788442090232))))));
+    }
+};
+
 // ============================================================
 // Utility
 // ============================================================
@@ -51,13 +187,95 @@ std::string jsonEscape(const std::string& s) {
     return out;
 }
 
+// ============================================================
+// Counter-Based RNG (Philox4x32-10)
+// ============================================================
+// A mt19937 stream has to be drawn in order, so handing its work to
+// several threads changes what each item gets. Philox instead maps
+// (key, counter) to four random words with a pure function: the key is
+// the seed plus a stream id, the counter is the item's position, and
+// item i draws the same values no matter which thread computes it or
+// in what order.
+
+class Philox4x32 {
+public:
+    using Block = std::array<uint32_t, 4>;
+
+    Philox4x32(uint64_t seed, uint64_t stream)
+        : key_{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)},
+          stream_(stream) {}
+
+    // The four words at position `index` of this stream
+    Block at(uint64_t index) const {
+        return rounds({static_cast<uint32_t>(index), static_cast<uint32_t>(index >> 32),
+                       static_cast<uint32_t>(stream_), static_cast<uint32_t>(stream_ >> 32)},
+                      key_);
+    }
+
+    // The ten rounds of the Random123 reference (counter, key) -> block
+    static Block rounds(Block ctr, std::array<uint32_t, 2> key) {
+        constexpr uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+        constexpr uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+        for (int r = 0; r < 10; r++) {
+            if (r > 0) {
+                key[0] += W0;
+                key[1] += W1;
+            }
+            uint64_t p0 = static_cast<uint64_t>(M0) * ctr[0];
+            uint64_t p1 = static_cast<uint64_t>(M1) * ctr[2];
+            ctr = {static_cast<uint32_t>(p1 >> 32) ^ ctr[1] ^ key[0],
+                   static_cast<uint32_t>(p1),
+                   static_cast<uint32_t>(p0 >> 32) ^ ctr[3] ^ key[1],
+                   static_cast<uint32_t>(p0)};
+        }
+        return ctr;
+    }
+
+    // Word -> [0, 1) with 32-bit resolution
+    static double unit(uint32_t x) { return (x + 0.5) * (1.0 / 4294967296.0); }
+
+    // Word -> [lo, hi] by multiply-shift (bias below 2^-20 for ranges < 4096)
+    static int range(uint32_t x, int lo, int hi) {
+        uint64_t span = static_cast<uint64_t>(hi - lo) + 1;
+        return lo + static_cast<int>((static_cast<uint64_t>(x) * span) >> 32);
+    }
+
+private:
+    std::array<uint32_t, 2> key_;
+    uint64_t stream_;
+};
+
+/**
+ * Runs fn(begin, end) over [0, n) in contiguous chunks, one per thread.
+ * Work keyed by index (e.g. Philox counters) gives the same result for
+ * any thread count.
+ */
+template<typename F>
+void parallelFor(size_t n, int threads, F&& fn) {
+    threads = std::max(1, std::min<int>(threads, static_cast<int>(n / 1024) + 1));
+    if (threads == 1) {
+        fn(size_t{0}, n);
+        return;
+    }
+    std::vector<std::thread> workers;
+    size_t chunk = (n + threads - 1) / threads;
+    for (int t = 0; t < threads; t++) {
+        size_t begin = std::min(n, t * chunk);
+        size_t end = std::min(n, begin + chunk);
+        workers.emplace_back([&fn, begin, end] { fn(begin, end); });
+    }
+    for (auto& w : workers) w.join();
+}
+
 // ============================================================
 // Visibility Graph Data
 // ============================================================
-struct GeoCoord {
-    double lat_deg;
-    double lon_deg;
+template<typename T>
+struct GeoCoordT {
+    T lat_deg;
+    T lon_deg;
 };
+using GeoCoord = GeoCoordT<double>;
 
 struct Satellite {
     int id;
@@ -82,12 +300,28 @@ struct ISLLink {
     int sat_b;
 };
 
+/**
+ * What a site can actually see above the global elevation mask.
+ * `min_elev_deg[b]` is the lowest usable elevation for azimuths in
+ * [b, b + 1) degrees clockwise from north (terrain, buildings). A
+ * phased-array terminal can also only steer within `fov_half_deg` of its
+ * boresight; 180 leaves the cone open.
+ */
+struct HorizonMask {
+    static constexpr int BINS = 360;
+    std::array<float, BINS> min_elev_deg{};
+    double boresight_az_deg = 0.0;
+    double boresight_el_deg = 90.0;
+    double fov_half_deg = 180.0;
+};
+
 struct GroundStation {
     int id;
     GeoCoord position;
     std::string name;
     double min_elevation_deg;
     double capacity_mbps;
+    std::shared_ptr<const HorizonMask> horizon;  // null: the global mask only
 };
 
 struct VisibilityEdge {
@@ -109,45 +343,52 @@ struct VisibilityStats {
     std::vector<int> coverage_counts;
 };
 
-double haversineDistanceKm(const GeoCoord& a, const GeoCoord& b) {
-    double dlat = (b.lat_deg - a.lat_deg) * DEG_TO_RAD;
-    double dlon = (b.lon_deg - a.lon_deg) * DEG_TO_RAD;
-    double lat1 = a.lat_deg * DEG_TO_RAD;
-    double lat2 = b.lat_deg * DEG_TO_RAD;
-    double h = std::sin(dlat / 2) * std::sin(dlat / 2) +
-               std::cos(lat1) * std::cos(lat2) *
-               std::sin(dlon / 2) * std::sin(dlon / 2);
-    double c = 2 * std::asin(std::sqrt(h));
-    return EARTH_RADIUS_KM * c;
+// Geometry is templated on the scalar type: double is the reference,
+// float feeds the SIMD visibility filter below.
+template<typename T>
+T haversineDistanceKm(const GeoCoordT<T>& a, const GeoCoordT<T>& b) {
+    T dlat = (b.lat_deg - a.lat_deg) * T(DEG_TO_RAD);
+    T dlon = (b.lon_deg - a.lon_deg) * T(DEG_TO_RAD);
+    T lat1 = a.lat_deg * T(DEG_TO_RAD);
+    T lat2 = b.lat_deg * T(DEG_TO_RAD);
+    T h = std::sin(dlat / 2) * std::sin(dlat / 2) +
+          std::cos(lat1) * std::cos(lat2) *
+          std::sin(dlon / 2) * std::sin(dlon / 2);
+    T c = 2 * std::asin(std::sqrt(h));
+    return T(EARTH_RADIUS_KM) * c;
 }
 
-double computeElevationAngle(const GeoCoord& station, const GeoCoord& sat_pos,
-                              double sat_altitude_km) {
-    double ground_dist_km = haversineDistanceKm(station, sat_pos);
-    double central_angle = ground_dist_km / EARTH_RADIUS_KM;
-    double r_sat = EARTH_RADIUS_KM + sat_altitude_km;
-    double slant_range = std::sqrt(
-        EARTH_RADIUS_KM * EARTH_RADIUS_KM +
+template<typename T>
+T computeElevationAngle(const GeoCoordT<T>& station, const GeoCoordT<T>& sat_pos,
+                        T sat_altitude_km) {
+    const T R = T(EARTH_RADIUS_KM);
+    T ground_dist_km = haversineDistanceKm(station, sat_pos);
+    T central_angle = ground_dist_km / R;
+    T r_sat = R + sat_altitude_km;
+    T slant_range = std::sqrt(
+        R * R +
         r_sat * r_sat -
-        2 * EARTH_RADIUS_KM * r_sat * std::cos(central_angle));
-    if (slant_range < 1e-6) return 90.0;
-    double cos_elevation = (slant_range * slant_range +
-                            EARTH_RADIUS_KM * EARTH_RADIUS_KM -
-                            r_sat * r_sat) /
-                           (2 * slant_range * EARTH_RADIUS_KM);
-    double angle_at_station = std::acos(std::clamp(cos_elevation, -1.0, 1.0));
-    return (angle_at_station * RAD_TO_DEG) - 90.0;
+        2 * R * r_sat * std::cos(central_angle));
+    if (slant_range < T(1e-6)) return T(90);
+    T cos_elevation = (slant_range * slant_range +
+                       R * R -
+                       r_sat * r_sat) /
+                      (2 * slant_range * R);
+    T angle_at_station = std::acos(std::clamp(cos_elevation, T(-1), T(1)));
+    return (angle_at_station * T(RAD_TO_DEG)) - T(90);
 }
 
-double computeSlantRangeKm(const GeoCoord& station, const GeoCoord& sat_pos,
-                           double sat_altitude_km) {
-    double ground_dist_km = haversineDistanceKm(station, sat_pos);
-    double central_angle = ground_dist_km / EARTH_RADIUS_KM;
-    double r_sat = EARTH_RADIUS_KM + sat_altitude_km;
+template<typename T>
+T computeSlantRangeKm(const GeoCoordT<T>& station, const GeoCoordT<T>& sat_pos,
+                      T sat_altitude_km) {
+    const T R = T(EARTH_RADIUS_KM);
+    T ground_dist_km = haversineDistanceKm(station, sat_pos);
+    T central_angle = ground_dist_km / R;
+    T r_sat = R + sat_altitude_km;
     return std::sqrt(
-        EARTH_RADIUS_KM * EARTH_RADIUS_KM +
+        R * R +
         r_sat * r_sat -
-        2 * EARTH_RADIUS_KM * r_sat * std::cos(central_angle));
+        2 * R * r_sat * std::cos(central_angle));
 }
 
 double computeLatencyMs(double slant_km) {
@@ -155,19 +396,93 @@ double computeLatencyMs(double slant_km) {
 }
 
 // ---- 3D coordinate helpers ----
-struct Vec3 { double x, y, z; };
-
-Vec3 geoTo3D(double lat_deg, double lon_deg, double altitude_km) {
-    double lat = lat_deg * DEG_TO_RAD;
-    double lon = lon_deg * DEG_TO_RAD;
-    double r = (EARTH_RADIUS_KM + altitude_km) / EARTH_RADIUS_KM;
+template<typename T>
+struct Vec3T { T x, y, z; };
+using Vec3 = Vec3T<double>;
+
+template<typename T, typename Trig = LibmTrig>
+Vec3T<T> geoTo3D(T lat_deg, T lon_deg, T altitude_km) {
+    T lat = lat_deg * T(DEG_TO_RAD);
+    T lon = lon_deg * T(DEG_TO_RAD);
+    T r = (T(EARTH_RADIUS_KM) + altitude_km) / T(EARTH_RADIUS_KM);
     return {
-        r * std::cos(lat) * std::cos(lon),
-        r * std::sin(lat),
-       -r * std::cos(lat) * std::sin(lon)
+        r * Trig::cos(lat) * Trig::cos(lon),
+        r * Trig::sin(lat),
+       -r * Trig::cos(lat) * Trig::sin(lon)
     };
 }
 
+/**
+ * Cosine of the largest Earth central angle at which a satellite at
+ * `altitude_km` is at or above `min_elev_deg`. Visibility then needs no
+ * trig per pair: the dot product of the two unit vectors must reach it.
+ */
+template<typename T>
+T coverageCos(T altitude_km, T min_elev_deg) {
+    T e = min_elev_deg * T(DEG_TO_RAD);
+    T lambda = std::acos(T(EARTH_RADIUS_KM) * std::cos(e) /
+                         (T(EARTH_RADIUS_KM) + altitude_km)) - e;
+    return std::cos(lambda);
+}
+
+// ---- Horizon masks ----
+// Local east/north/up unit vectors at a station, in the geoTo3D frame
+template<typename T>
+struct EnuFrame { Vec3T<T> east, north, up; };
+
+template<typename T>
+EnuFrame<T> enuFrame(T lat_deg, T lon_deg) {
+    T lat = lat_deg * T(DEG_TO_RAD);
+    T lon = lon_deg * T(DEG_TO_RAD);
+    T sin_lat = std::sin(lat), cos_lat = std::cos(lat);
+    T sin_lon = std::sin(lon), cos_lon = std::cos(lon);
+    return {{-sin_lon, T(0), -cos_lon},
+            {-sin_lat * cos_lon, cos_lat, sin_lat * sin_lon},
+            {cos_lat * cos_lon, sin_lat, -cos_lat * sin_lon}};
+}
+
+template<typename T>
+T dot3(const Vec3T<T>& a, const Vec3T<T>& b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// Boresight as an east/north/up unit vector
+template<typename T>
+Vec3T<T> boresightEnu(const HorizonMask& h) {
+    T az = static_cast<T>(h.boresight_az_deg * DEG_TO_RAD);
+    T el = static_cast<T>(h.boresight_el_deg * DEG_TO_RAD);
+    return {std::cos(el) * std::sin(az), std::cos(el) * std::cos(az), std::sin(el)};
+}
+
+// Lowest elevation the mask or the cone can admit at any azimuth
+double horizonFloorDeg(const HorizonMask& h) {
+    double floor = *std::min_element(h.min_elev_deg.begin(), h.min_elev_deg.end());
+    return std::max(floor, h.boresight_el_deg - h.fov_half_deg);
+}
+
+/**
+ * The reference horizon test for a pair already at `elev` degrees:
+ * azimuth from the line of sight projected on the station's east/north
+ * plane, then that bin's mask, then the angle to the boresight. Double
+ * precision and libm throughout.
+ */
+bool horizonAdmits(const HorizonMask& h, const GroundStation& gs,
+                   const Satellite& sat, double elev) {
+    auto frame = enuFrame(gs.position.lat_deg, gs.position.lon_deg);
+    Vec3 s = geoTo3D(sat.position.lat_deg, sat.position.lon_deg, 0.0);
+    double r = (EARTH_RADIUS_KM + sat.altitude_km) / EARTH_RADIUS_KM;
+    // Line of sight in east/north/up, Earth radii
+    Vec3 d{r * dot3(s, frame.east), r * dot3(s, frame.north), r * dot3(s, frame.up) - 1.0};
+
+    double az = std::atan2(d.x, d.y) * RAD_TO_DEG;
+    if (az < 0.0) az += 360.0;
+    int bin = std::min(static_cast<int>(az * HorizonMask::BINS / 360.0), HorizonMask::BINS - 1);
+    if (elev < h.min_elev_deg[bin]) return false;
+    if (h.fov_half_deg >= 180.0) return true;
+    return dot3(d, boresightEnu<double>(h)) >=
+           std::sqrt(dot3(d, d)) * std::cos(h.fov_half_deg * DEG_TO_RAD);
+}
+
 // ---- Full multi-shell constellation generator ----
 // Proper Keplerian orbit projection for Walker Delta pattern.
 // Each satellite is parameterized by:
@@ -177,6 +492,28 @@ Vec3 geoTo3D(double lat_deg, double lon_deg, double altitude_km) {
 // Sub-satellite point:
 //   lat = asin(sin(inclination) * sin(u))
 //   lon = RAAN + atan2(cos(inclination) * sin(u), cos(u))
+template<typename Trig>
+Satellite walkerSatellite(int id, int plane, int shell_idx, double altitude_km,
+                          double sin_inc, double cos_inc,
+                          double raan_deg, double u_rad) {
+    double sin_u = Trig::sin(u_rad);
+    double cos_u = Trig::cos(u_rad);
+
+    // Proper Keplerian projection
+    double lat_rad = Trig::asin(sin_inc * sin_u);
+    double lon_offset = Trig::atan2(cos_inc * sin_u, cos_u);
+    double lon_deg = raan_deg + lon_offset * RAD_TO_DEG;
+
+    // Normalize longitude to [-180, 180]
+    lon_deg = std::fmod(lon_deg + 540.0, 360.0) - 180.0;
+    double lat_deg = lat_rad * RAD_TO_DEG;
+
+    Vec3 pos = geoTo3D<double, Trig>(lat_deg, lon_deg, altitude_km);
+    return {id, {lat_deg, lon_deg}, altitude_km, plane, shell_idx, 250.0,
+            pos.x, pos.y, pos.z};
+}
+
+template<typename Trig = LibmTrig>
 std::vector<Satellite> generateFullConstellation(
     const std::vector<OrbitalShell>& shells) {
     std::vector<Satellite> sats;
@@ -185,8 +522,8 @@ std::vector<Satellite> generateFullConstellation(
     for (int shell_idx = 0; shell_idx < static_cast<int>(shells.size()); shell_idx++) {
         const auto& shell = shells[shell_idx];
         double inc_rad = shell.inclination_deg * DEG_TO_RAD;
-        double sin_inc = std::sin(inc_rad);
-        double cos_inc = std::cos(inc_rad);
+        double sin_inc = Trig::sin(inc_rad);
+        double cos_inc = Trig::cos(inc_rad);
 
         // Walker Delta phasing: F=1 pattern
         // Phase offset per plane = 360 / (num_planes * sats_per_plane)
@@ -202,35 +539,115 @@ std::vector<Satellite> generateFullConstellation(
                              + phase_per_plane * p;
                 double u_rad = u_deg * DEG_TO_RAD;
 
-                double sin_u = std::sin(u_rad);
-                double cos_u = std::cos(u_rad);
-
-                // Proper Keplerian projection
-                double lat_rad = std::asin(sin_inc * sin_u);
-                double lon_offset = std::atan2(cos_inc * sin_u, cos_u);
-                double lon_deg = raan_deg + lon_offset * RAD_TO_DEG;
-
-                // Normalize longitude to [-180, 180]
-                lon_deg = std::fmod(lon_deg + 540.0, 360.0) - 180.0;
-                double lat_deg = lat_rad * RAD_TO_DEG;
-
-                Vec3 pos = geoTo3D(lat_deg, lon_deg, shell.altitude_km);
-
-                sats.push_back({
-                    global_id++,
-                    {lat_deg, lon_deg},
-                    shell.altitude_km,
-                    p,
-                    shell_idx,
-                    250.0,
-                    pos.x, pos.y, pos.z
-                });
+                sats.push_back(walkerSatellite<Trig>(
+                    global_id++, p, shell_idx, shell.altitude_km,
+                    sin_inc, cos_inc, raan_deg, u_rad));
             }
         }
     }
     return sats;
 }
 
+// ---- Compile-time shell configurations ----
+// The globe's shells never change between runs, so they live in a
+// constexpr table and each one gets its own generator instance: plane
+// and satellite counts are template constants, the RAAN and
+// argument-of-latitude tables are evaluated by the compiler (same
+// expressions as generateFullConstellation, so the same bits), and each
+// plane's satellite loop is unrolled. Only the projection trig is left
+// for run time.
+struct ShellSpec {
+    const char* name;
+    int num_planes;
+    int sats_per_plane;
+    double altitude_km;
+    double inclination_deg;
+};
+
+constexpr ShellSpec STARLINK_SHELLS[] = {
+    {"Gen1 Main",   72, 22, 550.0, 53.0},
+    {"Gen1 Backup", 72, 22, 540.0, 53.2},
+    {"Polar",       36, 20, 570.0, 70.0},
+    {"SSO",          6, 58, 560.0, 97.6},
+    {"Gen2",       120, 45, 525.0, 53.0},
+};
+constexpr size_t NUM_STARLINK_SHELLS = std::size(STARLINK_SHELLS);
+
+std::vector<OrbitalShell> starlinkShells() {
+    std::vector<OrbitalShell> shells;
+    for (const auto& spec : STARLINK_SHELLS) {
+        shells.push_back({spec.name, spec.num_planes, spec.sats_per_plane,
+                          spec.altitude_km, spec.inclination_deg});
+    }
+    return shells;
+}
+
+template<int PLANES, int SATS>
+struct WalkerTables {
+    std::array<double, PLANES> raan_deg{};
+    std::array<double, PLANES * SATS> u_rad{};  // plane-major
+};
+
+template<int PLANES, int SATS>
+constexpr WalkerTables<PLANES, SATS> makeWalkerTables() {
+    WalkerTables<PLANES, SATS> t;
+    double phase_per_plane = 360.0 / (PLANES * SATS);
+    for (int p = 0; p < PLANES; p++) {
+        t.raan_deg[p] = (360.0 / PLANES) * p;
+        for (int s = 0; s < SATS; s++) {
+            double u_deg = (360.0 / SATS) * s + phase_per_plane * p;
+            t.u_rad[p * SATS + s] = u_deg * DEG_TO_RAD;
+        }
+    }
+    return t;
+}
+
+template<size_t SHELL, typename Trig, size_t... S>
+void generatePlaneFixed(int plane, int first_id, double sin_inc, double cos_inc,
+                        Satellite* out, std::index_sequence<S...>) {
+    constexpr ShellSpec shell = STARLINK_SHELLS[SHELL];
+    constexpr int SATS = shell.sats_per_plane;
+    static constexpr auto tables = makeWalkerTables<shell.num_planes, SATS>();
+    const double raan_deg = tables.raan_deg[plane];
+    const double* u_rad = &tables.u_rad[plane * SATS];
+    ((out[S] = walkerSatellite<Trig>(first_id + static_cast<int>(S), plane,
+                                     static_cast<int>(SHELL), shell.altitude_km,
+                                     sin_inc, cos_inc, raan_deg, u_rad[S])), ...);
+}
+
+template<typename Trig, size_t... SHELL>
+void generateShellsFixed(Satellite* out, std::index_sequence<SHELL...>) {
+    int id = 0;
+    auto shell = [&](auto index) {
+        constexpr size_t I = decltype(index)::value;
+        constexpr ShellSpec spec = STARLINK_SHELLS[I];
+        constexpr int SATS = spec.sats_per_plane;
+        double inc_rad = spec.inclination_deg * DEG_TO_RAD;
+        double sin_inc = Trig::sin(inc_rad);
+        double cos_inc = Trig::cos(inc_rad);
+        for (int p = 0; p < spec.num_planes; p++) {
+            generatePlaneFixed<I, Trig>(p, id, sin_inc, cos_inc, out + id,
+                                        std::make_index_sequence<SATS>{});
+            id += SATS;
+        }
+    };
+    (shell(std::integral_constant<size_t, SHELL>{}), ...);
+}
+
+constexpr int starlinkSatelliteCount() {
+    int total = 0;
+    for (const auto& spec : STARLINK_SHELLS) total += spec.num_planes * spec.sats_per_plane;
+    return total;
+}
+
+// generateFullConstellation(starlinkShells()), specialized at compile time
+template<typename Trig = LibmTrig>
+std::vector<Satellite> generateStarlinkShells() {
+    std::vector<Satellite> sats(starlinkSatelliteCount());
+    generateShellsFixed<Trig>(sats.data(), std::make_index_sequence<NUM_STARLINK_SHELLS>{});
+    return sats;
+}
+
 // ---- Intra-plane ISL link computation ----
 std::vector<ISLLink> computeIntraPlaneLinks(
     const std::vector<Satellite>& sats,
@@ -301,7 +718,8 @@ std::vector<GroundStation> generateGroundStations(int count) {
             {city_coords[i].lat, city_coords[i].lon},
             city_coords[i].name,
             25.0,
-            10000.0
+            10000.0,
+            nullptr
         });
     }
     return stations;
@@ -319,6 +737,7 @@ std::vector<VisibilityEdge> buildVisibilityEdges(
         for (const auto& gs : stations) {
             double elev = computeElevationAngle(gs.position, sat.position, sat.altitude_km);
             if (elev < min_elevation_deg) continue;
+            if (gs.horizon && !horizonAdmits(*gs.horizon, gs, sat, elev)) continue;
 
             double slant = computeSlantRangeKm(gs.position, sat.position, sat.altitude_km);
             double latency = computeLatencyMs(slant);
@@ -345,6 +764,443 @@ std::vector<VisibilityEdge> buildVisibilityEdges(
     return edges;
 }
 
+struct FastVisibilityStats {
+    uint64_t pairs = 0;
+    uint64_t float_rejected = 0;   // settled by the float filter alone
+    uint64_t band_rechecks = 0;    // within COS_BAND of the threshold
+    uint64_t horizon_lookups = 0;  // azimuths computed for masked stations
+    uint64_t horizon_rechecks = 0; // near a bin edge, the mask or the cone
+};
+
+/**
+ * Horizon masks for the float filter. Pairs that clear the global mask
+ * at a masked station are staged here (line of sight in east/north/up,
+ * boresight, cone cosine, mask row) and evaluated four at a time:
+ * azimuth from a polynomial atan2 (A&S 4.4.49, 2e-8 rad), bin, mask and
+ * cone compares all in SSE; only the four mask loads are scalar, SSE2
+ * having no gather. Lanes within a band of a decision — a bin edge, the
+ * mask value, the cone edge, or near zenith where azimuth is ill
+ * conditioned — go through the double horizonAdmits, so the result is
+ * the reference's. Pairs below a station's lowest mask never get an
+ * azimuth.
+ */
+class HorizonFilter {
+public:
+    static constexpr int NO_MASK = -1;
+    static constexpr int BELOW_FLOOR = -2;
+
+    HorizonFilter(const std::vector<Satellite>& sats,
+                  const std::vector<GroundStation>& stations)
+        : sats_(sats), stations_(stations) {
+        for (size_t g = 0; g < stations.size(); g++) {
+            const auto& gs = stations[g];
+            if (!gs.horizon) continue;
+            if (site_.empty()) site_.resize(stations.size());
+            const HorizonMask& h = *gs.horizon;
+            auto frame = enuFrame<float>(static_cast<float>(gs.position.lat_deg),
+                                         static_cast<float>(gs.position.lon_deg));
+            site_[g] = {&h, frame, boresightEnu<float>(h),
+                        h.fov_half_deg >= 180.0
+                            ? -2.0f : static_cast<float>(std::cos(h.fov_half_deg * DEG_TO_RAD)),
+                        horizonFloorDeg(h)};
+        }
+        if (!active()) return;
+        sat_r_.resize(sats.size());
+        for (size_t i = 0; i < sats.size(); i++) {
+            sat_r_[i] = static_cast<float>((EARTH_RADIUS_KM + sats[i].altitude_km) /
+                                           EARTH_RADIUS_KM);
+        }
+    }
+
+    bool active() const { return !site_.empty(); }
+
+    // Slot for a pair at or above the global mask, NO_MASK or BELOW_FLOOR
+    int stage(size_t i, size_t g, double elev, const Vec3T<float>& s) {
+        const Site& site = site_[g];
+        if (!site.mask) return NO_MASK;
+        if (elev < site.floor_deg) return BELOW_FLOOR;
+        float r = sat_r_[i];
+        de_.push_back(r * dot3(s, site.frame.east));
+        dn_.push_back(r * dot3(s, site.frame.north));
+        du_.push_back(r * dot3(s, site.frame.up) - 1.0f);
+        elev_.push_back(static_cast<float>(elev));
+        be_.push_back(site.boresight.x);
+        bn_.push_back(site.boresight.y);
+        bu_.push_back(site.boresight.z);
+        cos_half_.push_back(site.cos_half);
+        pairs_.push_back({i, g, elev});
+        return static_cast<int>(pairs_.size()) - 1;
+    }
+
+    // Decide every staged slot; admitted(slot) is valid until clear()
+    void evaluate(FastVisibilityStats& fast) {
+        const size_t n = pairs_.size();
+        admitted_.assign(n, 0);
+        fast.horizon_lookups += n;
+#ifdef __SSE2__
+        constexpr float AZ_BAND = 1e-2f;       // bins
+        constexpr float ELEV_BAND = 1e-4f;     // degrees
+        constexpr float COS_BAND = 1e-4f;      // relative to the sight line
+        constexpr float HORIZ_SQ_MIN = 1e-4f;  // above ~83 deg at 550 km
+        // Pad to whole lanes; padding reuses a masked station so the
+        // lookups stay in bounds, and its results are never read
+        const size_t padded = (n + 3) / 4 * 4;
+        for (size_t k = n; k < padded; k++) {
+            for (auto* v : {&de_, &dn_, &du_, &elev_, &be_, &bn_, &bu_, &cos_half_}) {
+                v->push_back(0.0f);
+            }
+            pairs_.push_back(pairs_.front());
+        }
+        const __m128 sign = _mm_set1_ps(-0.0f);
+        const __m128 zero = _mm_setzero_ps();
+        for (size_t base = 0; base < padded; base += 4) {
+            __m128 e = _mm_loadu_ps(&de_[base]);
+            __m128 nn = _mm_loadu_ps(&dn_[base]);
+            __m128 u = _mm_loadu_ps(&du_[base]);
+            __m128 az = azimuthDeg(e, nn, sign, zero);
+
+            // Bin and its fractional part (az >= 0, so truncation floors)
+            __m128 pos = _mm_mul_ps(az, _mm_set1_ps(HorizonMask::BINS / 360.0f));
+            __m128i bin = _mm_cvttps_epi32(pos);
+            __m128 frac = _mm_sub_ps(pos, _mm_cvtepi32_ps(bin));
+            alignas(16) int32_t idx[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(idx), bin);
+            float thr_lane[4];
+            for (int l = 0; l < 4; l++) {
+                int b = std::min(idx[l], HorizonMask::BINS - 1);
+                thr_lane[l] = site_[pairs_[base + l].g].mask->min_elev_deg[b];
+            }
+            __m128 thr = _mm_loadu_ps(thr_lane);
+            __m128 elev = _mm_loadu_ps(&elev_[base]);
+            __m128 pass = _mm_cmpge_ps(elev, thr);
+
+            // Cone: d . b >= |d| cos(half)
+            __m128 len = _mm_sqrt_ps(_mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(e, e), _mm_mul_ps(nn, nn)), _mm_mul_ps(u, u)));
+            __m128 along = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(e, _mm_loadu_ps(&be_[base])),
+                           _mm_mul_ps(nn, _mm_loadu_ps(&bn_[base]))),
+                _mm_mul_ps(u, _mm_loadu_ps(&bu_[base])));
+            __m128 edge = _mm_mul_ps(len, _mm_loadu_ps(&cos_half_[base]));
+            pass = _mm_and_ps(pass, _mm_cmpge_ps(along, edge));
+
+            __m128 band = _mm_or_ps(
+                _mm_cmplt_ps(frac, _mm_set1_ps(AZ_BAND)),
+                _mm_cmpgt_ps(frac, _mm_set1_ps(1.0f - AZ_BAND)));
+            band = _mm_or_ps(band, _mm_cmple_ps(_mm_andnot_ps(sign, _mm_sub_ps(elev, thr)),
+                                                _mm_set1_ps(ELEV_BAND)));
+            band = _mm_or_ps(band, _mm_cmple_ps(_mm_andnot_ps(sign, _mm_sub_ps(along, edge)),
+                                                _mm_mul_ps(len, _mm_set1_ps(COS_BAND))));
+            band = _mm_or_ps(band, _mm_cmplt_ps(
+                _mm_add_ps(_mm_mul_ps(e, e), _mm_mul_ps(nn, nn)), _mm_set1_ps(HORIZ_SQ_MIN)));
+
+            unsigned pass_bits = _mm_movemask_ps(pass);
+            unsigned band_bits = _mm_movemask_ps(band);
+            for (size_t l = 0; l < 4 && base + l < n; l++) {
+                admitted_[base + l] = band_bits >> l & 1 ? recheck(base + l, fast)
+                                                         : pass_bits >> l & 1;
+            }
+        }
+#else
+        for (size_t k = 0; k < n; k++) admitted_[k] = recheck(k, fast);
+#endif
+    }
+
+    bool admitted(int slot) const { return admitted_[slot]; }
+
+    void clear() {
+        for (auto* v : {&de_, &dn_, &du_, &elev_, &be_, &bn_, &bu_, &cos_half_}) v->clear();
+        pairs_.clear();
+    }
+
+private:
+    struct Site {
+        const HorizonMask* mask = nullptr;
+        EnuFrame<float> frame{};
+        Vec3T<float> boresight{};
+        float cos_half = -2.0f;       // -2: open cone, never binding
+        double floor_deg = 0.0;
+    };
+    struct Pair {
+        size_t i, g;
+        double elev;
+    };
+
+    bool recheck(size_t slot, FastVisibilityStats& fast) const {
+        const Pair& p = pairs_[slot];
+        fast.horizon_rechecks++;
+        return horizonAdmits(*site_[p.g].mask, stations_[p.g], sats_[p.i], p.elev);
+    }
+
+#ifdef __SSE2__
+    // atan2(e, n) in degrees, [0, 360): clockwise from north
+    static __m128 azimuthDeg(__m128 e, __m128 n, __m128 sign, __m128 zero) {
+        __m128 ae = _mm_andnot_ps(sign, e);
+        __m128 an = _mm_andnot_ps(sign, n);
+        __m128 hi = _mm_max_ps(ae, an);
+        __m128 a = _mm_div_ps(_mm_min_ps(ae, an), _mm_max_ps(hi, _mm_set1_ps(1e-30f)));
+        __m128 z = _mm_mul_ps(a, a);
+        __m128 p = _mm_set1_ps(0.0028662257f);
+        for (float c : {-0.0161657367f, 0.0429096138f, -0.0752896400f, 0.1065626393f,
+                        -0.1420889944f, 0.1999355085f, -0.3333314528f, 1.0f}) {
+            p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(c));
+        }
+        p = _mm_mul_ps(p, a);   // atan(min / max), [0, pi/4]
+
+        const __m128 half_pi = _mm_set1_ps(static_cast<float>(M_PI / 2));
+        __m128 east_major = _mm_cmpgt_ps(ae, an);
+        p = _mm_or_ps(_mm_and_ps(east_major, _mm_sub_ps(half_pi, p)),
+                      _mm_andnot_ps(east_major, p));
+        __m128 south = _mm_cmplt_ps(n, zero);
+        p = _mm_or_ps(_mm_and_ps(south, _mm_sub_ps(_mm_set1_ps(static_cast<float>(M_PI)), p)),
+                      _mm_andnot_ps(south, p));
+        __m128 west = _mm_cmplt_ps(e, zero);
+        p = _mm_or_ps(_mm_and_ps(west, _mm_sub_ps(_mm_set1_ps(static_cast<float>(2 * M_PI)), p)),
+                      _mm_andnot_ps(west, p));
+        return _mm_mul_ps(p, _mm_set1_ps(static_cast<float>(RAD_TO_DEG)));
+    }
+#endif
+
+    const std::vector<Satellite>& sats_;
+    const std::vector<GroundStation>& stations_;
+    std::vector<Site> site_;          // by station; empty when no station is masked
+    std::vector<float> sat_r_;        // orbit radius, Earth radii
+    std::vector<float> de_, dn_, du_, elev_, be_, bn_, bu_, cos_half_;
+    std::vector<Pair> pairs_;
+    std::vector<uint8_t> admitted_;
+};
+
+/**
+ * The float32 visibility filter: satellites and stations become unit
+ * vectors, and their dot product is compared with each satellite's
+ * coverageCos four lanes at a time (SSE, twice the lanes of double).
+ * Pairs clearly below the threshold are dropped in float; the rest —
+ * clear passes and the band within COS_BAND of the threshold — go
+ * through the double computeElevationAngle, and `visit(sat, station,
+ * elev)` is called for those at or above the mask, satellite-major like
+ * the double path. Float error in the dot product is ~1e-7, far inside
+ * the band. Stations with a horizon mask also pass through HorizonFilter.
+ */
+template<typename Visit>
+void forEachVisiblePair(const std::vector<Satellite>& sats,
+                        const std::vector<GroundStation>& stations,
+                        double min_elevation_deg,
+                        FastVisibilityStats& fast,
+                        Visit&& visit) {
+    constexpr float COS_BAND = 1e-5f;
+    constexpr size_t LANES = 4;
+
+    // Structure-of-arrays, padded to whole lanes with never-visible entries
+    const size_t padded = (sats.size() + LANES - 1) / LANES * LANES;
+    std::vector<float> sx(padded, 0.0f), sy(padded, 0.0f), sz(padded, 0.0f);
+    std::vector<float> threshold(padded, 2.0f);
+    for (size_t i = 0; i < sats.size(); i++) {
+        auto u = geoTo3D<float>(static_cast<float>(sats[i].position.lat_deg),
+                                static_cast<float>(sats[i].position.lon_deg), 0.0f);
+        sx[i] = u.x;
+        sy[i] = u.y;
+        sz[i] = u.z;
+        threshold[i] = static_cast<float>(
+            coverageCos(sats[i].altitude_km, min_elevation_deg));
+    }
+    std::vector<Vec3T<float>> station_unit;
+    for (const auto& gs : stations) {
+        station_unit.push_back(geoTo3D<float>(static_cast<float>(gs.position.lat_deg),
+                                              static_cast<float>(gs.position.lon_deg),
+                                              0.0f));
+    }
+
+    HorizonFilter horizon(sats, stations);
+    struct Pending {
+        size_t i, g;
+        double elev;
+        int slot;
+    };
+    std::vector<Pending> pending;
+
+    std::vector<unsigned> candidate_mask(stations.size());
+    for (size_t base = 0; base < padded; base += LANES) {
+        for (size_t g = 0; g < stations.size(); g++) {
+            const auto& u = station_unit[g];
+            unsigned candidate = 0, band = 0;
+#ifdef __SSE2__
+            __m128 dot = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(u.x), _mm_loadu_ps(&sx[base])),
+                           _mm_mul_ps(_mm_set1_ps(u.y), _mm_loadu_ps(&sy[base]))),
+                _mm_mul_ps(_mm_set1_ps(u.z), _mm_loadu_ps(&sz[base])));
+            __m128 thr = _mm_loadu_ps(&threshold[base]);
+            __m128 band_lo = _mm_sub_ps(thr, _mm_set1_ps(COS_BAND));
+            __m128 band_hi = _mm_add_ps(thr, _mm_set1_ps(COS_BAND));
+            candidate = _mm_movemask_ps(_mm_cmpge_ps(dot, band_lo));
+            band = candidate & _mm_movemask_ps(_mm_cmple_ps(dot, band_hi));
+#else
+            for (size_t l = 0; l < LANES; l++) {
+                size_t i = base + l;
+                float dot = u.x * sx[i] + u.y * sy[i] + u.z * sz[i];
+                if (dot >= threshold[i] - COS_BAND) {
+                    candidate |= 1u << l;
+                    if (dot <= threshold[i] + COS_BAND) band |= 1u << l;
+                }
+            }
+#endif
+            candidate_mask[g] = candidate;
+            fast.band_rechecks += __builtin_popcount(band);
+        }
+
+        // Satellite-major, like the double path, so edge order matches
+        for (size_t l = 0; l < LANES && base + l < sats.size(); l++) {
+            const auto& sat = sats[base + l];
+            const Vec3T<float> s{sx[base + l], sy[base + l], sz[base + l]};
+            for (size_t g = 0; g < stations.size(); g++) {
+                fast.pairs++;
+                if (!(candidate_mask[g] >> l & 1)) {
+                    fast.float_rejected++;
+                    continue;
+                }
+                double elev = computeElevationAngle(stations[g].position, sat.position,
+                                                    sat.altitude_km);
+                if (elev < min_elevation_deg) continue;
+                if (horizon.active()) {
+                    pending.push_back({base + l, g, elev, horizon.stage(base + l, g, elev, s)});
+                    continue;
+                }
+                visit(base + l, g, elev);
+            }
+        }
+
+        // Masked stations' pairs are decided together, then visited in order
+        if (pending.empty()) continue;
+        horizon.evaluate(fast);
+        for (const auto& p : pending) {
+            if (p.slot == HorizonFilter::BELOW_FLOOR) continue;
+            if (p.slot >= 0 && !horizon.admitted(p.slot)) continue;
+            visit(p.i, p.g, p.elev);
+        }
+        pending.clear();
+        horizon.clear();
+    }
+}
+
+// buildVisibilityEdges with the float32 filter in front; same edges,
+// same order, same values
+std::vector<VisibilityEdge> buildVisibilityEdgesFast(
+    const std::vector<Satellite>& sats,
+    const std::vector<GroundStation>& stations,
+    double min_elevation_deg,
+    VisibilityStats& stats_out,
+    FastVisibilityStats& fast) {
+    std::vector<VisibilityEdge> edges;
+    stats_out.coverage_counts.assign(stations.size(), 0);
+
+    forEachVisiblePair(sats, stations, min_elevation_deg, fast,
+                       [&](size_t i, size_t g, double elev) {
+        const auto& sat = sats[i];
+        const auto& gs = stations[g];
+        double slant = computeSlantRangeKm(gs.position, sat.position, sat.altitude_km);
+        double latency = computeLatencyMs(slant);
+        edges.push_back({sat.id, gs.id, elev, slant, latency});
+        stats_out.coverage_counts[gs.id]++;
+
+        stats_out.min_elev = std::min(stats_out.min_elev, elev);
+        stats_out.max_elev = std::max(stats_out.max_elev, elev);
+        stats_out.avg_elev += elev;
+        stats_out.min_latency = std::min(stats_out.min_latency, latency);
+        stats_out.max_latency = std::max(stats_out.max_latency, latency);
+        stats_out.avg_latency += latency;
+    });
+
+    stats_out.edge_count = static_cast<int>(edges.size());
+    if (stats_out.edge_count > 0) {
+        stats_out.avg_elev /= stats_out.edge_count;
+        stats_out.avg_latency /= stats_out.edge_count;
+    } else {
+        stats_out.min_elev = stats_out.max_elev = 0.0;
+        stats_out.min_latency = stats_out.max_latency = 0.0;
+    }
+    return edges;
+}
+
+// ---- Top-k satellites per station ----
+// Beam planners want the best few satellites per station, not every
+// edge. Each station keeps a k-slot heap (worst candidate on top) that
+// the kernel pass feeds directly, so memory is stations * k edges
+// instead of stations * degree, and slant range is only computed for
+// pairs that can still make the cut when ranking by elevation.
+enum class TopKBy { ELEVATION, LATENCY };
+
+// True if `a` ranks ahead of `b`; ties go to the lower satellite id
+inline bool ranksAhead(const VisibilityEdge& a, const VisibilityEdge& b, TopKBy by) {
+    if (by == TopKBy::ELEVATION) {
+        if (a.elevation_deg != b.elevation_deg) return a.elevation_deg > b.elevation_deg;
+    } else if (a.latency_ms != b.latency_ms) {
+        return a.latency_ms < b.latency_ms;
+    }
+    return a.satellite_id < b.satellite_id;
+}
+
+struct TopKEdges {
+    int k = 0;
+    std::vector<VisibilityEdge> slots;  // station g owns [g * k, g * k + count[g]), best first
+    std::vector<int> count;
+
+    const VisibilityEdge* station(size_t g) const { return slots.data() + g * k; }
+};
+
+TopKEdges topKVisibility(const std::vector<Satellite>& sats,
+                         const std::vector<GroundStation>& stations,
+                         double min_elevation_deg, int k, TopKBy by,
+                         FastVisibilityStats& fast) {
+    TopKEdges top;
+    top.count.assign(stations.size(), 0);
+    if (k < 1) return top;  // no slots: the heap below needs one to compare against
+    top.k = k;
+    top.slots.resize(stations.size() * k);
+    auto ahead = [by](const VisibilityEdge& a, const VisibilityEdge& b) {
+        return ranksAhead(a, b, by);
+    };
+
+    forEachVisiblePair(sats, stations, min_elevation_deg, fast,
+                       [&](size_t i, size_t g, double elev) {
+        const auto& sat = sats[i];
+        VisibilityEdge* heap = &top.slots[g * k];
+        int& n = top.count[g];
+        VisibilityEdge e{sat.id, stations[g].id, elev, 0.0, 0.0};
+        if (n == k && by == TopKBy::ELEVATION && !ranksAhead(e, heap[0], by)) return;
+        e.slant_km = computeSlantRangeKm(stations[g].position, sat.position, sat.altitude_km);
+        e.latency_ms = computeLatencyMs(e.slant_km);
+        if (n < k) {
+            heap[n++] = e;
+            std::push_heap(heap, heap + n, ahead);
+        } else if (ranksAhead(e, heap[0], by)) {
+            std::pop_heap(heap, heap + n, ahead);
+            heap[n - 1] = e;
+            std::push_heap(heap, heap + n, ahead);
+        }
+    });
+
+    for (size_t g = 0; g < stations.size(); g++) {
+        VisibilityEdge* heap = &top.slots[g * k];
+        std::sort_heap(heap, heap + top.count[g], ahead);
+    }
+    return top;
+}
+
+// Stations: the named cities first, then terminals on a Fibonacci
+// lattice over the latitudes the 53° shells cover
+std::vector<GroundStation> latticeStations(int count) {
+    auto stations = generateGroundStations(count);
+    const int terminals = count - static_cast<int>(stations.size());
+    const double golden_deg = 180.0 * (3.0 - std::sqrt(5.0));
+    const double max_sin = std::sin(55.0 * DEG_TO_RAD);
+    for (int k = 0; k < terminals; k++) {
+        double lat = std::asin(max_sin * (2.0 * (k + 0.5) / terminals - 1.0)) * RAD_TO_DEG;
+        double lon = std::fmod(k * golden_deg, 360.0) - 180.0;
+        stations.push_back({static_cast<int>(stations.size()), {lat, lon},
+                            "terminal-" + std::to_string(k), 25.0, 100.0, nullptr});
+    }
+    return stations;
+}
+
 // ============================================================
 // Packet Router Data
 // ============================================================
@@ -420,6 +1276,76 @@ PacketStats simulatePacketStream(int num_packets,
     return stats;
 }
 
+/**
+ * simulatePacketStream on Philox streams: every per-position draw is
+ * made in parallel (stream 0 for reorder/drop, stream 1 for priority and
+ * queue), then the swaps are applied in order. Same output for any
+ * thread count, though not the same as the mt19937 version.
+ */
+PacketStats simulatePacketStreamParallel(int num_packets,
+                                         int num_queues,
+                                         double reorder_prob,
+                                         double drop_prob,
+                                         unsigned seed,
+                                         int threads) {
+    PacketStats stats;
+    stats.num_packets = num_packets;
+    stats.num_queues = num_queues;
+    stats.reorder_prob = reorder_prob;
+    stats.drop_prob = drop_prob;
+    stats.queue_counts.assign(num_queues, 0);
+    stats.priority_counts.assign(4, 0);
+
+    const Philox4x32 link(seed, 0);
+    const Philox4x32 route(seed, 1);
+    struct Draw {
+        int swap_offset;   // 0 = stays in place
+        bool dropped;
+        int priority;
+        int destination;
+    };
+    std::vector<Draw> draws(num_packets);
+    parallelFor(num_packets, threads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            auto l = link.at(i);
+            auto r = route.at(i);
+            draws[i] = {Philox4x32::unit(l[0]) < reorder_prob ? Philox4x32::range(l[1], 1, 8) : 0,
+                        Philox4x32::unit(l[2]) < drop_prob,
+                        Philox4x32::range(r[0], 0, 3),
+                        Philox4x32::range(r[1], 0, num_queues - 1)};
+        }
+    });
+
+    // Generate sequence numbers
+    std::vector<int> seqs(num_packets);
+    std::iota(seqs.begin(), seqs.end(), 0);
+
+    // Apply local reordering
+    for (int i = 0; i + 1 < num_packets; i++) {
+        if (draws[i].swap_offset > 0) {
+            int offset = std::min(draws[i].swap_offset, num_packets - i - 1);
+            std::swap(seqs[i], seqs[i + offset]);
+        }
+    }
+
+    int arrival_index = 0;
+    for (int i = 0; i < num_packets; i++) {
+        int seq = seqs[i];
+        if (draws[i].dropped) {
+            stats.num_dropped++;
+            stats.gaps.push_back(seq);
+            continue;
+        }
+        stats.priority_counts[draws[i].priority]++;
+        stats.queue_counts[draws[i].destination]++;
+        stats.points.push_back({seq, arrival_index++, draws[i].priority,
+                                draws[i].destination});
+    }
+
+    stats.num_arrived = arrival_index;
+    return stats;
+}
+
 // ============================================================
 // Handoff Scheduler Data
 // ============================================================
@@ -475,8 +1401,12 @@ public:
      *
      * This is the correct Starlink formulation: you want maximum uptime,
      * not maximum signal quality.
+     *
+     * Reported coverage and gap time stop at `horizon`, past which the
+     * last pass usually runs on.
      */
-    static HandoffResult schedule(std::vector<VisibilityWindow> windows) {
+    static HandoffResult schedule(std::vector<VisibilityWindow> windows,
+                                  double horizon = INFINITY) {
         HandoffResult result;
         if (windows.empty()) return result;
 
@@ -562,10 +1492,21 @@ public:
 
         result.min_signal_quality = min_signal < 1e8 ? min_signal : 0.0;
 
+        // Clip each window's serving span (entry to exit handoff) to the horizon
+        if (horizon < windows[best_end].end_time) {
+            result.total_coverage_time = 0.0;
+            for (size_t k = 0; k < selected.size(); k++) {
+                double from = entry_time[selected[k]];
+                double to = k + 1 < selected.size() ? result.handoffs[k].handoff_time
+                                                    : windows[selected[k]].end_time;
+                result.total_coverage_time += std::max(0.0, std::min(to, horizon) - from);
+            }
+        }
+
         // Compute gap time over the full timeline
         if (!selected.empty()) {
-            double total_time =
-                windows[selected.back()].end_time - windows[selected.front()].start_time;
+            double total_time = std::min(windows[selected.back()].end_time, horizon) -
+                                windows[selected.front()].start_time;
             result.total_gap_time = std::max(0.0, total_time - result.total_coverage_time);
         }
 
@@ -594,16 +1535,18 @@ private:
     }
 };
 
-std::vector<VisibilityWindow> generateWindows(int num_satellites,
-                                              double total_time_sec,
-                                              unsigned seed) {
+// Fills `windows` in place, so a caller can reuse its capacity
+void generateWindowsInto(std::vector<VisibilityWindow>& windows,
+                         int num_satellites,
+                         double total_time_sec,
+                         unsigned seed) {
     std::mt19937 rng(seed);
     std::uniform_real_distribution<double> duration_dist(180.0, 600.0);
     std::uniform_real_distribution<double> gap_dist(10.0, 120.0);
     std::uniform_real_distribution<double> signal_dist(8.0, 25.0);
     std::uniform_real_distribution<double> jitter_dist(-30.0, 30.0);
 
-    std::vector<VisibilityWindow> windows;
+    windows.clear();
     double current_time = 0.0;
     int sat_id = 0;
 
@@ -623,19 +1566,197 @@ std::vector<VisibilityWindow> generateWindows(int num_satellites,
         double gap = gap_dist(rng) + jitter_dist(rng);
         current_time += duration - std::max(30.0, gap);
     }
+}
+
+std::vector<VisibilityWindow> generateWindows(int num_satellites,
+                                              double total_time_sec,
+                                              unsigned seed) {
+    std::vector<VisibilityWindow> windows;
+    generateWindowsInto(windows, num_satellites, total_time_sec, seed);
+    return windows;
+}
+
+/**
+ * generateWindows on a Philox stream (stream 2): window k's duration,
+ * signal and gap come from block k and are drawn in parallel; only the
+ * running start time is accumulated in order.
+ */
+std::vector<VisibilityWindow> generateWindowsParallel(int num_satellites,
+                                                      double total_time_sec,
+                                                      unsigned seed,
+                                                      int threads) {
+    const Philox4x32 rng(seed, 2);
+    struct Draw {
+        double duration;
+        double peak_snr;
+        double advance;
+    };
+    std::vector<Draw> draws(std::max(0, num_satellites));
+    parallelFor(draws.size(), threads, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            auto b = rng.at(k);
+            double duration = 180.0 + 420.0 * Philox4x32::unit(b[0]);
+            double gap = (10.0 + 110.0 * Philox4x32::unit(b[2])) +
+                         (-30.0 + 60.0 * Philox4x32::unit(b[3]));
+            draws[k] = {duration, 8.0 + 17.0 * Philox4x32::unit(b[1]),
+                        duration - std::max(30.0, gap)};
+        }
+    });
+
+    std::vector<VisibilityWindow> windows;
+    double current_time = 0.0;
+    for (int sat_id = 0; sat_id < num_satellites && current_time < total_time_sec; sat_id++) {
+        const auto& d = draws[sat_id];
+        windows.push_back({
+            sat_id,
+            current_time,
+            current_time + d.duration,
+            d.peak_snr,
+            d.peak_snr * 0.6,
+            d.peak_snr * 0.5
+        });
+        current_time += d.advance;
+    }
     return windows;
 }
 
 // ============================================================
-// Arguments
+// Monte Carlo: Online Estimators
 // ============================================================
-struct Args {
-    int num_planes = 36;
-    int sats_per_plane = 20;
-    int num_stations = 20;
-    double altitude_km = 550.0;
-    double inclination_deg = 53.0;
-    double min_elevation_deg = 25.0;
+// Trial results are streamed into constant-memory estimators: Welford
+// for mean and variance, and the P² algorithm (Jain & Chlamtac) for
+// quantiles, which tracks five markers instead of keeping the samples.
+
+class OnlineStats {
+public:
+    void add(double x) {
+        count_++;
+        double delta = x - mean_;
+        mean_ += delta / count_;
+        m2_ += delta * (x - mean_);
+    }
+
+    uint64_t count() const { return count_; }
+    double mean() const { return mean_; }
+    double variance() const { return count_ > 1 ? m2_ / (count_ - 1) : 0.0; }
+    double stddev() const { return std::sqrt(variance()); }
+
+    // Half-width of the normal-approximation confidence interval
+    double ciHalfWidth(double z = 1.96) const {
+        return count_ > 1 ? z * stddev() / std::sqrt(static_cast<double>(count_)) : INFINITY;
+    }
+
+private:
+    uint64_t count_ = 0;
+    double mean_ = 0.0;
+    double m2_ = 0.0;
+};
+
+class P2Quantile {
+public:
+    explicit P2Quantile(double p) : p_(p) {}
+
+    void add(double x) {
+        if (count_ < 5) {
+            q_[count_++] = x;
+            if (count_ == 5) {
+                std::sort(q_.begin(), q_.end());
+                n_ = {0, 1, 2, 3, 4};
+                want_ = {0, 2 * p_, 4 * p_, 2 + 2 * p_, 4};
+            }
+            return;
+        }
+        count_++;
+
+        // Cell containing x, stretching the extremes if needed
+        int k;
+        if (x < q_[0]) {
+            q_[0] = x;
+            k = 0;
+        } else if (x >= q_[4]) {
+            q_[4] = x;
+            k = 3;
+        } else {
+            k = 0;
+            while (k < 3 && x >= q_[k + 1]) k++;
+        }
+        for (int i = k + 1; i < 5; i++) n_[i]++;
+        const std::array<double, 5> step = {0, p_ / 2, p_, (1 + p_) / 2, 1};
+        for (int i = 0; i < 5; i++) want_[i] += step[i];
+
+        // Nudge the middle markers toward their desired positions
+        for (int i = 1; i <= 3; i++) {
+            double d = want_[i] - n_[i];
+            if ((d >= 1 && n_[i + 1] - n_[i] > 1) || (d <= -1 && n_[i - 1] - n_[i] < -1)) {
+                int s = d > 0 ? 1 : -1;
+                double parabolic = q_[i] + s / (n_[i + 1] - n_[i - 1]) *
+                    ((n_[i] - n_[i - 1] + s) * (q_[i + 1] - q_[i]) / (n_[i + 1] - n_[i]) +
+                     (n_[i + 1] - n_[i] - s) * (q_[i] - q_[i - 1]) / (n_[i] - n_[i - 1]));
+                if (q_[i - 1] < parabolic && parabolic < q_[i + 1]) {
+                    q_[i] = parabolic;
+                } else {
+                    q_[i] += s * (q_[i + s] - q_[i]) / (n_[i + s] - n_[i]);
+                }
+                n_[i] += s;
+            }
+        }
+    }
+
+    double value() const {
+        if (count_ >= 5) return q_[2];
+        if (count_ == 0) return 0.0;
+        // Insertion sort of the first count_ < 5 samples; std::sort over a
+        // runtime length trips a -Warray-bounds false positive here
+        std::array<double, 5> first = q_;
+        for (int i = 1; i < count_; i++) {
+            double x = first[i];
+            int j = i;
+            for (; j > 0 && first[j - 1] > x; j--) first[j] = first[j - 1];
+            first[j] = x;
+        }
+        return first[static_cast<int>(p_ * (count_ - 1) + 0.5)];
+    }
+
+private:
+    double p_;
+    int count_ = 0;
+    std::array<double, 5> q_{};     // marker heights
+    std::array<double, 5> n_{};     // marker positions
+    std::array<double, 5> want_{};  // desired positions
+};
+
+struct MetricEstimator {
+    explicit MetricEstimator(const char* metric) : name(metric) {}
+
+    const char* name;
+    OnlineStats stats;
+    P2Quantile p05{0.05};
+    P2Quantile p50{0.50};
+    P2Quantile p95{0.95};
+
+    void add(double x) {
+        stats.add(x);
+        p05.add(x);
+        p50.add(x);
+        p95.add(x);
+    }
+
+    // CI narrower than `rel` of the mean (absolute when the mean is ~0)
+    bool converged(double rel) const {
+        return stats.ciHalfWidth() <= rel * std::max(std::abs(stats.mean()), 1e-9);
+    }
+};
+
+// ============================================================
+// Arguments
+// ============================================================
+struct Args {
+    int num_planes = 36;
+    int sats_per_plane = 20;
+    int num_stations = 20;
+    double altitude_km = 550.0;
+    double inclination_deg = 53.0;
+    double min_elevation_deg = 25.0;
     int num_packets = 400;
     double reorder_prob = 0.18;
     double drop_prob = 0.03;
@@ -643,8 +1764,43 @@ struct Args {
     int num_handoff_sats = 18;
     double handoff_time_sec = 3600.0;
     unsigned seed = 42;
+    std::string rng = "mt19937";    // mt19937 | philox
+    int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    int mc_trials = 0;              // > 0: Monte Carlo batch mode, no data.js
+    double mc_ci = 0.01;            // stop when every 95% CI is within this of its mean
+    std::vector<double> mc_drop;    // drop probabilities to sweep (default --drop)
+    std::vector<double> mc_sats;    // handoff window counts to sweep (default --handoff-sats)
+    std::string precision = "float";  // visibility filter: float | double
+    bool verify_geometry = false;
+    std::string trig = "libm";      // constellation generator: libm | poly
+    bool bench_constellation = false;
+    bool perf = false;              // per-phase perf_event report at exit
+    bool alloc = false;             // per-phase heap allocation report at exit
+    double des_sec = 0.0;           // > 0: discrete-event run of this length, no data.js
+    int des_stations = 20;          // cities first, then lattice terminals
+    double des_rate = 50.0;         // packets/s per station
+    double des_tick_sec = 10.0;     // orbit propagation step
+    int des_beams = 8;              // stations one satellite can serve
+    int des_workers = 0;            // > 0: conservative parallel engine
+    bool des_compare = false;       // also run the sequential engine and compare
+    bool des_plan = false;          // also plan each station with HandoffScheduler
+    int topk_stations = 0;          // > 0: top-k benchmark at this many stations
+    int top_k = 4;                  // best satellites kept per station
+    std::string top_by = "elevation";  // top-k ranking: elevation | latency
+    int horizon_stations = 0;       // > 0: horizon mask benchmark at this many stations
 };
 
+// "0.01,0.03" -> {0.01, 0.03}
+std::vector<double> parseList(const std::string& text) {
+    std::vector<double> values;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) values.push_back(std::stod(item));
+    }
+    return values;
+}
+
 void printUsage(const char* prog) {
     std::cout << "Usage: " << prog << " [options]\n\n"
               << "Options:\n"
@@ -661,6 +1817,30 @@ void printUsage(const char* prog) {
               << "  --handoff-sats N     Handoff windows (default 18)\n"
               << "  --handoff-time SEC   Handoff timeline seconds (default 3600)\n"
               << "  --seed N             RNG seed (default 42)\n"
+              << "  --rng R              mt19937 | philox (default mt19937)\n"
+              << "  --threads N          Generator / Monte Carlo threads (default: all)\n"
+              << "  --monte-carlo N      Batch mode: up to N trials per parameter set\n"
+              << "  --mc-ci F            Stop once 95% CIs are within F of the mean (default 0.01)\n"
+              << "  --mc-drop LIST       Drop probabilities to sweep, e.g. 0.01,0.03\n"
+              << "  --mc-sats LIST       Handoff window counts to sweep, e.g. 12,18,24\n"
+              << "  --precision P        Visibility filter: float (SIMD) | double (default float)\n"
+              << "  --verify-geometry    Time float vs double edges and check they match\n"
+              << "  --trig T             Constellation trig: libm | poly (default libm)\n"
+              << "  --bench-constellation  Time compile-time vs runtime shell generators\n"
+              << "  --bench-topk N       Top-k per station vs all edges + sort, N stations\n"
+              << "  --top-k K            Satellites kept per station (default 4)\n"
+              << "  --top-by R           Top-k ranking: elevation | latency (default elevation)\n"
+              << "  --bench-horizon N    Horizon masks + scan cones vs plain threshold, N stations\n"
+              << "  --des SEC            Discrete-event run: orbits, handoffs, packets on one clock\n"
+              << "  --des-stations N     Stations/terminals in the run (default 20)\n"
+              << "  --des-rate R         Packets/s per station (default 50)\n"
+              << "  --des-tick S         Orbit propagation step (default 10)\n"
+              << "  --des-beams N        Stations one satellite can serve (default 8)\n"
+              << "  --des-workers N      Conservative parallel engine with N workers\n"
+              << "  --des-compare        Check the parallel result against the sequential one\n"
+              << "  --des-plan           Compare online coverage with HandoffScheduler's plan\n"
+              << "  --perf               Per-phase cycles/IPC/LLC/branch report\n"
+              << "  --alloc              Per-phase heap bytes, allocation counts, peak RSS\n"
               << "  --help               Show this help\n";
 }
 
@@ -701,6 +1881,70 @@ bool parseArgs(int argc, char** argv, Args& args) {
             args.handoff_time_sec = std::stod(needValue("--handoff-time"));
         } else if (arg == "--seed") {
             args.seed = static_cast<unsigned>(std::stoul(needValue("--seed")));
+        } else if (arg == "--rng") {
+            args.rng = needValue("--rng");
+            if (args.rng != "mt19937" && args.rng != "philox") {
+                std::cerr << "Unknown RNG: " << args.rng << "\n";
+                return false;
+            }
+        } else if (arg == "--threads") {
+            args.threads = std::max(1, std::stoi(needValue("--threads")));
+        } else if (arg == "--monte-carlo") {
+            args.mc_trials = std::stoi(needValue("--monte-carlo"));
+        } else if (arg == "--mc-ci") {
+            args.mc_ci = std::stod(needValue("--mc-ci"));
+        } else if (arg == "--mc-drop") {
+            args.mc_drop = parseList(needValue("--mc-drop"));
+        } else if (arg == "--mc-sats") {
+            args.mc_sats = parseList(needValue("--mc-sats"));
+        } else if (arg == "--precision") {
+            args.precision = needValue("--precision");
+            if (args.precision != "float" && args.precision != "double") {
+                std::cerr << "Unknown precision: " << args.precision << "\n";
+                return false;
+            }
+        } else if (arg == "--verify-geometry") {
+            args.verify_geometry = true;
+        } else if (arg == "--bench-constellation") {
+            args.bench_constellation = true;
+        } else if (arg == "--bench-topk") {
+            args.topk_stations = std::max(1, std::stoi(needValue("--bench-topk")));
+        } else if (arg == "--top-k") {
+            args.top_k = std::max(1, std::stoi(needValue("--top-k")));
+        } else if (arg == "--top-by") {
+            args.top_by = needValue("--top-by");
+            if (args.top_by != "elevation" && args.top_by != "latency") {
+                std::cerr << "Unknown top-k ranking: " << args.top_by << "\n";
+                return false;
+            }
+        } else if (arg == "--bench-horizon") {
+            args.horizon_stations = std::max(1, std::stoi(needValue("--bench-horizon")));
+        } else if (arg == "--des") {
+            args.des_sec = std::stod(needValue("--des"));
+        } else if (arg == "--des-stations") {
+            args.des_stations = std::max(1, std::stoi(needValue("--des-stations")));
+        } else if (arg == "--des-rate") {
+            args.des_rate = std::stod(needValue("--des-rate"));
+        } else if (arg == "--des-tick") {
+            args.des_tick_sec = std::stod(needValue("--des-tick"));
+        } else if (arg == "--des-beams") {
+            args.des_beams = std::stoi(needValue("--des-beams"));
+        } else if (arg == "--des-workers") {
+            args.des_workers = std::max(0, std::stoi(needValue("--des-workers")));
+        } else if (arg == "--des-compare") {
+            args.des_compare = true;
+        } else if (arg == "--des-plan") {
+            args.des_plan = true;
+        } else if (arg == "--perf") {
+            args.perf = true;
+        } else if (arg == "--alloc") {
+            args.alloc = true;
+        } else if (arg == "--trig") {
+            args.trig = needValue("--trig");
+            if (args.trig != "libm" && args.trig != "poly") {
+                std::cerr << "Unknown trig: " << args.trig << "\n";
+                return false;
+            }
         } else if (arg == "--help") {
             printUsage(argv[0]);
             return false;
@@ -1002,59 +2246,1431 @@ std::string buildGlobeJson(const std::vector<OrbitalShell>& shells,
     return os.str();
 }
 
+// Compile-time shell kernels against the runtime-parameter generator
+template<typename Trig>
+int benchConstellation() {
+    constexpr int REPS = 200;
+    PerfPhase perf("constellation bench");
+    const auto shells = starlinkShells();
+    std::vector<Satellite> generic, fixed;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < REPS; r++) generic = generateFullConstellation<Trig>(shells);
+    double generic_us = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start).count() / REPS;
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < REPS; r++) fixed = generateStarlinkShells<Trig>();
+    double fixed_us = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start).count() / REPS;
+
+    bool same = generic.size() == fixed.size();
+    for (size_t i = 0; same && i < generic.size(); i++) {
+        const auto& a = generic[i];
+        const auto& b = fixed[i];
+        same = a.id == b.id && a.orbital_plane == b.orbital_plane &&
+               a.shell_id == b.shell_id &&
+               a.position.lat_deg == b.position.lat_deg &&
+               a.position.lon_deg == b.position.lon_deg &&
+               a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+    std::printf("Constellation: %zu satellites in %zu shells, %d reps\n",
+                fixed.size(), NUM_STARLINK_SHELLS, REPS);
+    std::printf("  runtime shells   %8.1f us\n", generic_us);
+    std::printf("  constexpr shells %8.1f us  (%.2fx), %s\n",
+                fixed_us, generic_us / fixed_us, same ? "identical" : "MISMATCH");
+    return same ? 0 : 1;
+}
+
+/**
+ * Times the double and float-filtered edge builders and checks they
+ * produce the same edges, at the configured mask and a few others.
+ */
+int verifyGeometry(const std::vector<Satellite>& sats,
+                   const std::vector<GroundStation>& stations,
+                   double min_elevation_deg) {
+    constexpr int REPS = 20;
+    int failures = 0;
+    std::cout << "  Geometry check (" << sats.size() << " x " << stations.size()
+              << " pairs, " << REPS << " reps):\n";
+    for (double mask : {min_elevation_deg, 10.0, 40.0, 60.0}) {
+        VisibilityStats ref_stats, fast_stats;
+        FastVisibilityStats fast;
+        std::vector<VisibilityEdge> ref, got;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < REPS; r++) {
+            ref_stats = {};
+            ref = buildVisibilityEdges(sats, stations, mask, ref_stats);
+        }
+        double ref_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count() / REPS;
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < REPS; r++) {
+            fast_stats = {};
+            fast = {};
+            got = buildVisibilityEdgesFast(sats, stations, mask, fast_stats, fast);
+        }
+        double fast_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count() / REPS;
+
+        bool same = ref.size() == got.size() &&
+                    ref_stats.avg_elev == fast_stats.avg_elev;
+        for (size_t i = 0; same && i < ref.size(); i++) {
+            same = ref[i].satellite_id == got[i].satellite_id &&
+                   ref[i].station_id == got[i].station_id &&
+                   ref[i].elevation_deg == got[i].elevation_deg &&
+                   ref[i].slant_km == got[i].slant_km;
+        }
+        failures += !same;
+        std::printf("    mask %4.1f deg: %6zu edges, double %.2f ms, float %.2f ms (%.1fx), "
+                    "%.1f%% settled in float, %llu band rechecks, %s\n",
+                    mask, got.size(), ref_ms, fast_ms, ref_ms / fast_ms,
+                    100.0 * fast.float_rejected / fast.pairs,
+                    static_cast<unsigned long long>(fast.band_rechecks),
+                    same ? "identical" : "MISMATCH");
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+/**
+ * Top-k per station against the full edge list grouped by station and
+ * sorted: time, bytes held by the result, and whether both agree.
+ */
+int benchTopK(const Args& args) {
+    constexpr int REPS = 5;
+    PerfPhase perf("top-k bench");
+    const auto sats = generateStarlinkShells();
+    const auto stations = latticeStations(args.topk_stations);
+    const TopKBy by = args.top_by == "latency" ? TopKBy::LATENCY : TopKBy::ELEVATION;
+    const int k = args.top_k;
+    const double mask = args.min_elevation_deg;
+    auto ahead = [by](const VisibilityEdge& a, const VisibilityEdge& b) {
+        return ranksAhead(a, b, by);
+    };
+
+    std::vector<VisibilityEdge> edges, grouped;
+    std::vector<size_t> offset;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < REPS; r++) {
+        VisibilityStats vis_stats;
+        FastVisibilityStats fast;
+        edges = buildVisibilityEdgesFast(sats, stations, mask, vis_stats, fast);
+        offset.assign(stations.size() + 1, 0);
+        for (size_t g = 0; g < stations.size(); g++) {
+            offset[g + 1] = offset[g] + vis_stats.coverage_counts[g];
+        }
+        grouped.resize(edges.size());
+        std::vector<size_t> fill(offset.begin(), offset.end() - 1);
+        for (const auto& e : edges) grouped[fill[e.station_id]++] = e;
+        for (size_t g = 0; g < stations.size(); g++) {
+            std::sort(grouped.begin() + offset[g], grouped.begin() + offset[g + 1], ahead);
+        }
+    }
+    double full_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count() / REPS;
+    size_t full_bytes = (edges.capacity() + grouped.capacity()) * sizeof(VisibilityEdge) +
+                        offset.capacity() * sizeof(size_t);
+
+    TopKEdges top;
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < REPS; r++) {
+        FastVisibilityStats fast;
+        top = topKVisibility(sats, stations, mask, k, by, fast);
+    }
+    double top_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count() / REPS;
+    size_t top_bytes = top.slots.capacity() * sizeof(VisibilityEdge) +
+                       top.count.capacity() * sizeof(int);
+
+    bool same = true;
+    for (size_t g = 0; same && g < stations.size(); g++) {
+        size_t want = std::min<size_t>(k, offset[g + 1] - offset[g]);
+        same = static_cast<size_t>(top.count[g]) == want;
+        for (size_t j = 0; same && j < want; j++) {
+            const auto& a = grouped[offset[g] + j];
+            const auto& b = top.station(g)[j];
+            same = a.satellite_id == b.satellite_id && a.elevation_deg == b.elevation_deg &&
+                   a.slant_km == b.slant_km;
+        }
+    }
+
+    double degree = static_cast<double>(edges.size()) / stations.size();
+    std::printf("Top-%d by %s: %zu satellites x %zu stations, mean degree %.1f, %d reps\n",
+                k, args.top_by.c_str(), sats.size(), stations.size(), degree, REPS);
+    std::printf("  all edges + sort  %8.2f ms  %9.2f MB\n", full_ms, full_bytes / 1048576.0);
+    std::printf("  top-k heaps       %8.2f ms  %9.2f MB  (%.1f%% of the memory, k/degree %.1f%%), %s\n",
+                top_ms, top_bytes / 1048576.0, 100.0 * top_bytes / full_bytes,
+                100.0 * k / degree, same ? "identical" : "MISMATCH");
+    return same ? 0 : 1;
+}
+
+// A plausible site: rolling terrain a few degrees above the floor, a
+// couple of buildings, and on phased-array terminals a tilted scan cone
+HorizonMask syntheticHorizon(std::mt19937& rng, double floor_deg, bool phased_array) {
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    HorizonMask h;
+    double ridge = 2.0 + 8.0 * unit(rng);
+    double phase = 360.0 * unit(rng);
+    for (int b = 0; b < HorizonMask::BINS; b++) {
+        double az = (b + 0.5) * 360.0 / HorizonMask::BINS;
+        double hills = ridge * std::max(0.0, std::sin((3.0 * az + phase) * DEG_TO_RAD));
+        h.min_elev_deg[b] = static_cast<float>(floor_deg + hills);
+    }
+    for (int building = 0; building < 2; building++) {
+        int first = static_cast<int>(HorizonMask::BINS * unit(rng));
+        int width = 10 + static_cast<int>(30 * unit(rng));
+        float top = static_cast<float>(40.0 + 20.0 * unit(rng));
+        for (int b = first; b < first + width; b++) {
+            float& bin = h.min_elev_deg[b % HorizonMask::BINS];
+            bin = std::max(bin, top);
+        }
+    }
+    if (phased_array) {
+        h.boresight_az_deg = 360.0 * unit(rng);
+        h.boresight_el_deg = 60.0 + 15.0 * unit(rng);
+        h.fov_half_deg = 50.0;
+    }
+    return h;
+}
+
+/**
+ * Horizon masks against the plain threshold on the same stations: kernel
+ * time, how many pairs needed an azimuth, and a check of the masked
+ * float kernel against the double reference.
+ */
+int benchHorizon(const Args& args) {
+    constexpr int REPS = 5;
+    PerfPhase perf("horizon bench");
+    const auto sats = generateStarlinkShells();
+    auto stations = latticeStations(args.horizon_stations);
+    const double mask = args.min_elevation_deg;
+
+    auto timeFast = [&](std::vector<VisibilityEdge>& edges, FastVisibilityStats& fast) {
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < REPS; r++) {
+            VisibilityStats vis_stats;
+            fast = {};
+            edges = buildVisibilityEdgesFast(sats, stations, mask, vis_stats, fast);
+        }
+        return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count() / REPS;
+    };
+    std::vector<VisibilityEdge> plain, masked;
+    FastVisibilityStats plain_fast, masked_fast;
+    double plain_ms = timeFast(plain, plain_fast);
+
+    std::mt19937 rng(args.seed);
+    int cones = 0;
+    for (size_t g = 0; g < stations.size(); g++) {
+        bool phased_array = g % 3 == 2;
+        cones += phased_array;
+        stations[g].horizon = std::make_shared<HorizonMask>(
+            syntheticHorizon(rng, mask, phased_array));
+    }
+    double masked_ms = timeFast(masked, masked_fast);
+
+    VisibilityStats ref_stats;
+    auto start = std::chrono::steady_clock::now();
+    auto ref = buildVisibilityEdges(sats, stations, mask, ref_stats);
+    double ref_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    bool same = ref.size() == masked.size();
+    for (size_t i = 0; same && i < ref.size(); i++) {
+        same = ref[i].satellite_id == masked[i].satellite_id &&
+               ref[i].station_id == masked[i].station_id &&
+               ref[i].elevation_deg == masked[i].elevation_deg;
+    }
+
+    std::printf("Horizon masks: %zu satellites x %zu stations (%d with scan cones), %d reps\n",
+                sats.size(), stations.size(), cones, REPS);
+    std::printf("  threshold only   %8.2f ms  %8zu edges\n", plain_ms, plain.size());
+    std::printf("  masks + cones    %8.2f ms  %8zu edges  (%.2fx), %llu azimuths "
+                "(%.2f%% of pairs), %llu double rechecks\n",
+                masked_ms, masked.size(), masked_ms / plain_ms,
+                static_cast<unsigned long long>(masked_fast.horizon_lookups),
+                100.0 * masked_fast.horizon_lookups / masked_fast.pairs,
+                static_cast<unsigned long long>(masked_fast.horizon_rechecks));
+    std::printf("  double reference %8.2f ms  %8zu edges, %s\n",
+                ref_ms, ref.size(), same ? "identical" : "MISMATCH");
+    return same ? 0 : 1;
+}
+
 // ============================================================
-// Main
+// Monte Carlo Batch Mode
 // ============================================================
-int main(int argc, char** argv) {
-    Args args;
-    if (!parseArgs(argc, argv, args)) {
+
+// Buffers one worker reuses across all of its trials
+struct TrialWorkspace {
+    std::vector<int> seqs;
+    std::vector<VisibilityWindow> windows;
+};
+
+struct TrialResult {
+    double gaps;
+    double max_displacement;   // furthest a packet arrived from its slot
+    double coverage_pct;
+    double min_signal_db;
+    double handoffs;
+};
+
+/**
+ * Packet half of a trial: the same draws, in the same order, as
+ * simulatePacketStream with this seed, reduced to counts so nothing is
+ * allocated per trial.
+ */
+void packetTrial(const Args& args, unsigned seed, TrialWorkspace& ws, TrialResult& out) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> prob(0.0, 1.0);
+    std::uniform_int_distribution<int> pri_dist(0, 3);
+    std::uniform_int_distribution<int> dst_dist(0, args.num_queues - 1);
+    std::uniform_int_distribution<int> swap_dist(1, 8);
+
+    const int n = args.num_packets;
+    ws.seqs.resize(n);
+    std::iota(ws.seqs.begin(), ws.seqs.end(), 0);
+    for (int i = 0; i < n; i++) {
+        if (prob(rng) < args.reorder_prob && i + 1 < n) {
+            int offset = std::min(swap_dist(rng), n - i - 1);
+            std::swap(ws.seqs[i], ws.seqs[i + offset]);
+        }
+    }
+
+    int gaps = 0, max_displacement = 0;
+    for (int i = 0; i < n; i++) {
+        if (prob(rng) < args.drop_prob) {
+            gaps++;
+            continue;
+        }
+        pri_dist(rng);
+        dst_dist(rng);
+        max_displacement = std::max(max_displacement, std::abs(ws.seqs[i] - i));
+    }
+    out.gaps = gaps;
+    out.max_displacement = max_displacement;
+}
+
+void handoffTrial(const Args& args, unsigned seed, TrialWorkspace& ws, TrialResult& out) {
+    generateWindowsInto(ws.windows, args.num_handoff_sats, args.handoff_time_sec, seed);
+    auto result = HandoffScheduler::schedule(ws.windows, args.handoff_time_sec);
+    out.coverage_pct = 100.0 * result.total_coverage_time / args.handoff_time_sec;
+    out.min_signal_db = result.min_signal_quality;
+    out.handoffs = result.num_handoffs;
+}
+
+/**
+ * Runs trials in batches across worker threads until every metric's 95%
+ * confidence interval is within `mc_ci` of its mean, or `mc_trials` is
+ * reached. Trial t's seed comes from a Philox stream per parameter set,
+ * results are folded into the estimators in trial order, and stopping
+ * is only decided between batches — so the output does not depend on
+ * the thread count.
+ */
+int runMonteCarlo(const Args& args) {
+    constexpr int BATCH = 256;
+    constexpr uint64_t MIN_TRIALS = 2 * BATCH;
+    const int threads = args.threads;
+    std::vector<TrialWorkspace> workspaces(threads);
+    std::vector<TrialResult> batch(BATCH);
+
+    std::vector<double> drops = args.mc_drop;
+    if (drops.empty()) drops.push_back(args.drop_prob);
+    std::vector<double> sat_counts = args.mc_sats;
+    if (sat_counts.empty()) sat_counts.push_back(args.num_handoff_sats);
+
+    std::cout << "Monte Carlo: " << drops.size() * sat_counts.size()
+              << " parameter sets, up to " << args.mc_trials << " trials each, "
+              << threads << " threads, target CI ±" << args.mc_ci * 100 << "% of mean\n";
+
+    int set = 0;
+    for (double drop : drops) {
+        for (double sats : sat_counts) {
+            Args trial_args = args;
+            trial_args.drop_prob = drop;
+            trial_args.num_handoff_sats = static_cast<int>(sats);
+            const Philox4x32 seeds(args.seed, 3 + set++);
+
+            std::array<MetricEstimator, 5> metrics = {
+                MetricEstimator("gaps"), MetricEstimator("max_displacement"),
+                MetricEstimator("coverage_pct"), MetricEstimator("min_signal_db"),
+                MetricEstimator("handoffs")};
+            PerfPhase perf_trials("mc trials");
+            auto start = std::chrono::steady_clock::now();
+            uint64_t trials = 0;
+            bool converged = false;
+            while (trials < static_cast<uint64_t>(args.mc_trials) && !converged) {
+                int n = static_cast<int>(std::min<uint64_t>(BATCH, args.mc_trials - trials));
+                auto work = [&](int w) {
+                    for (int i = w; i < n; i += threads) {
+                        unsigned seed = seeds.at(trials + i)[0];
+                        packetTrial(trial_args, seed, workspaces[w], batch[i]);
+                        handoffTrial(trial_args, seed, workspaces[w], batch[i]);
+                    }
+                };
+                std::vector<std::thread> workers;
+                for (int w = 1; w < threads; w++) workers.emplace_back(work, w);
+                work(0);
+                for (auto& t : workers) t.join();
+
+                for (int i = 0; i < n; i++) {
+                    const auto& r = batch[i];
+                    metrics[0].add(r.gaps);
+                    metrics[1].add(r.max_displacement);
+                    metrics[2].add(r.coverage_pct);
+                    metrics[3].add(r.min_signal_db);
+                    metrics[4].add(r.handoffs);
+                }
+                trials += n;
+                converged = trials >= MIN_TRIALS &&
+                    std::all_of(metrics.begin(), metrics.end(),
+                                [&](const MetricEstimator& m) { return m.converged(args.mc_ci); });
+            }
+            double sec = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+            perf_trials.setItems(trials);
+            perf_trials.stop();
+
+            std::printf("\n=== drop=%.3f handoff_sats=%d: %llu trials, %s, %.2f s ===\n",
+                        drop, trial_args.num_handoff_sats,
+                        static_cast<unsigned long long>(trials),
+                        converged ? "CI target reached" : "trial limit reached", sec);
+            std::printf("  %-17s %10s %10s %10s %10s %10s %10s\n",
+                        "metric", "mean", "±95%CI", "stddev", "p05", "p50", "p95");
+            for (const auto& m : metrics) {
+                std::printf("  %-17s %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+                            m.name, m.stats.mean(), m.stats.ciHalfWidth(), m.stats.stddev(),
+                            m.p05.value(), m.p50.value(), m.p95.value());
+            }
+        }
+    }
+    return 0;
+}
+
+// ============================================================
+// Discrete-Event Simulation
+// ============================================================
+// --des SEC: the constellation, the handoff logic and the packet path on
+// one simulated clock. Nothing sleeps and nothing reads the wall clock,
+// so an hour of traffic runs as fast as the events can be handled and
+// the same seed always gives the same result.
+//
+// Handoffs are decided online, as satellites set, with beam contention
+// between stations. With --des-plan, HandoffScheduler then plans each
+// station over the passes the run observed, for comparison: it sees
+// every pass in advance but ignores beams and needs MIN_OVERLAP_SEC of
+// overlap per handoff, so neither coverage bounds the other.
+// The reorder buffer follows the router's policy (release in order, skip
+// a gap after a timeout) on simulated time: packet_router's
+// ReorderingBuffer waits on the wall clock, so it cannot run here.
+//
+// Events are ordered by (time, station, per-station sequence). Ties
+// therefore never depend on the order events were inserted, only on
+// which station made them.
+
+enum class DesEventType : uint8_t {
+    ORBIT_TICK,      // propagate the constellation, schedule rise/set
+    RISE,            // satellite climbs above the station's mask
+    SET,             // ... and drops below it
+    HANDOFF,         // pick a serving satellite
+    PACKET_SEND,     // next packet leaves the terminal
+    PACKET_ARRIVAL,  // packet reaches the station's reorder buffer
+    TIMEOUT,         // reorder gap held too long: skip it
+    COUNT
+};
+
+constexpr const char* DES_EVENT_NAMES[] = {
+    "orbit tick", "rise", "set", "handoff", "packet send", "packet arrival", "timeout"};
+
+struct DesEvent {
+    double time;
+    int32_t station;     // -1 for constellation-wide events
+    int32_t satellite;
+    uint64_t seq;        // per-station counter
+    uint64_t data;       // packet number, timeout generation
+    DesEventType type;
+
+    bool operator<(const DesEvent& o) const {
+        if (time != o.time) return time < o.time;
+        if (station != o.station) return station < o.station;
+        return seq < o.seq;
+    }
+};
+
+/**
+ * Calendar queue (Brown, 1988): a ring of buckets, each one `width`
+ * seconds wide, like the days of a year. An event goes into bucket
+ * floor(time / width) mod nbuckets; popping walks the ring from the
+ * current day and takes an event only if it falls in this year. With
+ * the bucket count kept near the event count and the width near a few
+ * mean inter-event gaps, push and pop are O(1) on average.
+ *
+ * Each bucket is a binary min-heap, so a burst of events at one instant
+ * (every satellite in view at t = 0) costs O(log n) each rather than a
+ * sorted insert.
+ */
+class CalendarQueue {
+public:
+    explicit CalendarQueue(double width = 1e-3) : width_(width) {
+        buckets_.resize(MIN_BUCKETS);
+    }
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+
+    void push(const DesEvent& ev) {
+        uint64_t slot = slotOf(ev.time);
+        if (slot < slot_) slot_ = slot;  // earlier than the last peek
+        insert(ev, slot);
+        if (++size_ > 2 * buckets_.size()) resize(buckets_.size() * 2);
+    }
+
+    // Earliest event, or nullptr; moves the scan position up to it
+    const DesEvent* front() {
+        if (size_ == 0) return nullptr;
+        const size_t mask = buckets_.size() - 1;
+        for (size_t n = 0; n < buckets_.size(); n++, slot_++) {
+            const auto& b = buckets_[slot_ & mask];
+            if (!b.empty() && slotOf(b.front().time) <= slot_) return &b.front();
+        }
+        // A whole year without an event: jump straight to the earliest
+        const DesEvent* earliest = nullptr;
+        for (const auto& b : buckets_) {
+            if (!b.empty() && (!earliest || b.front() < *earliest)) earliest = &b.front();
+        }
+        slot_ = slotOf(earliest->time);
+        return earliest;
+    }
+
+    DesEvent pop() {
+        front();
+        auto& b = buckets_[slot_ & (buckets_.size() - 1)];
+        std::pop_heap(b.begin(), b.end(), later);
+        DesEvent ev = b.back();
+        b.pop_back();
+        if (--size_ < buckets_.size() / 2 && buckets_.size() > MIN_BUCKETS) {
+            resize(buckets_.size() / 2);
+        }
+        return ev;
+    }
+
+private:
+    static constexpr size_t MIN_BUCKETS = 16;
+    static constexpr size_t WIDTH_SAMPLE = 25;
+
+    uint64_t slotOf(double time) const { return static_cast<uint64_t>(time / width_); }
+
+    static bool later(const DesEvent& a, const DesEvent& b) { return b < a; }
+
+    void insert(const DesEvent& ev, uint64_t slot) {
+        auto& b = buckets_[slot & (buckets_.size() - 1)];
+        b.push_back(ev);
+        std::push_heap(b.begin(), b.end(), later);
+    }
+
+    // New bucket count; the width becomes three mean gaps between the
+    // earliest few events, as Brown suggests
+    void resize(size_t nbuckets) {
+        std::vector<DesEvent> all;
+        all.reserve(size_);
+        for (auto& b : buckets_) {
+            all.insert(all.end(), b.begin(), b.end());
+            b.clear();
+        }
+        size_t k = std::min(all.size(), WIDTH_SAMPLE);
+        std::partial_sort(all.begin(), all.begin() + k, all.end());
+        if (k > 1) {
+            double gap = (all[k - 1].time - all[0].time) / (k - 1);
+            if (gap > 0.0) width_ = 3.0 * gap;
+        }
+        buckets_.assign(nbuckets, {});
+        slot_ = all.empty() ? 0 : slotOf(all[0].time);
+        for (const auto& ev : all) insert(ev, slotOf(ev.time));
+    }
+
+    std::vector<std::vector<DesEvent>> buckets_;
+    double width_;
+    uint64_t slot_ = 0;  // no event lives in an earlier slot
+    size_t size_ = 0;
+};
+
+// Rise, set and handoff are the only events that lead to a message
+// another station can see (an attach or release at a satellite)
+constexpr bool desSendsMessages(DesEventType type) {
+    return type == DesEventType::RISE || type == DesEventType::SET ||
+           type == DesEventType::HANDOFF;
+}
+
+// Simulated clock over a calendar queue
+class DesEngine {
+public:
+    double now() const { return now_; }
+    size_t pending() const { return queue_.size(); }
+    uint64_t processed(DesEventType type) const { return counts_[static_cast<int>(type)]; }
+
+    void schedule(const DesEvent& ev) {
+        queue_.push(ev);
+        if (desSendsMessages(ev.type)) message_times_.push(ev.time);
+    }
+
+    // Next event earlier than `until`, advancing the clock to it
+    bool next(double until, DesEvent& ev) {
+        const DesEvent* f = queue_.front();
+        if (!f || f->time >= until) return false;
+        ev = queue_.pop();
+        now_ = ev.time;
+        counts_[static_cast<int>(ev.type)]++;
+        if (desSendsMessages(ev.type)) message_times_.pop();  // it was the earliest
+        return true;
+    }
+
+    // Time of the earliest pending event that may send a message
+    double nextMessageTime() const {
+        return message_times_.empty() ? INFINITY : message_times_.top();
+    }
+
+private:
+    CalendarQueue queue_;
+    std::priority_queue<double, std::vector<double>, std::greater<double>> message_times_;
+    double now_ = 0.0;
+    uint64_t counts_[static_cast<int>(DesEventType::COUNT)] = {};
+};
+
+/**
+ * Stations attached to each satellite, as the satellite sees it.
+ * Attach and release messages reach the satellite one link latency
+ * after the station sends them, so a station choosing a satellite at
+ * time t sees exactly the messages that arrived by t.
+ */
+class SatLoadBoard {
+public:
+    SatLoadBoard() = default;
+    explicit SatLoadBoard(size_t num_sats) : base_(num_sats, 0), pending_(num_sats) {}
+
+    void post(int sat, double arrival, int delta) {
+        if (pending_[sat].empty()) dirty_.push_back(sat);
+        pending_[sat].push_back({arrival, delta});
+    }
+
+    int loadAt(int sat, double t) const {
+        int load = base_[sat];
+        for (const auto& m : pending_[sat]) {
+            if (m.arrival <= t) load += m.delta;
+        }
+        return load;
+    }
+
+    // Folds messages that arrived by `t` into the counts; nobody may
+    // ask about an earlier time afterwards
+    void settle(double t) {
+        size_t kept = 0;
+        for (int sat : dirty_) {
+            auto& msgs = pending_[sat];
+            auto later = std::partition(msgs.begin(), msgs.end(),
+                                        [&](const Message& m) { return m.arrival <= t; });
+            for (auto it = msgs.begin(); it != later; ++it) base_[sat] += it->delta;
+            msgs.erase(msgs.begin(), later);
+            if (!msgs.empty()) dirty_[kept++] = sat;
+        }
+        dirty_.resize(kept);
+    }
+
+private:
+    struct Message {
+        double arrival;
+        int delta;
+    };
+
+    std::vector<int> base_;
+    std::vector<std::vector<Message>> pending_;
+    std::vector<int> dirty_;  // satellites with pending messages
+};
+
+struct DesConfig {
+    double duration_sec = 3600.0;
+    double tick_sec = 10.0;           // orbit propagation step
+    double packet_rate = 50.0;        // packets/s per station (Poisson)
+    double drop_prob = 0.03;
+    double jitter_ms = 0.5;           // queueing jitter on top of the slant delay
+    double reorder_timeout_ms = 10.0;
+    int beams = 8;                    // stations one satellite can serve
+    double min_elevation_deg = 25.0;
+    unsigned seed = 42;
+    bool plan = false;                // HandoffScheduler over each station's passes
+};
+
+struct DesStationStats {
+    uint64_t sent = 0;         // transmitted via a satellite
+    uint64_t carried = 0;      // ... and not dropped on the way
+    uint64_t outage = 0;       // generated while no satellite was serving
+    uint64_t delivered = 0;    // released in order by the reorder buffer
+    uint64_t reordered = 0;    // arrived ahead of a gap
+    uint64_t late = 0;         // arrived after its gap was skipped
+    uint64_t lost = 0;         // skipped by a reorder timeout
+    uint64_t handoffs = 0;
+    uint64_t blocked = 0;      // handoffs with every visible satellite full
+    double latency_ms_sum = 0.0;
+    double served_sec = 0.0;   // time with a serving satellite
+    double planned_sec = 0.0;  // HandoffScheduler's coverage over the same passes
+};
+
+// Per-station state; touched only by that station's events
+struct DesStation {
+    Vec3 unit;
+    std::vector<int> visible;   // risen and not yet set
+    std::vector<size_t> open;   // visible[i]'s entry in `passes`
+    std::vector<VisibilityWindow> passes;  // every rise/set seen, for the planner
+    std::vector<double> peak_dot;          // per pass, highest sampled
+    int serving = -1;
+    double serving_since = 0.0;
+    bool handoff_pending = false;
+    uint64_t next_seq = 0;      // event tie-break counter
+    uint64_t next_packet = 0;   // packet numbers handed out so far
+    uint64_t expected = 0;      // reorder buffer: next packet to release
+    std::set<uint64_t> held;
+    bool timeout_pending = false;
+    DesStationStats stats;
+};
+
+/**
+ * The scenario: the Starlink shells propagated in time (circular
+ * Keplerian orbits under a rotating Earth), stations that hand off to
+ * the highest satellite with a free beam when theirs sets (their own
+ * online rule, not HandoffScheduler's offline plan), and a Poisson
+ * packet stream per station whose delay follows the serving satellite's
+ * slant range, through a reorder buffer with a gap timeout.
+ *
+ * Satellite positions are sampled every tick; in between, each pair's
+ * dot product is interpolated linearly, which places rise/set crossings
+ * and slant ranges well inside a second for 10 s ticks.
+ */
+class DesSimulation {
+public:
+    // Signal stand-in for the planner: 8 dB at the elevation mask up to
+    // 25 dB overhead, the range of the synthetic handoff windows
+    static constexpr double PASS_SIGNAL_MIN_DB = 8.0;
+    static constexpr double PASS_SIGNAL_MAX_DB = 25.0;
+
+    DesSimulation(const DesConfig& cfg, const std::vector<GroundStation>& stations)
+        : cfg_(cfg), packet_rng_(cfg.seed, DES_PACKET_STREAM) {
+        for (const auto& spec : STARLINK_SHELLS) {
+            double a = EARTH_RADIUS_KM + spec.altitude_km;
+            double inc = spec.inclination_deg * DEG_TO_RAD;
+            double phase_per_plane = 360.0 / (spec.num_planes * spec.sats_per_plane);
+            double threshold = coverageCos(spec.altitude_km, cfg.min_elevation_deg);
+            for (int p = 0; p < spec.num_planes; p++) {
+                for (int s = 0; s < spec.sats_per_plane; s++) {
+                    double u_deg = (360.0 / spec.sats_per_plane) * s + phase_per_plane * p;
+                    orbits_.push_back({(360.0 / spec.num_planes) * p, u_deg * DEG_TO_RAD,
+                                       std::sin(inc), std::cos(inc), spec.altitude_km,
+                                       std::sqrt(EARTH_MU / (a * a * a)), threshold});
+                }
+            }
+        }
+        for (const auto& gs : stations) {
+            DesStation st;
+            st.unit = geoTo3D<double>(gs.position.lat_deg, gs.position.lon_deg, 0.0);
+            stations_.push_back(std::move(st));
+        }
+        pos0_.resize(orbits_.size());
+        pos1_.resize(orbits_.size());
+        board_ = SatLoadBoard(orbits_.size());
+        propagate(0.0, pos1_);
+    }
+
+    size_t numStations() const { return stations_.size(); }
+    size_t numSatellites() const { return orbits_.size(); }
+    const DesStationStats& stats(size_t s) const { return stations_[s].stats; }
+    const DesConfig& config() const { return cfg_; }
+
+    // Shortest delay of any attach/release: straight up to the lowest shell
+    static double minLinkDelaySec() {
+        double lowest = STARLINK_SHELLS[0].altitude_km;
+        for (const auto& spec : STARLINK_SHELLS) lowest = std::min(lowest, spec.altitude_km);
+        return computeLatencyMs(lowest) / 1000.0;
+    }
+
+    // Parallel runs: messages from station s collect in its worker's
+    // outbox and reach the load board between windows
+    void partition(const std::vector<int>& owner, int workers) {
+        owner_ = owner;
+        outboxes_.assign(workers, {});
+    }
+
+    void deliverOutboxes() {
+        for (auto& box : outboxes_) {
+            for (const auto& m : box) board_.post(m.sat, m.arrival, m.delta);
+            box.clear();
+        }
+    }
+
+    void settleBoard(double t) { board_.settle(t); }
+
+    // Events every run starts with: the first tick, each first packet
+    void seed(DesEngine& eng) {
+        eng.schedule({0.0, -1, -1, tick_seq_++, 0, DesEventType::ORBIT_TICK});
+        for (size_t s = 0; s < stations_.size(); s++) seedStation(eng, static_cast<int>(s));
+    }
+
+    void seedStation(DesEngine& eng, int s) {
+        double t = packetGap(s, 0);
+        if (t < cfg_.duration_sec) post(eng, t, s, DesEventType::PACKET_SEND, -1, 0);
+    }
+
+    void handle(DesEngine& eng, const DesEvent& ev) {
+        if (ev.type == DesEventType::ORBIT_TICK) {
+            advanceOrbits(ev.time);
+            for (size_t s = 0; s < stations_.size(); s++) {
+                scheduleCrossings(eng, static_cast<int>(s), ev.time);
+            }
+            board_.settle(ev.time);
+            if (ev.time + cfg_.tick_sec < cfg_.duration_sec) {
+                eng.schedule({ev.time + cfg_.tick_sec, -1, -1, tick_seq_++, 0,
+                              DesEventType::ORBIT_TICK});
+            }
+            return;
+        }
+        handleStation(eng, ev);
+    }
+
+    // Tick, constellation half: snapshots for [t, t + tick]
+    void advanceOrbits(double t) {
+        tick_start_ = t;
+        std::swap(pos0_, pos1_);
+        propagate(t + cfg_.tick_sec, pos1_);
+    }
+
+    // Tick, station half: rise/set crossings of station `s` in (t, t + tick]
+    void scheduleCrossings(DesEngine& eng, int s, double t) {
+        DesStation& st = stations_[s];
+        const Vec3& u = st.unit;
+        for (size_t i = 0; i < st.visible.size(); i++) {
+            double& peak = st.peak_dot[st.open[i]];
+            peak = std::max(peak, dot(u, pos1_[st.visible[i]]));
+        }
+        for (size_t i = 0; i < orbits_.size(); i++) {
+            double thr = orbits_[i].threshold;
+            double d0 = dot(u, pos0_[i]);
+            double d1 = dot(u, pos1_[i]);
+            int sat = static_cast<int>(i);
+            if (t == 0.0 && d0 >= thr) post(eng, 0.0, s, DesEventType::RISE, sat, 0);
+            if (d0 < thr && d1 >= thr) {
+                post(eng, t + cfg_.tick_sec * (thr - d0) / (d1 - d0), s, DesEventType::RISE, sat, 0);
+            } else if (d0 >= thr && d1 < thr) {
+                post(eng, t + cfg_.tick_sec * (d0 - thr) / (d0 - d1), s, DesEventType::SET, sat, 0);
+            }
+        }
+    }
+
+    void handleStation(DesEngine& eng, const DesEvent& ev) {
+        DesStation& st = stations_[ev.station];
+        switch (ev.type) {
+        case DesEventType::RISE:
+            st.visible.push_back(ev.satellite);
+            st.open.push_back(st.passes.size());
+            st.passes.push_back({ev.satellite, ev.time, cfg_.duration_sec, 0.0, 0.0, 0.0});
+            st.peak_dot.push_back(std::max(orbits_[ev.satellite].threshold,
+                                           dot(st.unit, pos1_[ev.satellite])));
+            if (st.serving < 0) requestHandoff(eng, ev.station, ev.time);
+            break;
+        case DesEventType::SET: {
+            auto it = std::find(st.visible.begin(), st.visible.end(), ev.satellite);
+            if (it != st.visible.end()) {
+                size_t i = static_cast<size_t>(it - st.visible.begin());
+                st.passes[st.open[i]].end_time = ev.time;
+                st.visible.erase(it);
+                st.open.erase(st.open.begin() + static_cast<std::ptrdiff_t>(i));
+            }
+            if (st.serving == ev.satellite) requestHandoff(eng, ev.station, ev.time);
+            break;
+        }
+        case DesEventType::HANDOFF:
+            handoff(ev.station, ev.time);
+            break;
+        case DesEventType::PACKET_SEND:
+            sendPacket(eng, ev.station, ev.time, ev.data);
+            break;
+        case DesEventType::PACKET_ARRIVAL:
+            receivePacket(eng, ev.station, ev.time, ev.data);
+            break;
+        case DesEventType::TIMEOUT:
+            st.timeout_pending = false;
+            if (ev.data == st.expected && !st.held.empty()) {
+                st.stats.lost += *st.held.begin() - st.expected;
+                st.expected = *st.held.begin();
+                release(st);
+            }
+            armTimeout(eng, ev.station, ev.time);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // After a run: closes the last service interval and, with `plan`,
+    // runs HandoffScheduler over each station's passes (no beam limit).
+    // The plan is quadratic in a station's passes, hence opt-in
+    void finish() {
+        for (DesStation& st : stations_) {
+            if (st.serving >= 0) st.stats.served_sec += cfg_.duration_sec - st.serving_since;
+            if (!cfg_.plan) continue;
+            for (size_t k = 0; k < st.passes.size(); k++) {
+                VisibilityWindow& w = st.passes[k];
+                w.peak_signal_quality = passSignalDb(w.satellite_id, st.peak_dot[k]);
+                w.start_signal_quality = w.signalAt(w.start_time);
+                w.end_signal_quality = w.signalAt(w.end_time);
+            }
+            st.stats.planned_sec =
+                HandoffScheduler::schedule(st.passes, cfg_.duration_sec).total_coverage_time;
+        }
+    }
+
+private:
+    static constexpr double EARTH_MU = 398600.4418;                 // km^3/s^2
+    static constexpr double EARTH_ROTATION_DEG_S = 360.0 / 86164.0905;
+    static constexpr uint64_t DES_PACKET_STREAM = 1ull << 32;       // clear of MC streams
+
+    struct Orbit {
+        double raan_deg;
+        double u_rad;
+        double sin_inc, cos_inc;
+        double altitude_km;
+        double mean_motion;   // rad/s
+        double threshold;     // coverageCos at the elevation mask
+    };
+
+    static double dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+    // Pass signal from its highest elevation, given as the cosine of the
+    // station-satellite central angle
+    double passSignalDb(int sat, double peak_dot) const {
+        const double R = EARTH_RADIUS_KM;
+        double r = R + orbits_[sat].altitude_km;
+        double d = std::min(peak_dot, 1.0);
+        double elev_deg = std::atan2(r * d - R, r * std::sqrt(1.0 - d * d)) / DEG_TO_RAD;
+        double f = (elev_deg - cfg_.min_elevation_deg) / (90.0 - cfg_.min_elevation_deg);
+        return PASS_SIGNAL_MIN_DB +
+               (PASS_SIGNAL_MAX_DB - PASS_SIGNAL_MIN_DB) * std::clamp(f, 0.0, 1.0);
+    }
+
+    // Unit sub-satellite vectors at time t
+    void propagate(double t, std::vector<Vec3>& out) {
+        for (size_t i = 0; i < orbits_.size(); i++) {
+            const Orbit& o = orbits_[i];
+            Satellite sat = walkerSatellite<LibmTrig>(
+                static_cast<int>(i), 0, 0, o.altitude_km, o.sin_inc, o.cos_inc,
+                o.raan_deg - EARTH_ROTATION_DEG_S * t, o.u_rad + o.mean_motion * t);
+            out[i] = geoTo3D<double>(sat.position.lat_deg, sat.position.lon_deg, 0.0);
+        }
+    }
+
+    void post(DesEngine& eng, double t, int s, DesEventType type, int sat, uint64_t data) {
+        eng.schedule({t, s, sat, stations_[s].next_seq++, data, type});
+    }
+
+    // One-way delay station <-> satellite at time t within the current tick
+    double linkDelayMs(int s, int sat, double t) const {
+        double f = std::clamp((t - tick_start_) / cfg_.tick_sec, 0.0, 1.0);
+        const Vec3& u = stations_[s].unit;
+        double d = dot(u, pos0_[sat]) + (dot(u, pos1_[sat]) - dot(u, pos0_[sat])) * f;
+        const double R = EARTH_RADIUS_KM;
+        double r = R + orbits_[sat].altitude_km;
+        return computeLatencyMs(std::sqrt(R * R + r * r - 2.0 * R * r * d));
+    }
+
+    void requestHandoff(DesEngine& eng, int s, double t) {
+        if (stations_[s].handoff_pending) return;
+        stations_[s].handoff_pending = true;
+        post(eng, t, s, DesEventType::HANDOFF, -1, 0);
+    }
+
+    // Highest satellite (by end-of-tick elevation) with a free beam;
+    // release and attach are both sent now, make-before-break
+    void handoff(int s, double t) {
+        DesStation& st = stations_[s];
+        st.handoff_pending = false;
+        int best = -1;
+        double best_dot = -2.0;
+        for (int sat : st.visible) {
+            if (sat == st.serving) continue;
+            double d = dot(st.unit, pos1_[sat]);
+            if (d > best_dot && board_.loadAt(sat, t) < cfg_.beams) {
+                best = sat;
+                best_dot = d;
+            }
+        }
+        if (best < 0 && st.serving >= 0 &&
+            std::find(st.visible.begin(), st.visible.end(), st.serving) != st.visible.end()) {
+            return;  // nothing better and the current one is still up
+        }
+        if (st.serving >= 0) {
+            sendLoad(s, st.serving, t + linkDelayMs(s, st.serving, t) / 1000.0, -1);
+            st.stats.served_sec += t - st.serving_since;
+        }
+        if (best >= 0) {
+            sendLoad(s, best, t + linkDelayMs(s, best, t) / 1000.0, +1);
+            st.stats.handoffs++;
+        } else {
+            st.stats.blocked++;
+        }
+        st.serving = best;
+        st.serving_since = t;
+    }
+
+    void sendLoad(int s, int sat, double arrival, int delta) {
+        if (owner_.empty()) {
+            board_.post(sat, arrival, delta);
+        } else {
+            outboxes_[owner_[s]].push_back({sat, arrival, delta});
+        }
+    }
+
+    // Inter-arrival gap before packet k, from block k of the station's stream
+    double packetGap(int s, uint64_t k) const {
+        auto b = packet_rng_.at(packetIndex(s, k));
+        return -std::log(Philox4x32::unit(b[0])) / cfg_.packet_rate;
+    }
+
+    static uint64_t packetIndex(int s, uint64_t k) {
+        return (static_cast<uint64_t>(s) << 32) | k;
+    }
+
+    void sendPacket(DesEngine& eng, int s, double t, uint64_t k) {
+        DesStation& st = stations_[s];
+        auto b = packet_rng_.at(packetIndex(s, k));
+        if (st.serving < 0) {
+            st.stats.outage++;
+        } else {
+            uint64_t seq = st.next_packet++;
+            st.stats.sent++;
+            if (Philox4x32::unit(b[1]) >= cfg_.drop_prob) {
+                double delay_ms = linkDelayMs(s, st.serving, t) +
+                                  cfg_.jitter_ms * Philox4x32::unit(b[2]);
+                st.stats.carried++;
+                st.stats.latency_ms_sum += delay_ms;
+                post(eng, t + delay_ms / 1000.0, s, DesEventType::PACKET_ARRIVAL,
+                     st.serving, seq);
+            }
+        }
+        double next = t + packetGap(s, k + 1);
+        if (next < cfg_.duration_sec) post(eng, next, s, DesEventType::PACKET_SEND, -1, k + 1);
+    }
+
+    void receivePacket(DesEngine& eng, int s, double t, uint64_t seq) {
+        DesStation& st = stations_[s];
+        if (seq < st.expected) {
+            st.stats.late++;
+            return;
+        }
+        if (seq == st.expected) {
+            st.stats.delivered++;
+            st.expected++;
+            release(st);
+        } else {
+            st.held.insert(seq);
+            st.stats.reordered++;
+        }
+        armTimeout(eng, s, t);
+    }
+
+    // Releases the run of held packets that now continues the sequence
+    static void release(DesStation& st) {
+        while (!st.held.empty() && *st.held.begin() == st.expected) {
+            st.held.erase(st.held.begin());
+            st.stats.delivered++;
+            st.expected++;
+        }
+    }
+
+    // One timeout at a time, for the gap at the head of the buffer
+    void armTimeout(DesEngine& eng, int s, double t) {
+        DesStation& st = stations_[s];
+        if (st.timeout_pending || st.held.empty()) return;
+        st.timeout_pending = true;
+        post(eng, t + cfg_.reorder_timeout_ms / 1000.0, s, DesEventType::TIMEOUT, -1,
+             st.expected);
+    }
+
+    DesConfig cfg_;
+    Philox4x32 packet_rng_;
+    std::vector<Orbit> orbits_;
+    std::vector<DesStation> stations_;
+    std::vector<Vec3> pos0_, pos1_;   // unit vectors at tick start and end
+    double tick_start_ = 0.0;
+    uint64_t tick_seq_ = 0;
+    SatLoadBoard board_;
+
+    struct LoadMessage {
+        int sat;
+        double arrival;
+        int delta;
+    };
+    std::vector<int> owner_;                      // station -> worker, parallel runs only
+    std::vector<std::vector<LoadMessage>> outboxes_;
+};
+
+// FNV-1a over every station's results, to compare runs
+uint64_t desDigest(const DesSimulation& sim) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    auto mix = [&](uint64_t v) {
+        for (int i = 0; i < 8; i++) {
+            h ^= (v >> (8 * i)) & 0xFF;
+            h *= 0x100000001b3ULL;
+        }
+    };
+    for (size_t s = 0; s < sim.numStations(); s++) {
+        const DesStationStats& st = sim.stats(s);
+        uint64_t latency_bits;
+        std::memcpy(&latency_bits, &st.latency_ms_sum, sizeof(latency_bits));
+        for (uint64_t v : {st.sent, st.carried, st.outage, st.delivered, st.reordered, st.late,
+                           st.lost, st.handoffs, st.blocked, latency_bits}) {
+            mix(v);
+        }
+    }
+    return h;
+}
+
+void printDesSummary(const DesSimulation& sim, double wall_sec, uint64_t events,
+                     double duration_sec) {
+    DesStationStats total;
+    for (size_t s = 0; s < sim.numStations(); s++) {
+        const DesStationStats& st = sim.stats(s);
+        total.sent += st.sent;
+        total.carried += st.carried;
+        total.outage += st.outage;
+        total.delivered += st.delivered;
+        total.reordered += st.reordered;
+        total.late += st.late;
+        total.lost += st.lost;
+        total.handoffs += st.handoffs;
+        total.blocked += st.blocked;
+        total.latency_ms_sum += st.latency_ms_sum;
+        total.served_sec += st.served_sec;
+        total.planned_sec += st.planned_sec;
+    }
+    double pct = total.sent > 0 ? 100.0 / total.sent : 0.0;
+    std::printf("  %.0f s simulated in %.2f s wall (%.0fx real time), %llu events, "
+                "%.2f M events/s\n",
+                duration_sec, wall_sec, duration_sec / wall_sec,
+                static_cast<unsigned long long>(events), events / wall_sec / 1e6);
+    std::printf("  handoffs %llu (%llu blocked: every visible satellite full)\n",
+                static_cast<unsigned long long>(total.handoffs),
+                static_cast<unsigned long long>(total.blocked));
+    double station_sec = duration_sec * static_cast<double>(sim.numStations());
+    std::printf("  coverage %.2f%% online", 100.0 * total.served_sec / station_sec);
+    if (sim.config().plan) {
+        std::printf(", %.2f%% planned by HandoffScheduler over the same passes (no beam limit)",
+                    100.0 * total.planned_sec / station_sec);
+    }
+    std::printf("\n");
+    std::printf("  packets: %llu sent, %llu in outage, %.2f%% delivered, %.2f%% reordered, "
+                "%.2f%% lost to timeout, %.3f%% late\n",
+                static_cast<unsigned long long>(total.sent),
+                static_cast<unsigned long long>(total.outage),
+                total.delivered * pct, total.reordered * pct, total.lost * pct,
+                total.late * pct);
+    std::printf("  mean one-way delay %.3f ms, digest %016llx\n",
+                total.carried > 0 ? total.latency_ms_sum / total.carried : 0.0,
+                static_cast<unsigned long long>(desDigest(sim)));
+}
+
+DesConfig desConfig(const Args& args) {
+    DesConfig cfg;
+    cfg.duration_sec = args.des_sec;
+    cfg.tick_sec = args.des_tick_sec;
+    cfg.packet_rate = args.des_rate;
+    cfg.drop_prob = args.drop_prob;
+    cfg.beams = args.des_beams;
+    cfg.min_elevation_deg = args.min_elevation_deg;
+    cfg.seed = args.seed;
+    cfg.plan = args.des_plan;
+    return cfg;
+}
+
+// Event counts and wall time of one run
+struct DesRun {
+    uint64_t counts[static_cast<int>(DesEventType::COUNT)] = {};
+    uint64_t windows = 0;   // parallel runs: synchronization rounds
+    double wall_sec = 0.0;
+
+    void add(const DesEngine& eng) {
+        for (int t = 0; t < static_cast<int>(DesEventType::COUNT); t++) {
+            counts[t] += eng.processed(static_cast<DesEventType>(t));
+        }
+    }
+
+    uint64_t events() const {
+        uint64_t n = 0;
+        for (uint64_t c : counts) n += c;
+        return n;
+    }
+};
+
+DesRun runDesSequential(DesSimulation& sim) {
+    DesRun run;
+    auto start = std::chrono::steady_clock::now();
+    DesEngine eng;
+    sim.seed(eng);
+    DesEvent ev;
+    while (eng.next(INFINITY, ev)) sim.handle(eng, ev);
+    run.wall_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    run.add(eng);
+    sim.finish();
+    return run;
+}
+
+// Reusable barrier; the last thread to arrive runs `serial` before
+// anyone is released
+class DesBarrier {
+public:
+    explicit DesBarrier(int parties) : parties_(parties) {}
+
+    template<typename F>
+    void wait(F&& serial) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        uint64_t generation = generation_;
+        if (++arrived_ == parties_) {
+            serial();
+            arrived_ = 0;
+            generation_++;
+            cv_.notify_all();
+            return;
+        }
+        cv_.wait(lock, [&] { return generation_ != generation; });
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    int parties_;
+    int arrived_ = 0;
+    uint64_t generation_ = 0;
+};
+
+/**
+ * Conservative parallel run. Stations are split into contiguous blocks,
+ * one event queue per worker; stations only affect each other through
+ * satellite load messages, which take at least minLinkDelaySec() to
+ * arrive. Each round every worker reports its earliest pending event
+ * that may send one (rise, set, handoff); no message sent from then on
+ * can arrive before that time plus the minimum delay, so all workers
+ * run freely up to the earliest such bound (or the next orbit tick),
+ * then meet at a barrier where the messages are handed to the load
+ * board and the tick, if due, is taken.
+ *
+ * Each station still sees its own events in (time, seq) order and the
+ * same board answers, so the results match runDesSequential bit for bit.
+ */
+DesRun runDesParallel(DesSimulation& sim, int workers) {
+    const DesConfig& cfg = sim.config();
+    const int n = static_cast<int>(sim.numStations());
+    workers = std::max(1, std::min(workers, n));
+    // A hair under the true minimum, so rounding in the slant range
+    // can never put a message inside the window that sent it
+    const double lookahead = 0.999 * DesSimulation::minLinkDelaySec();
+
+    std::vector<int> owner(n);
+    std::vector<std::vector<int>> mine(workers);
+    for (int s = 0; s < n; s++) {
+        owner[s] = static_cast<int>(static_cast<int64_t>(s) * workers / n);
+        mine[owner[s]].push_back(s);
+    }
+    sim.partition(owner, workers);
+
+    DesRun run;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<DesEngine> engines(workers);
+    for (int w = 0; w < workers; w++) {
+        for (int s : mine[w]) sim.seedStation(engines[w], s);
+    }
+
+    // Round state, written only by the barrier's serial step
+    auto tickAfter = [&](double t) {
+        return t + cfg.tick_sec < cfg.duration_sec ? t + cfg.tick_sec : INFINITY;
+    };
+    double tick = 0.0;                 // tick whose crossings this round schedules
+    bool tick_due = true;
+    double next_tick = tickAfter(0.0);
+    double window_end = 0.0;
+    bool done = false;
+    uint64_t ticks = 1;
+    sim.advanceOrbits(0.0);
+
+    auto openWindow = [&] {
+        double bound = INFINITY;
+        bool idle = true;
+        for (const auto& eng : engines) {
+            bound = std::min(bound, eng.nextMessageTime());
+            idle = idle && eng.pending() == 0;
+        }
+        window_end = std::min(next_tick, bound + lookahead);
+        done = idle && next_tick == INFINITY;
+        if (!done) run.windows++;
+    };
+    auto closeWindow = [&] {
+        sim.deliverOutboxes();
+        tick_due = next_tick != INFINITY && window_end == next_tick;
+        if (tick_due) {
+            tick = next_tick;
+            sim.advanceOrbits(tick);
+            sim.settleBoard(tick);
+            next_tick = tickAfter(tick);
+            ticks++;
+        }
+    };
+
+    DesBarrier barrier(workers);
+    auto work = [&](int w) {
+        DesEngine& eng = engines[w];
+        DesEvent ev;
+        for (;;) {
+            if (tick_due) {
+                for (int s : mine[w]) sim.scheduleCrossings(eng, s, tick);
+            }
+            barrier.wait(openWindow);
+            if (done) break;
+            while (eng.next(window_end, ev)) sim.handleStation(eng, ev);
+            barrier.wait(closeWindow);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int w = 1; w < workers; w++) threads.emplace_back(work, w);
+    work(0);
+    for (auto& t : threads) t.join();
+
+    run.wall_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (const auto& eng : engines) run.add(eng);
+    run.counts[static_cast<int>(DesEventType::ORBIT_TICK)] = ticks;
+    sim.finish();
+    return run;
+}
+
+void printDesRun(const DesSimulation& sim, const DesRun& run) {
+    for (int t = 0; t < static_cast<int>(DesEventType::COUNT); t++) {
+        std::printf("  %-15s %12llu\n", DES_EVENT_NAMES[t],
+                    static_cast<unsigned long long>(run.counts[t]));
+    }
+    if (run.windows > 0) {
+        std::printf("  %llu windows, %.1f events per window\n",
+                    static_cast<unsigned long long>(run.windows),
+                    static_cast<double>(run.events()) / run.windows);
+    }
+    printDesSummary(sim, run.wall_sec, run.events(), sim.config().duration_sec);
+}
+
+int runDes(const Args& args) {
+    DesConfig cfg = desConfig(args);
+    auto stations = latticeStations(args.des_stations);
+    DesSimulation sim(cfg, stations);
+    std::printf("Discrete-event run: %.0f s, %zu satellites, %zu stations, "
+                "%.0f packets/s each, %d beams per satellite\n",
+                cfg.duration_sec, sim.numSatellites(), sim.numStations(),
+                cfg.packet_rate, cfg.beams);
+
+    if (args.des_workers == 0) {
+        PerfPhase perf_run("des sequential");
+        DesRun run = runDesSequential(sim);
+        perf_run.setItems(run.events());
+        perf_run.stop();
+        printDesRun(sim, run);
         return 0;
     }
 
+    std::printf("Conservative parallel: %d workers, lookahead %.3f ms\n",
+                args.des_workers, DesSimulation::minLinkDelaySec() * 1e3);
+    PerfPhase perf_parallel("des parallel");
+    DesRun run = runDesParallel(sim, args.des_workers);
+    perf_parallel.setItems(run.events());
+    perf_parallel.stop();
+    printDesRun(sim, run);
+    if (!args.des_compare) return 0;
+
+    DesSimulation reference(cfg, stations);
+    PerfPhase perf_seq("des sequential");
+    DesRun seq = runDesSequential(reference);
+    perf_seq.setItems(seq.events());
+    perf_seq.stop();
+    uint64_t expected = desDigest(reference), got = desDigest(sim);
+    std::printf("Sequential engine: %.2f s wall, digest %016llx -> %s (parallel %.2fx)\n",
+                seq.wall_sec, static_cast<unsigned long long>(expected),
+                expected == got && seq.events() == run.events() ? "identical" : "MISMATCH",
+                seq.wall_sec / run.wall_sec);
+    return expected == got && seq.events() == run.events() ? 0 : 1;
+}
+
+// ============================================================
+// Main
+// ============================================================
+// The default mode: globe, packet and handoff data for the web visualizer
+int generateData(const Args& args) {
     std::cout << "Generating visualizer data...\n";
 
     // ---- 3D Globe: Full multi-shell constellation ----
-    std::vector<OrbitalShell> shells = {
-        {"Gen1 Main",   72, 22, 550.0, 53.0},
-        {"Gen1 Backup", 72, 22, 540.0, 53.2},
-        {"Polar",       36, 20, 570.0, 70.0},
-        {"SSO",          6, 58, 560.0, 97.6},
-        {"Gen2",       120, 45, 525.0, 53.0},
-    };
-    auto globe_sats = generateFullConstellation(shells);
+    std::vector<OrbitalShell> shells = starlinkShells();
+    PerfPhase perf_constellation("constellation", starlinkSatelliteCount());
+    auto globe_sats = args.trig == "poly" ? generateStarlinkShells<PolyTrig>()
+                                          : generateStarlinkShells<LibmTrig>();
     auto isl_links = computeIntraPlaneLinks(globe_sats, shells);
     auto stations = generateGroundStations(args.num_stations);
+    perf_constellation.stop();
 
     // Compute visibility edges (ground station <-> satellite)
     VisibilityStats vis_stats;
-    auto vis_edges = buildVisibilityEdges(
-        globe_sats, stations, args.min_elevation_deg, vis_stats);
+    FastVisibilityStats fast_stats;
+    PerfPhase perf_visibility("visibility", globe_sats.size() * stations.size());
+    auto vis_edges = args.precision == "double"
+        ? buildVisibilityEdges(globe_sats, stations, args.min_elevation_deg, vis_stats)
+        : buildVisibilityEdgesFast(globe_sats, stations, args.min_elevation_deg,
+                                   vis_stats, fast_stats);
+    perf_visibility.stop();
 
     std::cout << "  Globe: " << globe_sats.size() << " satellites, "
               << isl_links.size() << " ISL links, "
               << vis_edges.size() << " visibility edges, "
               << shells.size() << " shells\n";
+    // A check, not a data run: data.js is left as it is
+    if (args.verify_geometry) {
+        return verifyGeometry(globe_sats, stations, args.min_elevation_deg);
+    }
 
+    PerfPhase perf_globe("globe json", globe_sats.size());
     auto globe_json = buildGlobeJson(
         shells, globe_sats, isl_links, stations, vis_edges, vis_stats);
+    perf_globe.stop();
 
     // ---- Packet router (unchanged) ----
-    auto packet_stats = simulatePacketStream(
-        args.num_packets, args.num_queues, args.reorder_prob,
-        args.drop_prob, args.seed);
+    const bool philox = args.rng == "philox";
+    PerfPhase perf_packets("packet sim", args.num_packets);
+    auto packet_stats = philox
+        ? simulatePacketStreamParallel(args.num_packets, args.num_queues,
+                                       args.reorder_prob, args.drop_prob,
+                                       args.seed, args.threads)
+        : simulatePacketStream(args.num_packets, args.num_queues,
+                               args.reorder_prob, args.drop_prob, args.seed);
     auto packet_json = buildPacketJson(packet_stats);
+    perf_packets.stop();
 
     // ---- Handoff scheduler (unchanged) ----
-    auto windows = generateWindows(
-        args.num_handoff_sats, args.handoff_time_sec, args.seed + 1);
-    auto handoff_result = HandoffScheduler::schedule(windows);
+    PerfPhase perf_handoff("handoff", args.num_handoff_sats);
+    auto windows = philox
+        ? generateWindowsParallel(args.num_handoff_sats, args.handoff_time_sec,
+                                  args.seed + 1, args.threads)
+        : generateWindows(args.num_handoff_sats, args.handoff_time_sec, args.seed + 1);
+    auto handoff_result = HandoffScheduler::schedule(windows, args.handoff_time_sec);
     auto handoff_json = buildHandoffJson(args, windows, handoff_result);
+    perf_handoff.stop();
+    if (philox) {
+        // Digests to compare runs with different --threads
+        std::printf("  Philox, %d threads: packet digest %016llx, window digest %016llx\n",
+                    args.threads,
+                    static_cast<unsigned long long>(std::hash<std::string>{}(packet_json)),
+                    static_cast<unsigned long long>(std::hash<std::string>{}(handoff_json)));
+    }
 
     // ---- Write output ----
     std::filesystem::path out_dir = VISUALIZER_DATA_DIR;
     std::filesystem::create_directories(out_dir);
     std::filesystem::path out_path = out_dir / "data.js";
 
+    PerfPhase perf_write("write");
     std::ofstream out(out_path);
     if (!out) {
         std::cerr << "Failed to write data to " << out_path << "\n";
@@ -1065,7 +3681,36 @@ int main(int argc, char** argv) {
     out << "window.PACKET_DATA=" << packet_json << ";\n";
     out << "window.HANDOFF_DATA=" << handoff_json << ";\n";
     out.close();
+    perf_write.setItems(globe_json.size() + packet_json.size() + handoff_json.size());
+    perf_write.stop();
 
     std::cout << "Wrote " << out_path << "\n";
     return 0;
 }
+
+int main(int argc, char** argv) {
+    Args args;
+    if (!parseArgs(argc, argv, args)) {
+        return 0;
+    }
+
+    if (args.perf) PerfReport::instance().enable();
+    if (args.alloc) PerfReport::instance().enableAlloc();
+    int rc;
+    if (args.mc_trials > 0) {
+        rc = runMonteCarlo(args);
+    } else if (args.des_sec > 0) {
+        rc = runDes(args);
+    } else if (args.topk_stations > 0) {
+        rc = benchTopK(args);
+    } else if (args.horizon_stations > 0) {
+        rc = benchHorizon(args);
+    } else if (args.bench_constellation) {
+        rc = args.trig == "poly" ? benchConstellation<PolyTrig>()
+                                 : benchConstellation<LibmTrig>();
+    } else {
+        rc = generateData(args);
+    }
+    PerfReport::instance().print();
+    return rc;
+}
@@ -3,51 +3,3136 @@
  * Simple test harness — no external dependencies needed.
  */
 
+// Release builds define NDEBUG; these asserts are the test.
+#undef NDEBUG
+
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
 #include <vector>
 
-// Pull in declarations from main (in production you'd have headers)
-constexpr double EARTH_RADIUS_KM = 6371.0;
-constexpr double DEG_TO_RAD = M_PI / 180.0;
-constexpr double RAD_TO_DEG = 180.0 / M_PI;
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Pull in declarations from main (in production you'd have headers)
+constexpr double EARTH_RADIUS_KM = 6371.0;
+constexpr double DEG_TO_RAD = M_PI / 180.0;
+constexpr double RAD_TO_DEG = 180.0 / M_PI;
+
+// Trig kernels, as in main.cpp
+struct LibmTrig {
+    template<typename T> static T sin(T x) { return std::sin(x); }
+    template<typename T> static T cos(T x) { return std::cos(x); }
+    template<typename T> static T asin(T x) { return std::asin(x); }
+    template<typename T> static T acos(T x) { return std::acos(x); }
+    template<typename T> static T atan2(T y, T x) { return std::atan2(y, x); }
+};
+
+struct PolyTrig {
+    static double sin(double x) { return sinCosQuadrant(x, 0); }
+    static double cos(double x) { return sinCosQuadrant(x, 1); }
+
+    static double asin(double x) {
+        double a = std::abs(x);
+        bool small = a <= 0.5;
+        double z = small ? a * a : (1.0 - a) * 0.5;
+        double s = small ? a : std::sqrt(z);
+        double p = s + s * z * asinPoly(z);
+        double r = small ? p : PIO2_HI - (2.0 * p - PIO2_LO);
+        return std::copysign(r, x);
+    }
+
+    static double acos(double x) {
+        double a = std::abs(x);
+        bool small = a <= 0.5;
+        double z = small ? x * x : (1.0 - a) * 0.5;
+        double s = small ? x : std::sqrt(z);
+        double p = s + s * z * asinPoly(z);
+        if (small) return PIO2_HI - (p - PIO2_LO);
+        return x > 0 ? 2.0 * p : PI_HI - (2.0 * p - PI_LO);
+    }
+
+    static double atan2(double y, double x) {
+        double ax = std::abs(x), ay = std::abs(y);
+        double hi = std::max(ax, ay), lo = std::min(ax, ay);
+        double t = hi > 0 ? lo / hi : 0.0;                     // [0, 1]
+        bool fold = t > TAN_PI_12;
+        double u = fold ? (t * SQRT3 - 1.0) / (t + SQRT3) : t;  // |u| <= tan(pi/12)
+        double w = u * u;
+        double r = u + u * w * atanPoly(w) + (fold ? PI_6 : 0.0);
+        r = ay > ax ? PIO2_HI - r + PIO2_LO : r;
+        r = x < 0 ? PI_HI - r + PI_LO : r;
+        return std::copysign(r, y);
+    }
+
+private:
+    static constexpr double PIO2_HI = 1.57079632679489655800e+00;
+    static constexpr double PIO2_LO = 6.12323399573676588613e-17;
+    static constexpr double PI_HI = 3.14159265358979311600e+00;
+    static constexpr double PI_LO = 1.22464679914735317720e-16;
+    static constexpr double PI_6 = 5.23598775598298815658e-01;
+    static constexpr double SQRT3 = 1.73205080756887719318e+00;
+    static constexpr double TAN_PI_12 = 2.67949192431122706473e-01;
+
+    // x = k pi/2 + r, then the quadrant picks sin/cos and sign
+    static double sinCosQuadrant(double x, int shift) {
+        constexpr double TWO_OVER_PI = 6.36619772367581382433e-01;
+        constexpr double PIO2_1 = 1.57079632673412561417e+00;   // first 33 bits
+        constexpr double PIO2_2 = 6.07710050630396597660e-11;   // next 33 bits
+        constexpr double PIO2_3 = 2.02226624871116645580e-21;   // tail
+        constexpr double ROUND = 6755399441055744.0;            // 1.5 * 2^52
+        double k = (x * TWO_OVER_PI + ROUND) - ROUND;
+        double r = ((x - k * PIO2_1) - k * PIO2_2) - k * PIO2_3;
+        int q = static_cast<int>(static_cast<int64_t>(k)) + shift;
+        double z = r * r;
+        double s = r + r * z * (-1.66666666666666307295e-1 + z * (8.33333333332211858878e-3 +
+                   z * (-1.98412698295895385996e-4 + z * (2.75573136213857245213e-6 +
+                   z * (-2.50507477628578072866e-8 + z * 1.58962301576546568060e-10)))));
+        double c = 1.0 - 0.5 * z + z * z * (4.16666666666665929218e-2 +
+                   z * (-1.38888888888730564116e-3 + z * (2.48015872888517045348e-5 +
+                   z * (-2.75573141792967388112e-7 + z * (2.08757008419747316778e-9 +
+                   z * -1.13585365213876817300e-11)))));
+        double v = (q & 1) ? c : s;
+        return (q & 2) ? -v : v;
+    }
+
+    // (asin(sqrt z) - sqrt z) / z^1.5 on [0, 0.25]
+    static double asinPoly(double z) {
+        return 0.16666666666666646 + z * (0.075000000000232631 + z * (0.044642857099408392 +
+               z * (0.030381947618578847 + z * (0.022372039558540002 +
+               z * (0.017355411078687454 + z * (0.013927890026116782 +
+               z * (0.011888696520972233 + z * (0.0077394544038220806 +
+               z * (0.016225090021533179 + z * (-0.01106884778146988 +
+               z * 0.028402137158083294))))))))));
+    }
+
+    // (atan(sqrt w) - sqrt w) / w^1.5 on [0, tan²(pi/12)]
+    static double atanPoly(double w) {
+        return -0.33333333333333248 + w * (0.19999999999846665 + w * (-0.14285714240489927 +
+               w * (0.11111106023348163 + w * (-0.090906272982633721 +
+               w * (0.076837908710856925 + w * (-0.065226117213869617 +
+               w * 0.04580788442090232))))));
+    }
+};
+
+struct GeoCoord {
+    double lat_deg;
+    double lon_deg;
+};
+
+template<typename Trig = LibmTrig>
+double haversineDistanceKm(const GeoCoord& a, const GeoCoord& b) {
+    double dlat = (b.lat_deg - a.lat_deg) * DEG_TO_RAD;
+    double dlon = (b.lon_deg - a.lon_deg) * DEG_TO_RAD;
+    double lat1 = a.lat_deg * DEG_TO_RAD;
+    double lat2 = b.lat_deg * DEG_TO_RAD;
+    double h = Trig::sin(dlat / 2) * Trig::sin(dlat / 2) +
+               Trig::cos(lat1) * Trig::cos(lat2) *
+               Trig::sin(dlon / 2) * Trig::sin(dlon / 2);
+    double c = 2 * Trig::asin(std::sqrt(h));
+    return EARTH_RADIUS_KM * c;
+}
+
+template<typename Trig = LibmTrig>
+double computeElevationAngle(const GeoCoord& station, const GeoCoord& sat_pos,
+                              double sat_altitude_km) {
+    double ground_dist_km = haversineDistanceKm<Trig>(station, sat_pos);
+    double central_angle = ground_dist_km / EARTH_RADIUS_KM;
+    double r_sat = EARTH_RADIUS_KM + sat_altitude_km;
+    double slant_range = std::sqrt(
+        EARTH_RADIUS_KM * EARTH_RADIUS_KM +
+        r_sat * r_sat -
+        2 * EARTH_RADIUS_KM * r_sat * Trig::cos(central_angle));
+    if (slant_range < 1e-6) return 90.0;
+    double cos_elevation = (slant_range * slant_range +
+                            EARTH_RADIUS_KM * EARTH_RADIUS_KM -
+                            r_sat * r_sat) /
+                           (2 * slant_range * EARTH_RADIUS_KM);
+    double angle_at_station = Trig::acos(std::clamp(cos_elevation, -1.0, 1.0));
+    return (angle_at_station * RAD_TO_DEG) - 90.0;
+}
+
+// ============================================================
+// FEC, as in packet_router.cpp
+// ============================================================
+
+using Clock = std::chrono::steady_clock;
+using TimePoint = Clock::time_point;
+
+enum class Priority : uint8_t { REAL_TIME = 0, STREAMING = 1, BULK = 2, CONTROL = 3 };
+
+struct Packet {
+    uint64_t sequence_number;
+    Priority priority;
+    uint32_t source_satellite_id;
+    uint32_t destination_id;
+    TimePoint arrival_time;
+    std::vector<uint8_t> payload;
+    TimePoint enqueue_time{};  // stamped by PriorityRouter::route (AQM sojourn)
+    int16_t fec_parity_index = -1;  // >= 0: FEC parity, sequence_number = block
+    uint8_t fec_block_size = 0;     // parity: data packets in its block
+    TimePoint deadline{};           // EDF classes: arrival_time + class budget
+};
+
+enum class FecMode : uint8_t { NONE, XOR, REED_SOLOMON };
+
+struct FecConfig {
+    FecMode mode = FecMode::NONE;
+    int k = 8;                  // data packets per block (<= 64)
+    int m = 2;                  // Reed-Solomon parity packets per block
+    int max_blocks_in_flight = 64;
+
+    int parityPerBlock() const {
+        return mode == FecMode::XOR ? 1 : mode == FecMode::REED_SOLOMON ? m : 0;
+    }
+};
+
+// GF(2^8) arithmetic with the 0x11d polynomial. The full 64 KiB product
+// table turns region multiply-accumulate into one lookup per byte, and
+// each coefficient's 256-byte row stays resident in L1.
+class GF256 {
+public:
+    static const GF256& get() {
+        static const GF256 instance;
+        return instance;
+    }
+
+    uint8_t mul(uint8_t a, uint8_t b) const { return mul_[a][b]; }
+    uint8_t inv(uint8_t a) const { return inv_[a]; }
+    const uint8_t* row(uint8_t c) const { return mul_[c]; }
+
+private:
+    GF256() {
+        uint8_t exp[512];
+        uint8_t log[256] = {};
+        int x = 1;
+        for (int i = 0; i < 255; i++) {
+            exp[i] = static_cast<uint8_t>(x);
+            log[x] = static_cast<uint8_t>(i);
+            x <<= 1;
+            if (x & 0x100) x ^= 0x11d;
+        }
+        for (int i = 255; i < 512; i++) exp[i] = exp[i - 255];
+        for (int a = 0; a < 256; a++) {
+            for (int b = 0; b < 256; b++) {
+                mul_[a][b] = (a && b) ? exp[log[a] + log[b]] : 0;
+            }
+            inv_[a] = a ? exp[255 - log[a]] : 0;
+        }
+    }
+
+    uint8_t mul_[256][256];
+    uint8_t inv_[256];
+};
+
+// dst ^= src
+inline void xorRegion(uint8_t* dst, const uint8_t* src, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] ^= src[i];
+}
+
+// dst ^= c * src over GF(256)
+inline void mulAddRegion(uint8_t* dst, const uint8_t* src, uint8_t c, size_t n) {
+    if (c == 0) return;
+    if (c == 1) {
+        xorRegion(dst, src, n);
+        return;
+    }
+    const uint8_t* row = GF256::get().row(c);
+    for (size_t i = 0; i < n; i++) dst[i] ^= row[src[i]];
+}
+
+class FecCodec {
+public:
+    static constexpr size_t SYMBOL_HEADER = 11;
+
+    explicit FecCodec(const FecConfig& cfg) : cfg_(cfg) {}
+
+    // Cauchy coefficient for parity row j, data column i: any k rows of
+    // [I; C] are invertible, so any k received symbols decode the block
+    uint8_t coefficient(int j, int i) const {
+        return GF256::get().inv(static_cast<uint8_t>((cfg_.k + j) ^ i));
+    }
+
+    static size_t symbolSize(const Packet& pkt) {
+        return SYMBOL_HEADER + pkt.payload.size();
+    }
+
+    static void writeHeader(const Packet& pkt, uint8_t* out) {
+        uint16_t len = static_cast<uint16_t>(pkt.payload.size());
+        out[0] = static_cast<uint8_t>(len);
+        out[1] = static_cast<uint8_t>(len >> 8);
+        out[2] = static_cast<uint8_t>(pkt.priority);
+        std::memcpy(out + 3, &pkt.source_satellite_id, 4);
+        std::memcpy(out + 7, &pkt.destination_id, 4);
+    }
+
+    // Rebuild the descriptor and payload of data packet `seq` from a symbol
+    static Packet fromSymbol(uint64_t seq, const uint8_t* sym, TimePoint now) {
+        Packet pkt;
+        size_t len = sym[0] | (static_cast<size_t>(sym[1]) << 8);
+        pkt.sequence_number = seq;
+        pkt.priority = static_cast<Priority>(sym[2] & 3);
+        std::memcpy(&pkt.source_satellite_id, sym + 3, 4);
+        std::memcpy(&pkt.destination_id, sym + 7, 4);
+        pkt.arrival_time = now;
+        pkt.payload.assign(sym + SYMBOL_HEADER, sym + SYMBOL_HEADER + len);
+        return pkt;
+    }
+
+    // dst ^= c * symbol(pkt), without materializing the symbol
+    static void accumulate(uint8_t* dst, const Packet& pkt, uint8_t c) {
+        uint8_t header[SYMBOL_HEADER];
+        writeHeader(pkt, header);
+        mulAddRegion(dst, header, c, SYMBOL_HEADER);
+        mulAddRegion(dst + SYMBOL_HEADER, pkt.payload.data(), c,
+                     pkt.payload.size());
+    }
+
+protected:
+    FecConfig cfg_;
+};
+
+class FecEncoder : public FecCodec {
+public:
+    using FecCodec::FecCodec;
+
+    /**
+     * Parity packets for one block of k data packets (ordered by sequence).
+     * Parity reuses sequence_number as the block id and is marked with
+     * fec_parity_index >= 0; fec_block_size carries the block's data
+     * count, since the last block of a stream may hold fewer than k.
+     */
+    std::vector<Packet> encodeBlock(uint64_t block,
+                                    const std::vector<const Packet*>& data) const {
+        size_t len = 0;
+        for (const Packet* pkt : data) len = std::max(len, symbolSize(*pkt));
+
+        std::vector<Packet> parity;
+        for (int j = 0; j < cfg_.parityPerBlock(); j++) {
+            Packet p;
+            p.sequence_number = block;
+            p.priority = Priority::CONTROL;
+            p.source_satellite_id = 0;
+            p.destination_id = 0;
+            p.arrival_time = Clock::now();
+            p.payload.assign(len, 0);
+            p.fec_parity_index = static_cast<int16_t>(j);
+            p.fec_block_size = static_cast<uint8_t>(data.size());
+            for (size_t i = 0; i < data.size(); i++) {
+                uint8_t c = cfg_.mode == FecMode::XOR
+                                ? 1 : coefficient(j, static_cast<int>(i));
+                accumulate(p.payload.data(), *data[i], c);
+            }
+            parity.push_back(std::move(p));
+        }
+        return parity;
+    }
+};
+
+struct FecStats {
+    uint64_t data_received = 0;
+    uint64_t parity_received = 0;
+    uint64_t recovered = 0;        // data packets rebuilt from parity
+    uint64_t rebuilt_early = 0;    // ...whose original arrived afterwards
+    uint64_t duplicates = 0;       // same data packet received twice
+    uint64_t unrecoverable = 0;    // data packets lost beyond repair
+
+    // Rebuilt packets whose original never showed up: losses repaired,
+    // as opposed to reordered packets that were merely rebuilt early
+    uint64_t repaired() const { return recovered - rebuilt_early; }
+};
+
+class FecDecoder : public FecCodec {
+public:
+    using FecCodec::FecCodec;
+
+    /**
+     * Feed one arriving packet; appends everything now deliverable to
+     * `out`: the packet itself if it is data, plus any packets of its
+     * block that just became recoverable. Parity is consumed here.
+     */
+    void receive(Packet&& pkt, std::vector<Packet>& out) {
+        bool parity = pkt.fec_parity_index >= 0;
+        uint64_t block_id = parity ? pkt.sequence_number
+                                   : pkt.sequence_number / cfg_.k;
+        if (block_id + cfg_.max_blocks_in_flight <= newest_block_) {
+            // Block already retired: deliver late data, drop late parity
+            if (!parity) out.push_back(std::move(pkt));
+            return;
+        }
+        if (block_id > newest_block_) retireBefore(block_id);
+
+        Block& block = blocks_[block_id];
+        if (parity) {
+            stats_.parity_received++;
+            if (block.done) return;
+            addParity(block, std::move(pkt));
+        } else {
+            stats_.data_received++;
+            uint64_t bit = 1ULL << (pkt.sequence_number % cfg_.k);
+            if (block.recovered & bit) {
+                block.recovered &= ~bit;
+                stats_.rebuilt_early++;
+                return;
+            }
+            if (block.delivered & bit) {
+                stats_.duplicates++;
+                return;
+            }
+            block.delivered |= bit;
+            if (!block.done) addData(block, pkt);
+            out.push_back(std::move(pkt));
+        }
+        if (!block.done) tryRecover(block_id, block, out);
+    }
+
+    const FecStats& stats() const { return stats_; }
+
+    /**
+     * End of stream: account for blocks that never became decodable.
+     * `data_packets` bounds a last block whose parity never arrived, so
+     * its empty tail slots are not counted as losses.
+     */
+    void finish(uint64_t data_packets = UINT64_MAX) {
+        if (data_packets != UINT64_MAX && data_packets % cfg_.k != 0) {
+            auto it = blocks_.find(data_packets / cfg_.k);
+            if (it != blocks_.end() && it->second.size == 0) {
+                it->second.size = static_cast<int>(data_packets % cfg_.k);
+            }
+        }
+        retireBefore(UINT64_MAX);
+    }
+
+private:
+    struct Block {
+        uint64_t delivered = 0;   // bitmask of data indices handed on
+        uint64_t recovered = 0;   // ...of which rebuilt from parity
+        int size = 0;             // data packets in the block, 0 = k
+        int data_count = 0;
+        bool done = false;
+        // XOR: running XOR of every symbol received so far
+        std::vector<uint8_t> acc;
+        bool have_parity = false;
+        // Reed-Solomon: received symbols kept until the block decodes
+        std::vector<std::vector<uint8_t>> data_syms;
+        std::vector<std::vector<uint8_t>> parity_syms;
+        int parity_count = 0;
+    };
+
+    void addData(Block& block, const Packet& pkt) {
+        block.data_count++;
+        size_t len = symbolSize(pkt);
+        if (cfg_.mode == FecMode::XOR) {
+            if (block.acc.size() < len) block.acc.resize(len, 0);
+            accumulate(block.acc.data(), pkt, 1);
+        } else {
+            if (block.data_syms.empty()) block.data_syms.resize(cfg_.k);
+            auto& sym = block.data_syms[pkt.sequence_number % cfg_.k];
+            sym.resize(len);
+            writeHeader(pkt, sym.data());
+            std::memcpy(sym.data() + SYMBOL_HEADER, pkt.payload.data(),
+                        pkt.payload.size());
+        }
+        if (block.data_count == slots(block)) release(block);
+    }
+
+    void addParity(Block& block, Packet&& pkt) {
+        if (pkt.fec_block_size > 0 && pkt.fec_block_size < cfg_.k) {
+            block.size = pkt.fec_block_size;
+        }
+        if (cfg_.mode == FecMode::XOR) {
+            if (block.acc.size() < pkt.payload.size()) {
+                block.acc.resize(pkt.payload.size(), 0);
+            }
+            xorRegion(block.acc.data(), pkt.payload.data(), pkt.payload.size());
+            block.have_parity = true;
+        } else {
+            if (block.parity_syms.empty()) block.parity_syms.resize(cfg_.m);
+            auto& sym = block.parity_syms[pkt.fec_parity_index];
+            if (sym.empty()) block.parity_count++;
+            sym = std::move(pkt.payload);
+        }
+    }
+
+    void tryRecover(uint64_t block_id, Block& block, std::vector<Packet>& out) {
+        int missing = slots(block) - block.data_count;
+        if (missing <= 0) {
+            // Short last block, complete once its parity gave the size
+            release(block);
+            return;
+        }
+        TimePoint now = Clock::now();
+        uint64_t base = block_id * cfg_.k;
+
+        if (cfg_.mode == FecMode::XOR) {
+            if (missing != 1 || !block.have_parity) return;
+            int i = missingIndices(block)[0];
+            deliverRecovered(block, base + i, block.acc.data(), now, out);
+            release(block);
+            return;
+        }
+
+        if (block.parity_count < missing) return;
+        std::vector<int> lost = missingIndices(block);
+        std::vector<int> rows;
+        for (int j = 0; j < cfg_.m && static_cast<int>(rows.size()) < missing; j++) {
+            if (!block.parity_syms[j].empty()) rows.push_back(j);
+        }
+
+        // rhs_r = parity_r - sum over received data of C[r][i] * data_i
+        size_t len = block.parity_syms[rows[0]].size();
+        std::vector<std::vector<uint8_t>> rhs;
+        for (int r : rows) {
+            std::vector<uint8_t> v = block.parity_syms[r];
+            for (int i = 0; i < static_cast<int>(block.data_syms.size()); i++) {
+                const auto& sym = block.data_syms[i];
+                if (sym.empty()) continue;
+                mulAddRegion(v.data(), sym.data(), coefficient(r, i), sym.size());
+            }
+            rhs.push_back(std::move(v));
+        }
+
+        // Solve A x = rhs with A[r][c] = C[rows[r]][lost[c]]
+        auto inv = invert(rows, lost);
+        std::vector<uint8_t> sym(len);
+        for (int c = 0; c < missing; c++) {
+            std::fill(sym.begin(), sym.end(), 0);
+            for (int r = 0; r < missing; r++) {
+                mulAddRegion(sym.data(), rhs[r].data(), inv[c][r], len);
+            }
+            deliverRecovered(block, base + lost[c], sym.data(), now, out);
+        }
+        release(block);
+    }
+
+    void deliverRecovered(Block& block, uint64_t seq, const uint8_t* sym,
+                          TimePoint now, std::vector<Packet>& out) {
+        block.delivered |= 1ULL << (seq % cfg_.k);
+        block.recovered |= 1ULL << (seq % cfg_.k);
+        stats_.recovered++;
+        out.push_back(fromSymbol(seq, sym, now));
+    }
+
+    // Data slots in the block; only the stream's last block is short
+    int slots(const Block& block) const {
+        return block.size ? block.size : cfg_.k;
+    }
+
+    std::vector<int> missingIndices(const Block& block) const {
+        std::vector<int> lost;
+        for (int i = 0; i < slots(block); i++) {
+            if (!(block.delivered & (1ULL << i))) lost.push_back(i);
+        }
+        return lost;
+    }
+
+    // Gauss-Jordan inverse of the Cauchy submatrix over GF(256)
+    std::vector<std::vector<uint8_t>> invert(const std::vector<int>& rows,
+                                             const std::vector<int>& cols) const {
+        const GF256& gf = GF256::get();
+        int n = static_cast<int>(rows.size());
+        std::vector<std::vector<uint8_t>> a(n, std::vector<uint8_t>(2 * n, 0));
+        for (int r = 0; r < n; r++) {
+            for (int c = 0; c < n; c++) a[r][c] = coefficient(rows[r], cols[c]);
+            a[r][n + r] = 1;
+        }
+        for (int col = 0; col < n; col++) {
+            int pivot = col;
+            while (a[pivot][col] == 0) pivot++;  // Cauchy: always found
+            std::swap(a[pivot], a[col]);
+            uint8_t scale = gf.inv(a[col][col]);
+            for (auto& v : a[col]) v = gf.mul(v, scale);
+            for (int r = 0; r < n; r++) {
+                if (r == col || a[r][col] == 0) continue;
+                uint8_t f = a[r][col];
+                for (int c = 0; c < 2 * n; c++) a[r][c] ^= gf.mul(f, a[col][c]);
+            }
+        }
+        std::vector<std::vector<uint8_t>> inv(n, std::vector<uint8_t>(n));
+        for (int r = 0; r < n; r++) {
+            for (int c = 0; c < n; c++) inv[r][c] = a[r][n + c];
+        }
+        return inv;
+    }
+
+    // Block is complete (or decoded): drop symbol memory, keep the bitmask
+    void release(Block& block) {
+        block.done = true;
+        block.acc = {};
+        block.data_syms = {};
+        block.parity_syms = {};
+    }
+
+    void retireBefore(uint64_t block_id) {
+        newest_block_ = block_id == UINT64_MAX ? newest_block_ : block_id;
+        uint64_t horizon = block_id == UINT64_MAX
+            ? UINT64_MAX
+            : (block_id >= static_cast<uint64_t>(cfg_.max_blocks_in_flight)
+                   ? block_id - cfg_.max_blocks_in_flight + 1 : 0);
+        while (!blocks_.empty() && blocks_.begin()->first < horizon) {
+            const Block& b = blocks_.begin()->second;
+            if (!b.done) {
+                stats_.unrecoverable +=
+                    slots(b) - __builtin_popcountll(b.delivered);
+            }
+            blocks_.erase(blocks_.begin());
+        }
+    }
+
+    std::map<uint64_t, Block> blocks_;
+    uint64_t newest_block_ = 0;
+    FecStats stats_;
+};
+
+// ============================================================
+// Handoff scheduling, as in handoff_scheduler.cpp
+// ============================================================
+
+struct VisibilityWindow {
+    int satellite_id;
+    double start_time;       // seconds from epoch
+    double end_time;         // seconds from epoch
+    double peak_signal_quality;  // dB SNR at best point
+    double start_signal_quality; // dB SNR at window start (rising)
+    double end_signal_quality;   // dB SNR at window end (falling)
+
+    double duration() const { return end_time - start_time; }
+
+    // Signal quality at a given time (parabolic model)
+    double signalAt(double t) const {
+        if (t < start_time || t > end_time) return 0.0;
+        double mid = (start_time + end_time) / 2.0;
+        double half_dur = (end_time - start_time) / 2.0;
+        double normalized = (t - mid) / half_dur;  // -1 to 1
+        // Parabolic: peak at center, falls to start/end values
+        return peak_signal_quality * (1.0 - 0.3 * normalized * normalized);
+    }
+};
+
+struct HandoffDecision {
+    int from_satellite;
+    int to_satellite;
+    double handoff_time;        // when to switch
+    double overlap_duration;    // seconds of simultaneous coverage
+    double signal_at_handoff;   // signal quality during transition
+};
+
+struct ScheduleResult {
+    std::vector<HandoffDecision> handoffs;
+    double min_signal_quality;    // worst signal during any transition
+    double total_coverage_time;   // total time with service
+    double total_gap_time;        // total time without service
+    int num_handoffs;
+};
+
+class HandoffScheduler {
+public:
+    static constexpr double MIN_OVERLAP_SEC = 2.0;   // Starlink target
+    static constexpr double MIN_SIGNAL_DB = 5.0;      // Minimum usable signal
+    static constexpr double HANDOFF_MARGIN_SEC = 1.0;  // Safety margin
+
+    /**
+     * Schedule handoffs for a set of visibility windows.
+     *
+     * Algorithm:
+     *   1. Sort windows by start time
+     *   2. For each window, find compatible next windows (sufficient overlap)
+     *   3. Use DP to find the chain covering the longest span, breaking
+     *      ties by the best minimum signal quality
+     *   4. Backtrack to extract the optimal schedule
+     *
+     * Coverage comes first: ranking by minimum signal alone always picks
+     * the single strongest pass, since a handoff can never raise the
+     * minimum, and leaves the terminal dark for the rest of the horizon.
+     *
+     * Coverage and gap time are counted up to `horizon` only: the last
+     * pass usually runs on past the end of the simulated period.
+     *
+     * Time complexity: O(N² log N) where N = number of visibility windows
+     */
+    static ScheduleResult schedule(std::vector<VisibilityWindow> windows,
+                                   double horizon = INFINITY) {
+        if (windows.empty()) return {{}, 0, 0, 0, 0};
+
+        TransitionGraph graph = buildGraph(std::move(windows));
+        double min_signal = 0.0;
+        auto selected = bestChain(graph, std::vector<Busy>(graph.windows.size()),
+                                  min_signal);
+        return describeChain(graph.windows, selected, min_signal, horizon);
+    }
+
+    struct ServingSegment {
+        int satellite_id;
+        double start_time;
+        double end_time;
+    };
+
+    /**
+     * The primary chain plus up to k-1 alternates, each flattened into the
+     * satellite that serves each instant.
+     */
+    struct BackupSchedule {
+        std::vector<ScheduleResult> chains;               // [0] = primary
+        std::vector<std::vector<ServingSegment>> serving;  // per chain, by time
+
+        /**
+         * Failover as a lookup: the first chain whose satellite at time t
+         * is not the failed one. Returns nullptr if no chain covers t.
+         */
+        const ServingSegment* failover(int failed_satellite, double t) const {
+            for (const auto& segments : serving) {
+                auto it = std::upper_bound(
+                    segments.begin(), segments.end(), t,
+                    [](double v, const ServingSegment& s) { return v < s.start_time; });
+                if (it == segments.begin()) continue;
+                --it;
+                if (t <= it->end_time && it->satellite_id != failed_satellite) return &*it;
+            }
+            return nullptr;
+        }
+    };
+
+    /**
+     * Schedule a primary chain and k-1 link-disjoint alternates.
+     *
+     * Alternate r reruns the DP with each satellite excluded only while
+     * chains 0..r-1 are served by it: a pass splits into the stretches
+     * before and after those serving segments, and an alternate may use
+     * them. So at no instant does it depend on a satellite an earlier
+     * chain is using, yet it can still take over a pass the primary is
+     * about to enter or has just left.
+     * The candidate handoffs and their crossover searches — the bulk of
+     * the O(N²) work — are computed once and shared by every chain.
+     */
+    static BackupSchedule scheduleWithBackups(std::vector<VisibilityWindow> windows,
+                                              int k, double horizon = INFINITY) {
+        BackupSchedule backups;
+        if (windows.empty() || k < 1) return backups;
+
+        TransitionGraph graph = buildGraph(std::move(windows));
+        std::vector<Busy> busy(graph.windows.size());
+        for (int r = 0; r < k; r++) {
+            double min_signal = 0.0;
+            auto selected = bestChain(graph, busy, min_signal);
+            if (selected.empty()) break;
+            backups.chains.push_back(
+                describeChain(graph.windows, selected, min_signal, horizon));
+
+            const ScheduleResult& chain = backups.chains.back();
+            std::vector<ServingSegment> segments;
+            for (size_t s = 0; s < selected.size(); s++) {
+                const Piece& piece = selected[s];
+                double from = s == 0 ? piece.start_time : chain.handoffs[s - 1].handoff_time;
+                double to = s + 1 == selected.size() ? piece.end_time
+                                                     : chain.handoffs[s].handoff_time;
+                segments.push_back({graph.windows[piece.window].satellite_id, from, to});
+                Busy& b = busy[piece.window];
+                b.insert(std::upper_bound(b.begin(), b.end(), std::make_pair(from, to)),
+                         {from, to});
+            }
+            backups.serving.push_back(std::move(segments));
+        }
+        return backups;
+    }
+
+private:
+    struct Transition {
+        int from;
+        double time;    // optimal handoff time
+        double signal;  // at that time
+    };
+
+    // Per window, the (start, end) times earlier chains serve from it
+    using Busy = std::vector<std::pair<double, double>>;
+
+    // The stretch of a window a chain serves from: the whole pass unless
+    // an earlier chain is using the satellite for part of it
+    struct Piece {
+        int window;
+        double start_time;
+        double end_time;
+    };
+
+    // Windows sorted by start, and for each one the windows it can take over from
+    struct TransitionGraph {
+        std::vector<VisibilityWindow> windows;
+        std::vector<std::vector<Transition>> into;
+    };
+
+    static TransitionGraph buildGraph(std::vector<VisibilityWindow> windows) {
+        // Sort by start time
+        std::sort(windows.begin(), windows.end(),
+                  [](const auto& a, const auto& b) {
+                      return a.start_time < b.start_time;
+                  });
+
+        int n = static_cast<int>(windows.size());
+        std::vector<std::vector<Transition>> into(n);
+        for (int i = 1; i < n; i++) {
+            for (int j = 0; j < i; j++) {
+                // Check if window j can hand off to window i
+                double overlap = windows[j].end_time - windows[i].start_time;
+
+                if (overlap < MIN_OVERLAP_SEC) continue;  // Not enough overlap
+                if (windows[i].start_time >= windows[j].end_time) continue;  // No overlap
+
+                // Compute signal quality at the handoff point
+                // Optimal handoff time: maximize min(signal_j, signal_i)
+                double best_handoff_time = findOptimalHandoffTime(
+                    windows[j], windows[i]);
+
+                double signal_at_handoff = std::min(
+                    windows[j].signalAt(best_handoff_time),
+                    windows[i].signalAt(best_handoff_time));
+
+                if (signal_at_handoff < MIN_SIGNAL_DB) continue;  // Too weak
+                into[i].push_back({j, best_handoff_time, signal_at_handoff});
+            }
+        }
+        return {std::move(windows), std::move(into)};
+    }
+
+    // DP over the free pieces of every window; returns the chosen chain
+    static std::vector<Piece> bestChain(const TransitionGraph& graph,
+                                        const std::vector<Busy>& busy,
+                                        double& min_signal) {
+        const auto& windows = graph.windows;
+        int n = static_cast<int>(windows.size());
+
+        // Split each window around the times it is busy, in window order so
+        // every transition source precedes its target
+        std::vector<Piece> pieces;
+        std::vector<int> first_piece(n + 1, 0);
+        for (int i = 0; i < n; i++) {
+            first_piece[i] = static_cast<int>(pieces.size());
+            double from = windows[i].start_time;
+            for (const auto& [busy_from, busy_to] : busy[i]) {
+                if (busy_from > from) pieces.push_back({i, from, busy_from});
+                from = std::max(from, busy_to);
+            }
+            if (from < windows[i].end_time) {
+                pieces.push_back({i, from, windows[i].end_time});
+            }
+        }
+        first_piece[n] = static_cast<int>(pieces.size());
+        auto pieceAt = [&](int i, double t) {
+            for (int p = first_piece[i]; p < first_piece[i + 1]; p++) {
+                if (pieces[p].start_time <= t && t <= pieces[p].end_time) return p;
+            }
+            return -1;
+        };
+        int m = static_cast<int>(pieces.size());
+
+        // dp[p] = best minimum signal quality of the chain ending at piece p,
+        // chain_start[p] = when that chain's first piece opens
+        std::vector<double> dp(m, 0.0);
+        std::vector<double> chain_start(m, 0.0);
+        std::vector<int> parent(m, -1);
+
+        // Base case: each piece alone has its window's peak signal quality
+        for (int p = 0; p < m; p++) {
+            dp[p] = windows[pieces[p].window].peak_signal_quality;
+            chain_start[p] = pieces[p].start_time;
+        }
+
+        // DP transition: try extending from each previous window, through
+        // whichever of its pieces is free at the handoff
+        for (int q = 0; q < m; q++) {
+            const Piece& to = pieces[q];
+            for (const auto& tr : graph.into[to.window]) {
+                if (tr.time < to.start_time || tr.time > to.end_time) continue;
+                int p = pieceAt(tr.from, tr.time);
+                if (p < 0) continue;
+
+                // min_signal through this path; longer coverage wins first
+                double path_signal = std::min(dp[p], tr.signal);
+
+                if (chain_start[p] < chain_start[q] ||
+                    (chain_start[p] == chain_start[q] && path_signal > dp[q])) {
+                    dp[q] = path_signal;
+                    chain_start[q] = chain_start[p];
+                    parent[q] = p;
+                }
+            }
+        }
+
+        // Find the best ending piece: longest span, then strongest
+        int best_end = -1;
+        auto span = [&](int p) { return pieces[p].end_time - chain_start[p]; };
+        for (int p = 0; p < m; p++) {
+            if (best_end < 0 || span(p) > span(best_end) ||
+                (span(p) == span(best_end) && dp[p] > dp[best_end])) {
+                best_end = p;
+            }
+        }
+
+        // Backtrack to find the schedule
+        std::vector<Piece> selected;
+        if (best_end < 0) return selected;
+        min_signal = dp[best_end];
+        int cur = best_end;
+        while (cur != -1) {
+            selected.push_back(pieces[cur]);
+            cur = parent[cur];
+        }
+        std::reverse(selected.begin(), selected.end());
+        return selected;
+    }
+
+    static ScheduleResult describeChain(const std::vector<VisibilityWindow>& windows,
+                                        const std::vector<Piece>& selected,
+                                        double min_signal, double horizon) {
+        // Build handoff decisions
+        ScheduleResult result;
+        result.min_signal_quality = min_signal;
+        result.num_handoffs = static_cast<int>(selected.size()) - 1;
+        result.total_coverage_time = 0;
+        result.total_gap_time = 0;
+
+        for (int k = 0; k + 1 < static_cast<int>(selected.size()); k++) {
+            int j = selected[k].window;
+            int i = selected[k + 1].window;
+
+            double handoff_time = findOptimalHandoffTime(windows[j], windows[i]);
+            double overlap = windows[j].end_time - windows[i].start_time;
+
+            result.handoffs.push_back({
+                windows[j].satellite_id,
+                windows[i].satellite_id,
+                handoff_time,
+                overlap,
+                std::min(windows[j].signalAt(handoff_time),
+                         windows[i].signalAt(handoff_time))
+            });
+        }
+
+        // Coverage: each window serves from its entry handoff to its exit
+        // handoff, clipped to the horizon
+        for (size_t s = 0; s < selected.size(); s++) {
+            const Piece& piece = selected[s];
+            double from = s == 0 ? piece.start_time : result.handoffs[s - 1].handoff_time;
+            double to = s + 1 == selected.size() ? piece.end_time
+                                                 : result.handoffs[s].handoff_time;
+            result.total_coverage_time += std::max(0.0, std::min(to, horizon) - from);
+        }
+
+        // Gap time = total timeline - coverage time
+        if (!selected.empty()) {
+            double total_time = std::min(selected.back().end_time, horizon) -
+                                selected.front().start_time;
+            result.total_gap_time = std::max(0.0, total_time - result.total_coverage_time);
+        }
+
+        return result;
+    }
+
+    /**
+     * Find the optimal handoff time between two overlapping windows.
+     * The optimal point is where the weaker signal is maximized —
+     * i.e., where signal_j(t) == signal_i(t) in the overlap region.
+     *
+     * Uses binary search on the overlap interval.
+     */
+    static double findOptimalHandoffTime(const VisibilityWindow& from,
+                                          const VisibilityWindow& to) {
+        double overlap_start = std::max(from.start_time, to.start_time);
+        double overlap_end = std::min(from.end_time, to.end_time);
+
+        if (overlap_start >= overlap_end) {
+            return (from.end_time + to.start_time) / 2.0;
+        }
+
+        // Binary search for the crossover point
+        // from.signalAt(t) is decreasing, to.signalAt(t) is increasing
+        double lo = overlap_start, hi = overlap_end;
+
+        for (int iter = 0; iter < 50; iter++) {  // ~15 digits of precision
+            double mid = (lo + hi) / 2.0;
+            if (from.signalAt(mid) > to.signalAt(mid)) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+
+        return (lo + hi) / 2.0;
+    }
+};
+
+std::vector<VisibilityWindow> generateWindows(int num_satellites,
+                                                double total_time_sec,
+                                                unsigned seed = 42) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> duration_dist(180.0, 600.0);  // 3-10 min
+    std::uniform_real_distribution<double> gap_dist(10.0, 120.0);        // 10s-2min gap
+    std::uniform_real_distribution<double> signal_dist(8.0, 25.0);       // dB SNR
+    std::uniform_real_distribution<double> jitter_dist(-30.0, 30.0);     // overlap jitter
+
+    std::vector<VisibilityWindow> windows;
+    double current_time = 0;
+    int sat_id = 0;
+
+    while (current_time < total_time_sec && sat_id < num_satellites) {
+        double duration = duration_dist(rng);
+        double peak_snr = signal_dist(rng);
+
+        // Create window with overlap into next
+        windows.push_back({
+            sat_id++,
+            current_time,
+            current_time + duration,
+            peak_snr,
+            peak_snr * 0.6,   // 60% of peak at edges
+            peak_snr * 0.5    // 50% of peak at end
+        });
+
+        // Advance time (with some overlap for next satellite)
+        double gap = gap_dist(rng) + jitter_dist(rng);
+        current_time += duration - std::max(30.0, gap);  // Ensure some overlap
+    }
+
+    return windows;
+}
+
+// ============================================================
+// Counter-Based RNG, as in packet_router.cpp
+// ============================================================
+
+class Philox4x32 {
+public:
+    using Block = std::array<uint32_t, 4>;
+
+    Philox4x32(uint64_t seed, uint64_t stream)
+        : key_{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)},
+          stream_(stream) {}
+
+    // The four words at position `index` of this stream
+    Block at(uint64_t index) const {
+        return rounds({static_cast<uint32_t>(index), static_cast<uint32_t>(index >> 32),
+                       static_cast<uint32_t>(stream_), static_cast<uint32_t>(stream_ >> 32)},
+                      key_);
+    }
+
+    // The ten rounds of the Random123 reference (counter, key) -> block
+    static Block rounds(Block ctr, std::array<uint32_t, 2> key) {
+        constexpr uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+        constexpr uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+        for (int r = 0; r < 10; r++) {
+            if (r > 0) {
+                key[0] += W0;
+                key[1] += W1;
+            }
+            uint64_t p0 = static_cast<uint64_t>(M0) * ctr[0];
+            uint64_t p1 = static_cast<uint64_t>(M1) * ctr[2];
+            ctr = {static_cast<uint32_t>(p1 >> 32) ^ ctr[1] ^ key[0],
+                   static_cast<uint32_t>(p1),
+                   static_cast<uint32_t>(p0 >> 32) ^ ctr[3] ^ key[1],
+                   static_cast<uint32_t>(p0)};
+        }
+        return ctr;
+    }
+
+    // Word -> [0, 1) with 32-bit resolution
+    static double unit(uint32_t x) { return (x + 0.5) * (1.0 / 4294967296.0); }
+
+    // Word -> [lo, hi] by multiply-shift (bias below 2^-20 for ranges < 4096)
+    static int range(uint32_t x, int lo, int hi) {
+        uint64_t span = static_cast<uint64_t>(hi - lo) + 1;
+        return lo + static_cast<int>((static_cast<uint64_t>(x) * span) >> 32);
+    }
+
+private:
+    std::array<uint32_t, 2> key_;
+    uint64_t stream_;
+};
+
+// ============================================================
+// EDF calendar queue, as in packet_router.cpp
+// ============================================================
+
+class EdfCalendarQueue {
+public:
+    static constexpr size_t NUM_BUCKETS = 256;
+
+    explicit EdfCalendarQueue(double budget_ms)
+        : budget_(std::chrono::duration_cast<Clock::duration>(
+              std::chrono::duration<double, std::milli>(budget_ms))),
+          width_ns_(std::max<int64_t>(
+              1000, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        budget_).count() / static_cast<int64_t>(NUM_BUCKETS - 2))) {}
+
+    // Stamps the deadline; returns the number of packets expired (the
+    // new one included if it is already late)
+    int push(Packet&& pkt, TimePoint now) {
+        int expired = expireBefore(now);
+        pkt.deadline = pkt.arrival_time + budget_;
+        if (pkt.deadline < now) return expired + 1;
+
+        // Live deadlines lie in [now, now + budget], inside one ring lap
+        int64_t slot = std::min(slotOf(pkt.deadline),
+                                cursor_ + static_cast<int64_t>(NUM_BUCKETS) - 1);
+        if (size_ == 0 || slot < cursor_) cursor_ = std::min(slot, slotOf(now));
+        Bucket& bucket = buckets_[slot % NUM_BUCKETS];
+        bucket.packets.push_back(std::move(pkt));
+        occupied_[(slot % NUM_BUCKETS) / 64] |= 1ULL << (slot % 64);
+        size_++;
+        return expired;
+    }
+
+    // Earliest-deadline packet still on time at `now`
+    std::optional<Packet> pop(TimePoint now, int& expired) {
+        expired = expireBefore(now);
+        while (size_ > 0) {
+            size_t idx = nextOccupied();
+            Bucket& bucket = buckets_[idx];
+            Packet pkt = std::move(bucket.packets[bucket.head++]);
+            size_--;
+            if (bucket.head == bucket.packets.size()) clearBucket(idx);
+            if (pkt.deadline < now) {
+                expired++;
+                continue;
+            }
+            return pkt;
+        }
+        return std::nullopt;
+    }
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+
+private:
+    struct Bucket {
+        std::vector<Packet> packets;
+        size_t head = 0;
+    };
+
+    int64_t slotOf(TimePoint t) const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   t.time_since_epoch()).count() / width_ns_;
+    }
+
+    void clearBucket(size_t idx) {
+        buckets_[idx].packets.clear();
+        buckets_[idx].head = 0;
+        occupied_[idx / 64] &= ~(1ULL << (idx % 64));
+    }
+
+    // First occupied bucket at or after the cursor, wrapping once
+    size_t nextOccupied() {
+        size_t start = static_cast<size_t>(cursor_ % NUM_BUCKETS);
+        for (size_t step = 0; step <= NUM_WORDS; step++) {
+            size_t word = (start / 64 + step) % NUM_WORDS;
+            uint64_t bits = occupied_[word];
+            if (step == 0) bits &= ~0ULL << (start % 64);
+            if (step == NUM_WORDS) bits &= (1ULL << (start % 64)) - 1;
+            if (bits) {
+                size_t idx = word * 64 + __builtin_ctzll(bits);
+                cursor_ += static_cast<int64_t>((idx + NUM_BUCKETS - start) % NUM_BUCKETS);
+                return idx;
+            }
+        }
+        return start;  // unreachable while size_ > 0
+    }
+
+    // Whole buckets older than `now` hold only late packets: drop them
+    // without looking inside
+    int expireBefore(TimePoint now) {
+        int64_t now_slot = slotOf(now);
+        int expired = 0;
+        while (size_ > 0 && cursor_ < now_slot) {
+            size_t idx = nextOccupied();
+            if (cursor_ >= now_slot) break;
+            Bucket& bucket = buckets_[idx];
+            size_t n = bucket.packets.size() - bucket.head;
+            expired += static_cast<int>(n);
+            size_ -= n;
+            clearBucket(idx);
+        }
+        if (cursor_ < now_slot) cursor_ = now_slot;
+        return expired;
+    }
+
+    static constexpr size_t NUM_WORDS = NUM_BUCKETS / 64;
+
+    Clock::duration budget_;
+    int64_t width_ns_;
+    std::array<Bucket, NUM_BUCKETS> buckets_;
+    std::array<uint64_t, NUM_WORDS> occupied_{};
+    int64_t cursor_ = 0;    // absolute slot at or before the earliest deadline
+    size_t size_ = 0;
+};
+
+// ============================================================
+// Window index, as in handoff_scheduler.cpp
+// ============================================================
+
+class WindowIndex {
+public:
+    struct Entry {
+        uint32_t start;
+        uint32_t end;
+        uint32_t max_end;   // over the implicit subtree rooted here
+        uint32_t id;        // caller's window number
+    };
+    static_assert(sizeof(Entry) == 16, "keep four entries per cache line");
+
+    static constexpr double TICKS_PER_SEC = 1000.0;
+
+    explicit WindowIndex(double epoch_sec = 0.0) : epoch_sec_(epoch_sec) {}
+
+    void reserve(size_t n) { entries_.reserve(n); }
+
+    // False if the window falls outside the index's 49-day range
+    bool add(double start_sec, double end_sec, uint32_t id) {
+        double s = std::floor((start_sec - epoch_sec_) * TICKS_PER_SEC);
+        double e = std::ceil((end_sec - epoch_sec_) * TICKS_PER_SEC);
+        if (s < 0 || e > UINT32_MAX || e < s) return false;
+        entries_.push_back({static_cast<uint32_t>(s), static_cast<uint32_t>(e), 0, id});
+        return true;
+    }
+
+    // Windows more than 49 days past the earliest start are left out and
+    // counted in rejected()
+    static WindowIndex fromWindows(const std::vector<VisibilityWindow>& windows) {
+        double epoch = windows.empty() ? 0.0 : windows.front().start_time;
+        for (const auto& w : windows) epoch = std::min(epoch, w.start_time);
+        WindowIndex index(epoch);
+        index.reserve(windows.size());
+        for (size_t i = 0; i < windows.size(); i++) {
+            if (!index.add(windows[i].start_time, windows[i].end_time,
+                           static_cast<uint32_t>(i))) {
+                index.rejected_++;
+            }
+        }
+        index.build();
+        return index;
+    }
+
+    // Sort by start and fill in the subtree maxima, bottom level up
+    void build() {
+        std::sort(entries_.begin(), entries_.end(),
+                  [](const Entry& a, const Entry& b) { return a.start < b.start; });
+        const size_t n = entries_.size();
+        max_level_ = 0;
+        if (n == 0) return;
+
+        size_t last_i = 0;
+        uint32_t last = 0;
+        for (size_t i = 0; i < n; i += 2) {
+            last_i = i;
+            last = entries_[i].max_end = entries_[i].end;
+        }
+        int k = 1;
+        for (; (size_t{1} << k) <= n; k++) {
+            size_t x = size_t{1} << (k - 1);
+            size_t step = x << 2;
+            for (size_t i = (x << 1) - 1; i < n; i += step) {
+                uint32_t left = entries_[i - x].max_end;
+                uint32_t right = i + x < n ? entries_[i + x].max_end : last;
+                entries_[i].max_end = std::max({entries_[i].end, left, right});
+            }
+            // Track the max of the rightmost, possibly incomplete subtree
+            last_i = (last_i >> k & 1) ? last_i - x : last_i + x;
+            if (last_i < n) last = std::max(last, entries_[last_i].max_end);
+        }
+        max_level_ = k - 1;
+    }
+
+    /**
+     * Calls f(id) for every window overlapping [t0_sec, t1_sec] (closed).
+     * Subtrees of up to 16 entries are scanned linearly, which is cheaper
+     * than descending through them.
+     */
+    template<typename F>
+    void forEachOverlapping(double t0_sec, double t1_sec, F&& f) const {
+        const size_t n = entries_.size();
+        if (n == 0) return;
+        double lo_ticks = std::floor((t0_sec - epoch_sec_) * TICKS_PER_SEC);
+        double hi_ticks = std::ceil((t1_sec - epoch_sec_) * TICKS_PER_SEC);
+        if (hi_ticks < 0 || lo_ticks > UINT32_MAX) return;
+        uint32_t lo = static_cast<uint32_t>(std::max(0.0, lo_ticks));
+        uint32_t hi = static_cast<uint32_t>(std::min<double>(UINT32_MAX, hi_ticks));
+
+        struct Frame {
+            int level;
+            size_t node;
+            bool left_done;
+        };
+        Frame stack[64];
+        int top = 0;
+        stack[top++] = {max_level_, (size_t{1} << max_level_) - 1, false};
+        while (top > 0) {
+            Frame z = stack[--top];
+            if (z.level <= 3) {
+                size_t i0 = z.node >> z.level << z.level;
+                size_t i1 = std::min(n, i0 + (size_t{1} << (z.level + 1)) - 1);
+                for (size_t i = i0; i < i1 && entries_[i].start <= hi; i++) {
+                    if (lo <= entries_[i].end) f(entries_[i].id);
+                }
+            } else if (!z.left_done) {
+                size_t left = z.node - (size_t{1} << (z.level - 1));
+                stack[top++] = {z.level, z.node, true};
+                if (left >= n || entries_[left].max_end >= lo) {
+                    stack[top++] = {z.level - 1, left, false};
+                }
+            } else if (z.node < n && entries_[z.node].start <= hi) {
+                if (lo <= entries_[z.node].end) f(entries_[z.node].id);
+                stack[top++] = {z.level - 1, z.node + (size_t{1} << (z.level - 1)), false};
+            }
+        }
+    }
+
+    void overlapping(double t0_sec, double t1_sec, std::vector<uint32_t>& out) const {
+        forEachOverlapping(t0_sec, t1_sec, [&](uint32_t id) { out.push_back(id); });
+    }
+
+    // Windows in view at time t
+    void stabbing(double t_sec, std::vector<uint32_t>& out) const {
+        overlapping(t_sec, t_sec, out);
+    }
+
+    size_t size() const { return entries_.size(); }
+    size_t rejected() const { return rejected_; }
+    size_t memoryBytes() const { return entries_.capacity() * sizeof(Entry); }
+
+private:
+    double epoch_sec_;
+    std::vector<Entry> entries_;
+    int max_level_ = 0;
+    size_t rejected_ = 0;   // fromWindows: outside the tick range
+};
+
+// ============================================================
+// CoDel, as in packet_router.cpp
+// ============================================================
+
+enum class AqmMode : uint8_t {
+    NONE,       // unbounded priority queue (original behaviour)
+    CODEL,      // one CoDel FIFO per priority class
+    FQ_CODEL,   // per-flow CoDel sub-queues within each priority class
+};
+
+struct AqmConfig {
+    AqmMode mode = AqmMode::NONE;
+    Clock::duration target = std::chrono::milliseconds(5);
+    Clock::duration interval = std::chrono::milliseconds(100);
+    int fq_flows = 64;            // FQ-CoDel sub-queues per priority class
+    uint32_t quantum = 1514;      // DRR bytes per round
+    size_t limit_packets = 1000;  // hard cap per output queue (Linux codel default)
+};
+
+class CoDelQueue {
+public:
+    void push(Packet&& pkt) {
+        bytes_ += pkt.payload.size();
+        fifo_.push_back(std::move(pkt));
+    }
+
+    bool empty() const { return fifo_.empty(); }
+    size_t size() const { return fifo_.size(); }
+
+    // Head drop used by the hard queue limit (bypasses the control law)
+    void dropHead() {
+        bytes_ -= fifo_.front().payload.size();
+        fifo_.pop_front();
+    }
+
+    /**
+     * CoDel dequeue. Dropped packets are counted in `drops` and never
+     * returned; nullopt means the queue ran empty.
+     */
+    std::optional<Packet> pop(TimePoint now, const AqmConfig& cfg,
+                              uint64_t& drops) {
+        bool ok_to_drop = false;
+        auto pkt = popHead(now, cfg, ok_to_drop);
+        if (!pkt) {
+            dropping_ = false;
+            return pkt;
+        }
+
+        if (dropping_) {
+            if (!ok_to_drop) {
+                dropping_ = false;
+            } else {
+                while (now >= drop_next_ && dropping_) {
+                    drops++;
+                    count_++;
+                    pkt = popHead(now, cfg, ok_to_drop);
+                    if (!pkt || !ok_to_drop) {
+                        dropping_ = false;
+                    } else {
+                        drop_next_ = controlLaw(drop_next_, cfg);
+                    }
+                }
+            }
+        } else if (ok_to_drop) {
+            drops++;
+            pkt = popHead(now, cfg, ok_to_drop);
+            dropping_ = true;
+            // Resume near the previous drop rate if we were dropping recently
+            uint32_t delta = count_ - last_count_;
+            count_ = (delta > 1 && now - drop_next_ < 16 * cfg.interval)
+                         ? delta : 1;
+            drop_next_ = controlLaw(now, cfg);
+            last_count_ = count_;
+        }
+        return pkt;
+    }
+
+private:
+    static constexpr size_t MTU_BYTES = 1514;
+
+    std::optional<Packet> popHead(TimePoint now, const AqmConfig& cfg,
+                                  bool& ok_to_drop) {
+        ok_to_drop = false;
+        if (fifo_.empty()) {
+            first_above_time_ = TimePoint{};
+            return std::nullopt;
+        }
+        Packet pkt = std::move(fifo_.front());
+        fifo_.pop_front();
+        bytes_ -= pkt.payload.size();
+
+        Clock::duration sojourn = now - pkt.enqueue_time;
+        if (sojourn < cfg.target || bytes_ <= MTU_BYTES) {
+            first_above_time_ = TimePoint{};
+        } else if (first_above_time_ == TimePoint{}) {
+            first_above_time_ = now + cfg.interval;
+        } else if (now >= first_above_time_) {
+            ok_to_drop = true;
+        }
+        return pkt;
+    }
+
+    TimePoint controlLaw(TimePoint t, const AqmConfig& cfg) const {
+        return t + std::chrono::duration_cast<Clock::duration>(
+                       cfg.interval / std::sqrt(static_cast<double>(count_)));
+    }
+
+    std::deque<Packet> fifo_;
+    size_t bytes_ = 0;
+    TimePoint first_above_time_{};
+    TimePoint drop_next_{};
+    uint32_t count_ = 0;
+    uint32_t last_count_ = 0;
+    bool dropping_ = false;
+};
+
+// ============================================================
+// Discrete-event queue, as in visualizer_data.cpp
+// ============================================================
+enum class DesEventType : uint8_t {
+    ORBIT_TICK,      // propagate the constellation, schedule rise/set
+    RISE,            // satellite climbs above the station's mask
+    SET,             // ... and drops below it
+    HANDOFF,         // pick a serving satellite
+    PACKET_SEND,     // next packet leaves the terminal
+    PACKET_ARRIVAL,  // packet reaches the station's reorder buffer
+    TIMEOUT,         // reorder gap held too long: skip it
+    COUNT
+};
+
+struct DesEvent {
+    double time;
+    int32_t station;     // -1 for constellation-wide events
+    int32_t satellite;
+    uint64_t seq;        // per-station counter
+    uint64_t data;       // packet number, timeout generation
+    DesEventType type;
+
+    bool operator<(const DesEvent& o) const {
+        if (time != o.time) return time < o.time;
+        if (station != o.station) return station < o.station;
+        return seq < o.seq;
+    }
+};
+
+/**
+ * Calendar queue (Brown, 1988): a ring of buckets, each one `width`
+ * seconds wide, like the days of a year. An event goes into bucket
+ * floor(time / width) mod nbuckets; popping walks the ring from the
+ * current day and takes an event only if it falls in this year. With
+ * the bucket count kept near the event count and the width near a few
+ * mean inter-event gaps, push and pop are O(1) on average.
+ *
+ * Each bucket is a binary min-heap, so a burst of events at one instant
+ * (every satellite in view at t = 0) costs O(log n) each rather than a
+ * sorted insert.
+ */
+class CalendarQueue {
+public:
+    explicit CalendarQueue(double width = 1e-3) : width_(width) {
+        buckets_.resize(MIN_BUCKETS);
+    }
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+
+    void push(const DesEvent& ev) {
+        uint64_t slot = slotOf(ev.time);
+        if (slot < slot_) slot_ = slot;  // earlier than the last peek
+        insert(ev, slot);
+        if (++size_ > 2 * buckets_.size()) resize(buckets_.size() * 2);
+    }
+
+    // Earliest event, or nullptr; moves the scan position up to it
+    const DesEvent* front() {
+        if (size_ == 0) return nullptr;
+        const size_t mask = buckets_.size() - 1;
+        for (size_t n = 0; n < buckets_.size(); n++, slot_++) {
+            const auto& b = buckets_[slot_ & mask];
+            if (!b.empty() && slotOf(b.front().time) <= slot_) return &b.front();
+        }
+        // A whole year without an event: jump straight to the earliest
+        const DesEvent* earliest = nullptr;
+        for (const auto& b : buckets_) {
+            if (!b.empty() && (!earliest || b.front() < *earliest)) earliest = &b.front();
+        }
+        slot_ = slotOf(earliest->time);
+        return earliest;
+    }
+
+    DesEvent pop() {
+        front();
+        auto& b = buckets_[slot_ & (buckets_.size() - 1)];
+        std::pop_heap(b.begin(), b.end(), later);
+        DesEvent ev = b.back();
+        b.pop_back();
+        if (--size_ < buckets_.size() / 2 && buckets_.size() > MIN_BUCKETS) {
+            resize(buckets_.size() / 2);
+        }
+        return ev;
+    }
+
+private:
+    static constexpr size_t MIN_BUCKETS = 16;
+    static constexpr size_t WIDTH_SAMPLE = 25;
+
+    uint64_t slotOf(double time) const { return static_cast<uint64_t>(time / width_); }
+
+    static bool later(const DesEvent& a, const DesEvent& b) { return b < a; }
+
+    void insert(const DesEvent& ev, uint64_t slot) {
+        auto& b = buckets_[slot & (buckets_.size() - 1)];
+        b.push_back(ev);
+        std::push_heap(b.begin(), b.end(), later);
+    }
+
+    // New bucket count; the width becomes three mean gaps between the
+    // earliest few events, as Brown suggests
+    void resize(size_t nbuckets) {
+        std::vector<DesEvent> all;
+        all.reserve(size_);
+        for (auto& b : buckets_) {
+            all.insert(all.end(), b.begin(), b.end());
+            b.clear();
+        }
+        size_t k = std::min(all.size(), WIDTH_SAMPLE);
+        std::partial_sort(all.begin(), all.begin() + k, all.end());
+        if (k > 1) {
+            double gap = (all[k - 1].time - all[0].time) / (k - 1);
+            if (gap > 0.0) width_ = 3.0 * gap;
+        }
+        buckets_.assign(nbuckets, {});
+        slot_ = all.empty() ? 0 : slotOf(all[0].time);
+        for (const auto& ev : all) insert(ev, slotOf(ev.time));
+    }
+
+    std::vector<std::vector<DesEvent>> buckets_;
+    double width_;
+    uint64_t slot_ = 0;  // no event lives in an earlier slot
+    size_t size_ = 0;
+};
+
+// ============================================================
+// Visibility edges, as in visualizer_data.cpp
+// ============================================================
+// In their own namespace: main.cpp's GeoCoord and elevation are above
+namespace viz {
+
+template<typename T>
+struct GeoCoordT {
+    T lat_deg;
+    T lon_deg;
+};
+using GeoCoord = GeoCoordT<double>;
+
+struct Satellite {
+    int id;
+    GeoCoord position;
+    double altitude_km;
+    int orbital_plane;
+    int shell_id;
+    double capacity_mbps;
+    double x, y, z;  // 3D Cartesian for Three.js (unit = Earth radii)
+};
+
+/**
+ * What a site can actually see above the global elevation mask.
+ * `min_elev_deg[b]` is the lowest usable elevation for azimuths in
+ * [b, b + 1) degrees clockwise from north (terrain, buildings). A
+ * phased-array terminal can also only steer within `fov_half_deg` of its
+ * boresight; 180 leaves the cone open.
+ */
+struct HorizonMask {
+    static constexpr int BINS = 360;
+    std::array<float, BINS> min_elev_deg{};
+    double boresight_az_deg = 0.0;
+    double boresight_el_deg = 90.0;
+    double fov_half_deg = 180.0;
+};
+
+struct GroundStation {
+    int id;
+    GeoCoord position;
+    std::string name;
+    double min_elevation_deg;
+    double capacity_mbps;
+    std::shared_ptr<const HorizonMask> horizon;  // null: the global mask only
+};
+
+struct VisibilityEdge {
+    int satellite_id;
+    int station_id;
+    double elevation_deg;
+    double slant_km;
+    double latency_ms;
+};
+
+struct VisibilityStats {
+    int edge_count = 0;
+    double min_elev = 90.0;
+    double max_elev = 0.0;
+    double avg_elev = 0.0;
+    double min_latency = 1e9;
+    double max_latency = 0.0;
+    double avg_latency = 0.0;
+    std::vector<int> coverage_counts;
+};
+
+// Geometry is templated on the scalar type: double is the reference,
+// float feeds the SIMD visibility filter below.
+template<typename T>
+T haversineDistanceKm(const GeoCoordT<T>& a, const GeoCoordT<T>& b) {
+    T dlat = (b.lat_deg - a.lat_deg) * T(DEG_TO_RAD);
+    T dlon = (b.lon_deg - a.lon_deg) * T(DEG_TO_RAD);
+    T lat1 = a.lat_deg * T(DEG_TO_RAD);
+    T lat2 = b.lat_deg * T(DEG_TO_RAD);
+    T h = std::sin(dlat / 2) * std::sin(dlat / 2) +
+          std::cos(lat1) * std::cos(lat2) *
+          std::sin(dlon / 2) * std::sin(dlon / 2);
+    T c = 2 * std::asin(std::sqrt(h));
+    return T(EARTH_RADIUS_KM) * c;
+}
+
+template<typename T>
+T computeElevationAngle(const GeoCoordT<T>& station, const GeoCoordT<T>& sat_pos,
+                        T sat_altitude_km) {
+    const T R = T(EARTH_RADIUS_KM);
+    T ground_dist_km = haversineDistanceKm(station, sat_pos);
+    T central_angle = ground_dist_km / R;
+    T r_sat = R + sat_altitude_km;
+    T slant_range = std::sqrt(
+        R * R +
+        r_sat * r_sat -
+        2 * R * r_sat * std::cos(central_angle));
+    if (slant_range < T(1e-6)) return T(90);
+    T cos_elevation = (slant_range * slant_range +
+                       R * R -
+                       r_sat * r_sat) /
+                      (2 * slant_range * R);
+    T angle_at_station = std::acos(std::clamp(cos_elevation, T(-1), T(1)));
+    return (angle_at_station * T(RAD_TO_DEG)) - T(90);
+}
+
+template<typename T>
+T computeSlantRangeKm(const GeoCoordT<T>& station, const GeoCoordT<T>& sat_pos,
+                      T sat_altitude_km) {
+    const T R = T(EARTH_RADIUS_KM);
+    T ground_dist_km = haversineDistanceKm(station, sat_pos);
+    T central_angle = ground_dist_km / R;
+    T r_sat = R + sat_altitude_km;
+    return std::sqrt(
+        R * R +
+        r_sat * r_sat -
+        2 * R * r_sat * std::cos(central_angle));
+}
+
+double computeLatencyMs(double slant_km) {
+    return slant_km / 299.792;
+}
+
+// ---- 3D coordinate helpers ----
+template<typename T>
+struct Vec3T { T x, y, z; };
+using Vec3 = Vec3T<double>;
+
+template<typename T, typename Trig = LibmTrig>
+Vec3T<T> geoTo3D(T lat_deg, T lon_deg, T altitude_km) {
+    T lat = lat_deg * T(DEG_TO_RAD);
+    T lon = lon_deg * T(DEG_TO_RAD);
+    T r = (T(EARTH_RADIUS_KM) + altitude_km) / T(EARTH_RADIUS_KM);
+    return {
+        r * Trig::cos(lat) * Trig::cos(lon),
+        r * Trig::sin(lat),
+       -r * Trig::cos(lat) * Trig::sin(lon)
+    };
+}
+
+/**
+ * Cosine of the largest Earth central angle at which a satellite at
+ * `altitude_km` is at or above `min_elev_deg`. Visibility then needs no
+ * trig per pair: the dot product of the two unit vectors must reach it.
+ */
+template<typename T>
+T coverageCos(T altitude_km, T min_elev_deg) {
+    T e = min_elev_deg * T(DEG_TO_RAD);
+    T lambda = std::acos(T(EARTH_RADIUS_KM) * std::cos(e) /
+                         (T(EARTH_RADIUS_KM) + altitude_km)) - e;
+    return std::cos(lambda);
+}
+
+// ---- Horizon masks ----
+// Local east/north/up unit vectors at a station, in the geoTo3D frame
+template<typename T>
+struct EnuFrame { Vec3T<T> east, north, up; };
+
+template<typename T>
+EnuFrame<T> enuFrame(T lat_deg, T lon_deg) {
+    T lat = lat_deg * T(DEG_TO_RAD);
+    T lon = lon_deg * T(DEG_TO_RAD);
+    T sin_lat = std::sin(lat), cos_lat = std::cos(lat);
+    T sin_lon = std::sin(lon), cos_lon = std::cos(lon);
+    return {{-sin_lon, T(0), -cos_lon},
+            {-sin_lat * cos_lon, cos_lat, sin_lat * sin_lon},
+            {cos_lat * cos_lon, sin_lat, -cos_lat * sin_lon}};
+}
+
+template<typename T>
+T dot3(const Vec3T<T>& a, const Vec3T<T>& b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// Boresight as an east/north/up unit vector
+template<typename T>
+Vec3T<T> boresightEnu(const HorizonMask& h) {
+    T az = static_cast<T>(h.boresight_az_deg * DEG_TO_RAD);
+    T el = static_cast<T>(h.boresight_el_deg * DEG_TO_RAD);
+    return {std::cos(el) * std::sin(az), std::cos(el) * std::cos(az), std::sin(el)};
+}
+
+// Lowest elevation the mask or the cone can admit at any azimuth
+double horizonFloorDeg(const HorizonMask& h) {
+    double floor = *std::min_element(h.min_elev_deg.begin(), h.min_elev_deg.end());
+    return std::max(floor, h.boresight_el_deg - h.fov_half_deg);
+}
+
+/**
+ * The reference horizon test for a pair already at `elev` degrees:
+ * azimuth from the line of sight projected on the station's east/north
+ * plane, then that bin's mask, then the angle to the boresight. Double
+ * precision and libm throughout.
+ */
+bool horizonAdmits(const HorizonMask& h, const GroundStation& gs,
+                   const Satellite& sat, double elev) {
+    auto frame = enuFrame(gs.position.lat_deg, gs.position.lon_deg);
+    Vec3 s = geoTo3D(sat.position.lat_deg, sat.position.lon_deg, 0.0);
+    double r = (EARTH_RADIUS_KM + sat.altitude_km) / EARTH_RADIUS_KM;
+    // Line of sight in east/north/up, Earth radii
+    Vec3 d{r * dot3(s, frame.east), r * dot3(s, frame.north), r * dot3(s, frame.up) - 1.0};
+
+    double az = std::atan2(d.x, d.y) * RAD_TO_DEG;
+    if (az < 0.0) az += 360.0;
+    int bin = std::min(static_cast<int>(az * HorizonMask::BINS / 360.0), HorizonMask::BINS - 1);
+    if (elev < h.min_elev_deg[bin]) return false;
+    if (h.fov_half_deg >= 180.0) return true;
+    return dot3(d, boresightEnu<double>(h)) >=
+           std::sqrt(dot3(d, d)) * std::cos(h.fov_half_deg * DEG_TO_RAD);
+}
+
+std::vector<VisibilityEdge> buildVisibilityEdges(
+    const std::vector<Satellite>& sats,
+    const std::vector<GroundStation>& stations,
+    double min_elevation_deg,
+    VisibilityStats& stats_out) {
+    std::vector<VisibilityEdge> edges;
+    stats_out.coverage_counts.assign(stations.size(), 0);
+
+    for (const auto& sat : sats) {
+        for (const auto& gs : stations) {
+            double elev = computeElevationAngle(gs.position, sat.position, sat.altitude_km);
+            if (elev < min_elevation_deg) continue;
+            if (gs.horizon && !horizonAdmits(*gs.horizon, gs, sat, elev)) continue;
+
+            double slant = computeSlantRangeKm(gs.position, sat.position, sat.altitude_km);
+            double latency = computeLatencyMs(slant);
+            edges.push_back({sat.id, gs.id, elev, slant, latency});
+            stats_out.coverage_counts[gs.id]++;
+
+            stats_out.min_elev = std::min(stats_out.min_elev, elev);
+            stats_out.max_elev = std::max(stats_out.max_elev, elev);
+            stats_out.avg_elev += elev;
+            stats_out.min_latency = std::min(stats_out.min_latency, latency);
+            stats_out.max_latency = std::max(stats_out.max_latency, latency);
+            stats_out.avg_latency += latency;
+        }
+    }
+
+    stats_out.edge_count = static_cast<int>(edges.size());
+    if (stats_out.edge_count > 0) {
+        stats_out.avg_elev /= stats_out.edge_count;
+        stats_out.avg_latency /= stats_out.edge_count;
+    } else {
+        stats_out.min_elev = stats_out.max_elev = 0.0;
+        stats_out.min_latency = stats_out.max_latency = 0.0;
+    }
+    return edges;
+}
+
+struct FastVisibilityStats {
+    uint64_t pairs = 0;
+    uint64_t float_rejected = 0;   // settled by the float filter alone
+    uint64_t band_rechecks = 0;    // within COS_BAND of the threshold
+    uint64_t horizon_lookups = 0;  // azimuths computed for masked stations
+    uint64_t horizon_rechecks = 0; // near a bin edge, the mask or the cone
+};
+
+/**
+ * Horizon masks for the float filter. Pairs that clear the global mask
+ * at a masked station are staged here (line of sight in east/north/up,
+ * boresight, cone cosine, mask row) and evaluated four at a time:
+ * azimuth from a polynomial atan2 (A&S 4.4.49, 2e-8 rad), bin, mask and
+ * cone compares all in SSE; only the four mask loads are scalar, SSE2
+ * having no gather. Lanes within a band of a decision — a bin edge, the
+ * mask value, the cone edge, or near zenith where azimuth is ill
+ * conditioned — go through the double horizonAdmits, so the result is
+ * the reference's. Pairs below a station's lowest mask never get an
+ * azimuth.
+ */
+class HorizonFilter {
+public:
+    static constexpr int NO_MASK = -1;
+    static constexpr int BELOW_FLOOR = -2;
+
+    HorizonFilter(const std::vector<Satellite>& sats,
+                  const std::vector<GroundStation>& stations)
+        : sats_(sats), stations_(stations) {
+        for (size_t g = 0; g < stations.size(); g++) {
+            const auto& gs = stations[g];
+            if (!gs.horizon) continue;
+            if (site_.empty()) site_.resize(stations.size());
+            const HorizonMask& h = *gs.horizon;
+            auto frame = enuFrame<float>(static_cast<float>(gs.position.lat_deg),
+                                         static_cast<float>(gs.position.lon_deg));
+            site_[g] = {&h, frame, boresightEnu<float>(h),
+                        h.fov_half_deg >= 180.0
+                            ? -2.0f : static_cast<float>(std::cos(h.fov_half_deg * DEG_TO_RAD)),
+                        horizonFloorDeg(h)};
+        }
+        if (!active()) return;
+        sat_r_.resize(sats.size());
+        for (size_t i = 0; i < sats.size(); i++) {
+            sat_r_[i] = static_cast<float>((EARTH_RADIUS_KM + sats[i].altitude_km) /
+                                           EARTH_RADIUS_KM);
+        }
+    }
+
+    bool active() const { return !site_.empty(); }
+
+    // Slot for a pair at or above the global mask, NO_MASK or BELOW_FLOOR
+    int stage(size_t i, size_t g, double elev, const Vec3T<float>& s) {
+        const Site& site = site_[g];
+        if (!site.mask) return NO_MASK;
+        if (elev < site.floor_deg) return BELOW_FLOOR;
+        float r = sat_r_[i];
+        de_.push_back(r * dot3(s, site.frame.east));
+        dn_.push_back(r * dot3(s, site.frame.north));
+        du_.push_back(r * dot3(s, site.frame.up) - 1.0f);
+        elev_.push_back(static_cast<float>(elev));
+        be_.push_back(site.boresight.x);
+        bn_.push_back(site.boresight.y);
+        bu_.push_back(site.boresight.z);
+        cos_half_.push_back(site.cos_half);
+        pairs_.push_back({i, g, elev});
+        return static_cast<int>(pairs_.size()) - 1;
+    }
+
+    // Decide every staged slot; admitted(slot) is valid until clear()
+    void evaluate(FastVisibilityStats& fast) {
+        const size_t n = pairs_.size();
+        admitted_.assign(n, 0);
+        fast.horizon_lookups += n;
+#ifdef __SSE2__
+        constexpr float AZ_BAND = 1e-2f;       // bins
+        constexpr float ELEV_BAND = 1e-4f;     // degrees
+        constexpr float COS_BAND = 1e-4f;      // relative to the sight line
+        constexpr float HORIZ_SQ_MIN = 1e-4f;  // above ~83 deg at 550 km
+        // Pad to whole lanes; padding reuses a masked station so the
+        // lookups stay in bounds, and its results are never read
+        const size_t padded = (n + 3) / 4 * 4;
+        for (size_t k = n; k < padded; k++) {
+            for (auto* v : {&de_, &dn_, &du_, &elev_, &be_, &bn_, &bu_, &cos_half_}) {
+                v->push_back(0.0f);
+            }
+            pairs_.push_back(pairs_.front());
+        }
+        const __m128 sign = _mm_set1_ps(-0.0f);
+        const __m128 zero = _mm_setzero_ps();
+        for (size_t base = 0; base < padded; base += 4) {
+            __m128 e = _mm_loadu_ps(&de_[base]);
+            __m128 nn = _mm_loadu_ps(&dn_[base]);
+            __m128 u = _mm_loadu_ps(&du_[base]);
+            __m128 az = azimuthDeg(e, nn, sign, zero);
+
+            // Bin and its fractional part (az >= 0, so truncation floors)
+            __m128 pos = _mm_mul_ps(az, _mm_set1_ps(HorizonMask::BINS / 360.0f));
+            __m128i bin = _mm_cvttps_epi32(pos);
+            __m128 frac = _mm_sub_ps(pos, _mm_cvtepi32_ps(bin));
+            alignas(16) int32_t idx[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(idx), bin);
+            float thr_lane[4];
+            for (int l = 0; l < 4; l++) {
+                int b = std::min(idx[l], HorizonMask::BINS - 1);
+                thr_lane[l] = site_[pairs_[base + l].g].mask->min_elev_deg[b];
+            }
+            __m128 thr = _mm_loadu_ps(thr_lane);
+            __m128 elev = _mm_loadu_ps(&elev_[base]);
+            __m128 pass = _mm_cmpge_ps(elev, thr);
+
+            // Cone: d . b >= |d| cos(half)
+            __m128 len = _mm_sqrt_ps(_mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(e, e), _mm_mul_ps(nn, nn)), _mm_mul_ps(u, u)));
+            __m128 along = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(e, _mm_loadu_ps(&be_[base])),
+                           _mm_mul_ps(nn, _mm_loadu_ps(&bn_[base]))),
+                _mm_mul_ps(u, _mm_loadu_ps(&bu_[base])));
+            __m128 edge = _mm_mul_ps(len, _mm_loadu_ps(&cos_half_[base]));
+            pass = _mm_and_ps(pass, _mm_cmpge_ps(along, edge));
+
+            __m128 band = _mm_or_ps(
+                _mm_cmplt_ps(frac, _mm_set1_ps(AZ_BAND)),
+                _mm_cmpgt_ps(frac, _mm_set1_ps(1.0f - AZ_BAND)));
+            band = _mm_or_ps(band, _mm_cmple_ps(_mm_andnot_ps(sign, _mm_sub_ps(elev, thr)),
+                                                _mm_set1_ps(ELEV_BAND)));
+            band = _mm_or_ps(band, _mm_cmple_ps(_mm_andnot_ps(sign, _mm_sub_ps(along, edge)),
+                                                _mm_mul_ps(len, _mm_set1_ps(COS_BAND))));
+            band = _mm_or_ps(band, _mm_cmplt_ps(
+                _mm_add_ps(_mm_mul_ps(e, e), _mm_mul_ps(nn, nn)), _mm_set1_ps(HORIZ_SQ_MIN)));
+
+            unsigned pass_bits = _mm_movemask_ps(pass);
+            unsigned band_bits = _mm_movemask_ps(band);
+            for (size_t l = 0; l < 4 && base + l < n; l++) {
+                admitted_[base + l] = band_bits >> l & 1 ? recheck(base + l, fast)
+                                                         : pass_bits >> l & 1;
+            }
+        }
+#else
+        for (size_t k = 0; k < n; k++) admitted_[k] = recheck(k, fast);
+#endif
+    }
+
+    bool admitted(int slot) const { return admitted_[slot]; }
+
+    void clear() {
+        for (auto* v : {&de_, &dn_, &du_, &elev_, &be_, &bn_, &bu_, &cos_half_}) v->clear();
+        pairs_.clear();
+    }
+
+private:
+    struct Site {
+        const HorizonMask* mask = nullptr;
+        EnuFrame<float> frame{};
+        Vec3T<float> boresight{};
+        float cos_half = -2.0f;       // -2: open cone, never binding
+        double floor_deg = 0.0;
+    };
+    struct Pair {
+        size_t i, g;
+        double elev;
+    };
 
-struct GeoCoord {
-    double lat_deg;
-    double lon_deg;
+    bool recheck(size_t slot, FastVisibilityStats& fast) const {
+        const Pair& p = pairs_[slot];
+        fast.horizon_rechecks++;
+        return horizonAdmits(*site_[p.g].mask, stations_[p.g], sats_[p.i], p.elev);
+    }
+
+#ifdef __SSE2__
+    // atan2(e, n) in degrees, [0, 360): clockwise from north
+    static __m128 azimuthDeg(__m128 e, __m128 n, __m128 sign, __m128 zero) {
+        __m128 ae = _mm_andnot_ps(sign, e);
+        __m128 an = _mm_andnot_ps(sign, n);
+        __m128 hi = _mm_max_ps(ae, an);
+        __m128 a = _mm_div_ps(_mm_min_ps(ae, an), _mm_max_ps(hi, _mm_set1_ps(1e-30f)));
+        __m128 z = _mm_mul_ps(a, a);
+        __m128 p = _mm_set1_ps(0.0028662257f);
+        for (float c : {-0.0161657367f, 0.0429096138f, -0.0752896400f, 0.1065626393f,
+                        -0.1420889944f, 0.1999355085f, -0.3333314528f, 1.0f}) {
+            p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(c));
+        }
+        p = _mm_mul_ps(p, a);   // atan(min / max), [0, pi/4]
+
+        const __m128 half_pi = _mm_set1_ps(static_cast<float>(M_PI / 2));
+        __m128 east_major = _mm_cmpgt_ps(ae, an);
+        p = _mm_or_ps(_mm_and_ps(east_major, _mm_sub_ps(half_pi, p)),
+                      _mm_andnot_ps(east_major, p));
+        __m128 south = _mm_cmplt_ps(n, zero);
+        p = _mm_or_ps(_mm_and_ps(south, _mm_sub_ps(_mm_set1_ps(static_cast<float>(M_PI)), p)),
+                      _mm_andnot_ps(south, p));
+        __m128 west = _mm_cmplt_ps(e, zero);
+        p = _mm_or_ps(_mm_and_ps(west, _mm_sub_ps(_mm_set1_ps(static_cast<float>(2 * M_PI)), p)),
+                      _mm_andnot_ps(west, p));
+        return _mm_mul_ps(p, _mm_set1_ps(static_cast<float>(RAD_TO_DEG)));
+    }
+#endif
+
+    const std::vector<Satellite>& sats_;
+    const std::vector<GroundStation>& stations_;
+    std::vector<Site> site_;          // by station; empty when no station is masked
+    std::vector<float> sat_r_;        // orbit radius, Earth radii
+    std::vector<float> de_, dn_, du_, elev_, be_, bn_, bu_, cos_half_;
+    std::vector<Pair> pairs_;
+    std::vector<uint8_t> admitted_;
 };
 
-double haversineDistanceKm(const GeoCoord& a, const GeoCoord& b) {
-    double dlat = (b.lat_deg - a.lat_deg) * DEG_TO_RAD;
-    double dlon = (b.lon_deg - a.lon_deg) * DEG_TO_RAD;
-    double lat1 = a.lat_deg * DEG_TO_RAD;
-    double lat2 = b.lat_deg * DEG_TO_RAD;
-    double h = std::sin(dlat / 2) * std::sin(dlat / 2) +
-               std::cos(lat1) * std::cos(lat2) *
-               std::sin(dlon / 2) * std::sin(dlon / 2);
-    double c = 2 * std::asin(std::sqrt(h));
-    return EARTH_RADIUS_KM * c;
+/**
+ * The float32 visibility filter: satellites and stations become unit
+ * vectors, and their dot product is compared with each satellite's
+ * coverageCos four lanes at a time (SSE, twice the lanes of double).
+ * Pairs clearly below the threshold are dropped in float; the rest —
+ * clear passes and the band within COS_BAND of the threshold — go
+ * through the double computeElevationAngle, and `visit(sat, station,
+ * elev)` is called for those at or above the mask, satellite-major like
+ * the double path. Float error in the dot product is ~1e-7, far inside
+ * the band. Stations with a horizon mask also pass through HorizonFilter.
+ */
+template<typename Visit>
+void forEachVisiblePair(const std::vector<Satellite>& sats,
+                        const std::vector<GroundStation>& stations,
+                        double min_elevation_deg,
+                        FastVisibilityStats& fast,
+                        Visit&& visit) {
+    constexpr float COS_BAND = 1e-5f;
+    constexpr size_t LANES = 4;
+
+    // Structure-of-arrays, padded to whole lanes with never-visible entries
+    const size_t padded = (sats.size() + LANES - 1) / LANES * LANES;
+    std::vector<float> sx(padded, 0.0f), sy(padded, 0.0f), sz(padded, 0.0f);
+    std::vector<float> threshold(padded, 2.0f);
+    for (size_t i = 0; i < sats.size(); i++) {
+        auto u = geoTo3D<float>(static_cast<float>(sats[i].position.lat_deg),
+                                static_cast<float>(sats[i].position.lon_deg), 0.0f);
+        sx[i] = u.x;
+        sy[i] = u.y;
+        sz[i] = u.z;
+        threshold[i] = static_cast<float>(
+            coverageCos(sats[i].altitude_km, min_elevation_deg));
+    }
+    std::vector<Vec3T<float>> station_unit;
+    for (const auto& gs : stations) {
+        station_unit.push_back(geoTo3D<float>(static_cast<float>(gs.position.lat_deg),
+                                              static_cast<float>(gs.position.lon_deg),
+                                              0.0f));
+    }
+
+    HorizonFilter horizon(sats, stations);
+    struct Pending {
+        size_t i, g;
+        double elev;
+        int slot;
+    };
+    std::vector<Pending> pending;
+
+    std::vector<unsigned> candidate_mask(stations.size());
+    for (size_t base = 0; base < padded; base += LANES) {
+        for (size_t g = 0; g < stations.size(); g++) {
+            const auto& u = station_unit[g];
+            unsigned candidate = 0, band = 0;
+#ifdef __SSE2__
+            __m128 dot = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(u.x), _mm_loadu_ps(&sx[base])),
+                           _mm_mul_ps(_mm_set1_ps(u.y), _mm_loadu_ps(&sy[base]))),
+                _mm_mul_ps(_mm_set1_ps(u.z), _mm_loadu_ps(&sz[base])));
+            __m128 thr = _mm_loadu_ps(&threshold[base]);
+            __m128 band_lo = _mm_sub_ps(thr, _mm_set1_ps(COS_BAND));
+            __m128 band_hi = _mm_add_ps(thr, _mm_set1_ps(COS_BAND));
+            candidate = _mm_movemask_ps(_mm_cmpge_ps(dot, band_lo));
+            band = candidate & _mm_movemask_ps(_mm_cmple_ps(dot, band_hi));
+#else
+            for (size_t l = 0; l < LANES; l++) {
+                size_t i = base + l;
+                float dot = u.x * sx[i] + u.y * sy[i] + u.z * sz[i];
+                if (dot >= threshold[i] - COS_BAND) {
+                    candidate |= 1u << l;
+                    if (dot <= threshold[i] + COS_BAND) band |= 1u << l;
+                }
+            }
+#endif
+            candidate_mask[g] = candidate;
+            fast.band_rechecks += __builtin_popcount(band);
+        }
+
+        // Satellite-major, like the double path, so edge order matches
+        for (size_t l = 0; l < LANES && base + l < sats.size(); l++) {
+            const auto& sat = sats[base + l];
+            const Vec3T<float> s{sx[base + l], sy[base + l], sz[base + l]};
+            for (size_t g = 0; g < stations.size(); g++) {
+                fast.pairs++;
+                if (!(candidate_mask[g] >> l & 1)) {
+                    fast.float_rejected++;
+                    continue;
+                }
+                double elev = computeElevationAngle(stations[g].position, sat.position,
+                                                    sat.altitude_km);
+                if (elev < min_elevation_deg) continue;
+                if (horizon.active()) {
+                    pending.push_back({base + l, g, elev, horizon.stage(base + l, g, elev, s)});
+                    continue;
+                }
+                visit(base + l, g, elev);
+            }
+        }
+
+        // Masked stations' pairs are decided together, then visited in order
+        if (pending.empty()) continue;
+        horizon.evaluate(fast);
+        for (const auto& p : pending) {
+            if (p.slot == HorizonFilter::BELOW_FLOOR) continue;
+            if (p.slot >= 0 && !horizon.admitted(p.slot)) continue;
+            visit(p.i, p.g, p.elev);
+        }
+        pending.clear();
+        horizon.clear();
+    }
 }
 
-double computeElevationAngle(const GeoCoord& station, const GeoCoord& sat_pos,
-                              double sat_altitude_km) {
-    double ground_dist_km = haversineDistanceKm(station, sat_pos);
-    double central_angle = ground_dist_km / EARTH_RADIUS_KM;
-    double r_sat = EARTH_RADIUS_KM + sat_altitude_km;
-    double slant_range = std::sqrt(
-        EARTH_RADIUS_KM * EARTH_RADIUS_KM +
-        r_sat * r_sat -
-        2 * EARTH_RADIUS_KM * r_sat * std::cos(central_angle));
-    if (slant_range < 1e-6) return 90.0;
-    double cos_elevation = (slant_range * slant_range +
-                            EARTH_RADIUS_KM * EARTH_RADIUS_KM -
-                            r_sat * r_sat) /
-                           (2 * slant_range * EARTH_RADIUS_KM);
-    double angle_at_station = std::acos(std::clamp(cos_elevation, -1.0, 1.0));
-    return (angle_at_station * RAD_TO_DEG) - 90.0;
+// buildVisibilityEdges with the float32 filter in front; same edges,
+// same order, same values
+std::vector<VisibilityEdge> buildVisibilityEdgesFast(
+    const std::vector<Satellite>& sats,
+    const std::vector<GroundStation>& stations,
+    double min_elevation_deg,
+    VisibilityStats& stats_out,
+    FastVisibilityStats& fast) {
+    std::vector<VisibilityEdge> edges;
+    stats_out.coverage_counts.assign(stations.size(), 0);
+
+    forEachVisiblePair(sats, stations, min_elevation_deg, fast,
+                       [&](size_t i, size_t g, double elev) {
+        const auto& sat = sats[i];
+        const auto& gs = stations[g];
+        double slant = computeSlantRangeKm(gs.position, sat.position, sat.altitude_km);
+        double latency = computeLatencyMs(slant);
+        edges.push_back({sat.id, gs.id, elev, slant, latency});
+        stats_out.coverage_counts[gs.id]++;
+
+        stats_out.min_elev = std::min(stats_out.min_elev, elev);
+        stats_out.max_elev = std::max(stats_out.max_elev, elev);
+        stats_out.avg_elev += elev;
+        stats_out.min_latency = std::min(stats_out.min_latency, latency);
+        stats_out.max_latency = std::max(stats_out.max_latency, latency);
+        stats_out.avg_latency += latency;
+    });
+
+    stats_out.edge_count = static_cast<int>(edges.size());
+    if (stats_out.edge_count > 0) {
+        stats_out.avg_elev /= stats_out.edge_count;
+        stats_out.avg_latency /= stats_out.edge_count;
+    } else {
+        stats_out.min_elev = stats_out.max_elev = 0.0;
+        stats_out.min_latency = stats_out.max_latency = 0.0;
+    }
+    return edges;
+}
+
+// ---- Top-k satellites per station ----
+// Beam planners want the best few satellites per station, not every
+// edge. Each station keeps a k-slot heap (worst candidate on top) that
+// the kernel pass feeds directly, so memory is stations * k edges
+// instead of stations * degree, and slant range is only computed for
+// pairs that can still make the cut when ranking by elevation.
+enum class TopKBy { ELEVATION, LATENCY };
+
+// True if `a` ranks ahead of `b`; ties go to the lower satellite id
+inline bool ranksAhead(const VisibilityEdge& a, const VisibilityEdge& b, TopKBy by) {
+    if (by == TopKBy::ELEVATION) {
+        if (a.elevation_deg != b.elevation_deg) return a.elevation_deg > b.elevation_deg;
+    } else if (a.latency_ms != b.latency_ms) {
+        return a.latency_ms < b.latency_ms;
+    }
+    return a.satellite_id < b.satellite_id;
+}
+
+struct TopKEdges {
+    int k = 0;
+    std::vector<VisibilityEdge> slots;  // station g owns [g * k, g * k + count[g]), best first
+    std::vector<int> count;
+
+    const VisibilityEdge* station(size_t g) const { return slots.data() + g * k; }
+};
+
+TopKEdges topKVisibility(const std::vector<Satellite>& sats,
+                         const std::vector<GroundStation>& stations,
+                         double min_elevation_deg, int k, TopKBy by,
+                         FastVisibilityStats& fast) {
+    TopKEdges top;
+    top.count.assign(stations.size(), 0);
+    if (k < 1) return top;  // no slots: the heap below needs one to compare against
+    top.k = k;
+    top.slots.resize(stations.size() * k);
+    auto ahead = [by](const VisibilityEdge& a, const VisibilityEdge& b) {
+        return ranksAhead(a, b, by);
+    };
+
+    forEachVisiblePair(sats, stations, min_elevation_deg, fast,
+                       [&](size_t i, size_t g, double elev) {
+        const auto& sat = sats[i];
+        VisibilityEdge* heap = &top.slots[g * k];
+        int& n = top.count[g];
+        VisibilityEdge e{sat.id, stations[g].id, elev, 0.0, 0.0};
+        if (n == k && by == TopKBy::ELEVATION && !ranksAhead(e, heap[0], by)) return;
+        e.slant_km = computeSlantRangeKm(stations[g].position, sat.position, sat.altitude_km);
+        e.latency_ms = computeLatencyMs(e.slant_km);
+        if (n < k) {
+            heap[n++] = e;
+            std::push_heap(heap, heap + n, ahead);
+        } else if (ranksAhead(e, heap[0], by)) {
+            std::pop_heap(heap, heap + n, ahead);
+            heap[n - 1] = e;
+            std::push_heap(heap, heap + n, ahead);
+        }
+    });
+
+    for (size_t g = 0; g < stations.size(); g++) {
+        VisibilityEdge* heap = &top.slots[g * k];
+        std::sort_heap(heap, heap + top.count[g], ahead);
+    }
+    return top;
+}
+
+}  // namespace viz
+
+// ============================================================
+// Discrete-event simulation, as in visualizer_data.cpp
+// ============================================================
+namespace viz {
+
+struct VisibilityWindow {
+    int satellite_id;
+    double start_time;
+    double end_time;
+    double peak_signal_quality;
+    double start_signal_quality;
+    double end_signal_quality;
+
+    double duration() const { return end_time - start_time; }
+
+    double signalAt(double t) const {
+        if (t < start_time || t > end_time) return 0.0;
+        double mid = (start_time + end_time) / 2.0;
+        double half = (end_time - start_time) / 2.0;
+        if (half < 1e-6) return peak_signal_quality;
+        double normalized = (t - mid) / half;
+        return peak_signal_quality * (1.0 - 0.3 * normalized * normalized);
+    }
+};
+
+struct HandoffDecision {
+    int from_satellite;
+    int to_satellite;
+    double handoff_time;
+    double overlap_duration;
+    double signal_at_handoff;
+};
+
+struct HandoffResult {
+    std::vector<HandoffDecision> handoffs;
+    std::vector<int> selected_sat_ids;     // satellites in the optimal chain
+    double min_signal_quality = 0.0;
+    double total_coverage_time = 0.0;
+    double total_gap_time = 0.0;
+    int num_handoffs = 0;
+};
+
+class HandoffScheduler {
+public:
+    static constexpr double MIN_OVERLAP_SEC = 2.0;
+    static constexpr double MIN_SIGNAL_DB = 5.0;
+
+    /**
+     * Maximize total coverage time while keeping handoff signal >= MIN_SIGNAL_DB.
+     *
+     * DP formulation:
+     *   dp[i] = maximum coverage time for any schedule ending at window i
+     *   Transition: dp[i] = max over valid j { dp[j] + (windows[i].end - handoff_time(j,i)) }
+     *   Base case: dp[i] = windows[i].duration()
+     *
+     * This is the correct Starlink formulation: you want maximum uptime,
+     * not maximum signal quality.
+     *
+     * Reported coverage and gap time stop at `horizon`, past which the
+     * last pass usually runs on.
+     */
+    static HandoffResult schedule(std::vector<VisibilityWindow> windows,
+                                  double horizon = INFINITY) {
+        HandoffResult result;
+        if (windows.empty()) return result;
+
+        std::sort(windows.begin(), windows.end(),
+                  [](const auto& a, const auto& b) { return a.start_time < b.start_time; });
+
+        int n = static_cast<int>(windows.size());
+        // dp[i] = max coverage time for schedule ending at window i
+        std::vector<double> dp(n, 0.0);
+        std::vector<int> parent(n, -1);
+        // Track the handoff time into each window (start of coverage for window i)
+        std::vector<double> entry_time(n, 0.0);
+
+        for (int i = 0; i < n; i++) {
+            dp[i] = windows[i].duration();
+            entry_time[i] = windows[i].start_time;
+        }
+
+        for (int i = 1; i < n; i++) {
+            for (int j = 0; j < i; j++) {
+                double overlap = windows[j].end_time - windows[i].start_time;
+                if (overlap < MIN_OVERLAP_SEC) continue;
+                if (windows[i].start_time >= windows[j].end_time) continue;
+
+                double t = findOptimalHandoffTime(windows[j], windows[i]);
+                double signal = std::min(windows[j].signalAt(t), windows[i].signalAt(t));
+                if (signal < MIN_SIGNAL_DB) continue;
+
+                // Coverage from this chain: everything up to j's handoff point,
+                // plus window i from handoff time to its end
+                double new_coverage = dp[j] - (windows[j].end_time - t) +
+                                      (windows[i].end_time - t);
+                // Simplified: dp[j] + (windows[i].end_time - windows[j].end_time)
+                // But we need the handoff to happen within the overlap, so:
+                double candidate = dp[j] + (windows[i].end_time - t) -
+                                   (windows[j].end_time - t);
+
+                if (candidate > dp[i]) {
+                    dp[i] = candidate;
+                    parent[i] = j;
+                    entry_time[i] = t;
+                }
+            }
+        }
+
+        // Find the schedule with maximum coverage
+        int best_end = 0;
+        for (int i = 1; i < n; i++) {
+            if (dp[i] > dp[best_end]) best_end = i;
+        }
+
+        std::vector<int> selected;
+        int cur = best_end;
+        while (cur != -1) {
+            selected.push_back(cur);
+            cur = parent[cur];
+        }
+        std::reverse(selected.begin(), selected.end());
+
+        result.total_coverage_time = dp[best_end];
+        result.num_handoffs = static_cast<int>(selected.size()) - 1;
+        for (int idx : selected) {
+            result.selected_sat_ids.push_back(windows[idx].satellite_id);
+        }
+
+        // Build handoff decisions and compute min signal
+        double min_signal = 1e9;
+        for (int k = 0; k + 1 < static_cast<int>(selected.size()); k++) {
+            int a = selected[k];
+            int b = selected[k + 1];
+            double t = findOptimalHandoffTime(windows[a], windows[b]);
+            double overlap = windows[a].end_time - windows[b].start_time;
+            double signal = std::min(windows[a].signalAt(t), windows[b].signalAt(t));
+            min_signal = std::min(min_signal, signal);
+            result.handoffs.push_back({
+                windows[a].satellite_id,
+                windows[b].satellite_id,
+                t,
+                overlap,
+                signal
+            });
+        }
+
+        result.min_signal_quality = min_signal < 1e8 ? min_signal : 0.0;
+
+        // Clip each window's serving span (entry to exit handoff) to the horizon
+        if (horizon < windows[best_end].end_time) {
+            result.total_coverage_time = 0.0;
+            for (size_t k = 0; k < selected.size(); k++) {
+                double from = entry_time[selected[k]];
+                double to = k + 1 < selected.size() ? result.handoffs[k].handoff_time
+                                                    : windows[selected[k]].end_time;
+                result.total_coverage_time += std::max(0.0, std::min(to, horizon) - from);
+            }
+        }
+
+        // Compute gap time over the full timeline
+        if (!selected.empty()) {
+            double total_time = std::min(windows[selected.back()].end_time, horizon) -
+                                windows[selected.front()].start_time;
+            result.total_gap_time = std::max(0.0, total_time - result.total_coverage_time);
+        }
+
+        return result;
+    }
+
+private:
+    static double findOptimalHandoffTime(const VisibilityWindow& from,
+                                         const VisibilityWindow& to) {
+        double overlap_start = std::max(from.start_time, to.start_time);
+        double overlap_end = std::min(from.end_time, to.end_time);
+        if (overlap_start >= overlap_end) {
+            return (from.end_time + to.start_time) / 2.0;
+        }
+
+        double lo = overlap_start, hi = overlap_end;
+        for (int iter = 0; iter < 50; iter++) {
+            double mid = (lo + hi) / 2.0;
+            if (from.signalAt(mid) > to.signalAt(mid)) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        return (lo + hi) / 2.0;
+    }
+};
+
+template<typename Trig>
+Satellite walkerSatellite(int id, int plane, int shell_idx, double altitude_km,
+                          double sin_inc, double cos_inc,
+                          double raan_deg, double u_rad) {
+    double sin_u = Trig::sin(u_rad);
+    double cos_u = Trig::cos(u_rad);
+
+    // Proper Keplerian projection
+    double lat_rad = Trig::asin(sin_inc * sin_u);
+    double lon_offset = Trig::atan2(cos_inc * sin_u, cos_u);
+    double lon_deg = raan_deg + lon_offset * RAD_TO_DEG;
+
+    // Normalize longitude to [-180, 180]
+    lon_deg = std::fmod(lon_deg + 540.0, 360.0) - 180.0;
+    double lat_deg = lat_rad * RAD_TO_DEG;
+
+    Vec3 pos = geoTo3D<double, Trig>(lat_deg, lon_deg, altitude_km);
+    return {id, {lat_deg, lon_deg}, altitude_km, plane, shell_idx, 250.0,
+            pos.x, pos.y, pos.z};
+}
+
+struct ShellSpec {
+    const char* name;
+    int num_planes;
+    int sats_per_plane;
+    double altitude_km;
+    double inclination_deg;
+};
+
+constexpr ShellSpec STARLINK_SHELLS[] = {
+    {"Gen1 Main",   72, 22, 550.0, 53.0},
+    {"Gen1 Backup", 72, 22, 540.0, 53.2},
+    {"Polar",       36, 20, 570.0, 70.0},
+    {"SSO",          6, 58, 560.0, 97.6},
+    {"Gen2",       120, 45, 525.0, 53.0},
+};
+
+// Rise, set and handoff are the only events that lead to a message
+// another station can see (an attach or release at a satellite)
+constexpr bool desSendsMessages(DesEventType type) {
+    return type == DesEventType::RISE || type == DesEventType::SET ||
+           type == DesEventType::HANDOFF;
+}
+
+// Simulated clock over a calendar queue
+class DesEngine {
+public:
+    double now() const { return now_; }
+    size_t pending() const { return queue_.size(); }
+    uint64_t processed(DesEventType type) const { return counts_[static_cast<int>(type)]; }
+
+    void schedule(const DesEvent& ev) {
+        queue_.push(ev);
+        if (desSendsMessages(ev.type)) message_times_.push(ev.time);
+    }
+
+    // Next event earlier than `until`, advancing the clock to it
+    bool next(double until, DesEvent& ev) {
+        const DesEvent* f = queue_.front();
+        if (!f || f->time >= until) return false;
+        ev = queue_.pop();
+        now_ = ev.time;
+        counts_[static_cast<int>(ev.type)]++;
+        if (desSendsMessages(ev.type)) message_times_.pop();  // it was the earliest
+        return true;
+    }
+
+    // Time of the earliest pending event that may send a message
+    double nextMessageTime() const {
+        return message_times_.empty() ? INFINITY : message_times_.top();
+    }
+
+private:
+    CalendarQueue queue_;
+    std::priority_queue<double, std::vector<double>, std::greater<double>> message_times_;
+    double now_ = 0.0;
+    uint64_t counts_[static_cast<int>(DesEventType::COUNT)] = {};
+};
+
+/**
+ * Stations attached to each satellite, as the satellite sees it.
+ * Attach and release messages reach the satellite one link latency
+ * after the station sends them, so a station choosing a satellite at
+ * time t sees exactly the messages that arrived by t.
+ */
+class SatLoadBoard {
+public:
+    SatLoadBoard() = default;
+    explicit SatLoadBoard(size_t num_sats) : base_(num_sats, 0), pending_(num_sats) {}
+
+    void post(int sat, double arrival, int delta) {
+        if (pending_[sat].empty()) dirty_.push_back(sat);
+        pending_[sat].push_back({arrival, delta});
+    }
+
+    int loadAt(int sat, double t) const {
+        int load = base_[sat];
+        for (const auto& m : pending_[sat]) {
+            if (m.arrival <= t) load += m.delta;
+        }
+        return load;
+    }
+
+    // Folds messages that arrived by `t` into the counts; nobody may
+    // ask about an earlier time afterwards
+    void settle(double t) {
+        size_t kept = 0;
+        for (int sat : dirty_) {
+            auto& msgs = pending_[sat];
+            auto later = std::partition(msgs.begin(), msgs.end(),
+                                        [&](const Message& m) { return m.arrival <= t; });
+            for (auto it = msgs.begin(); it != later; ++it) base_[sat] += it->delta;
+            msgs.erase(msgs.begin(), later);
+            if (!msgs.empty()) dirty_[kept++] = sat;
+        }
+        dirty_.resize(kept);
+    }
+
+private:
+    struct Message {
+        double arrival;
+        int delta;
+    };
+
+    std::vector<int> base_;
+    std::vector<std::vector<Message>> pending_;
+    std::vector<int> dirty_;  // satellites with pending messages
+};
+
+struct DesConfig {
+    double duration_sec = 3600.0;
+    double tick_sec = 10.0;           // orbit propagation step
+    double packet_rate = 50.0;        // packets/s per station (Poisson)
+    double drop_prob = 0.03;
+    double jitter_ms = 0.5;           // queueing jitter on top of the slant delay
+    double reorder_timeout_ms = 10.0;
+    int beams = 8;                    // stations one satellite can serve
+    double min_elevation_deg = 25.0;
+    unsigned seed = 42;
+    bool plan = false;                // HandoffScheduler over each station's passes
+};
+
+struct DesStationStats {
+    uint64_t sent = 0;         // transmitted via a satellite
+    uint64_t carried = 0;      // ... and not dropped on the way
+    uint64_t outage = 0;       // generated while no satellite was serving
+    uint64_t delivered = 0;    // released in order by the reorder buffer
+    uint64_t reordered = 0;    // arrived ahead of a gap
+    uint64_t late = 0;         // arrived after its gap was skipped
+    uint64_t lost = 0;         // skipped by a reorder timeout
+    uint64_t handoffs = 0;
+    uint64_t blocked = 0;      // handoffs with every visible satellite full
+    double latency_ms_sum = 0.0;
+    double served_sec = 0.0;   // time with a serving satellite
+    double planned_sec = 0.0;  // HandoffScheduler's coverage over the same passes
+};
+
+// Per-station state; touched only by that station's events
+struct DesStation {
+    Vec3 unit;
+    std::vector<int> visible;   // risen and not yet set
+    std::vector<size_t> open;   // visible[i]'s entry in `passes`
+    std::vector<VisibilityWindow> passes;  // every rise/set seen, for the planner
+    std::vector<double> peak_dot;          // per pass, highest sampled
+    int serving = -1;
+    double serving_since = 0.0;
+    bool handoff_pending = false;
+    uint64_t next_seq = 0;      // event tie-break counter
+    uint64_t next_packet = 0;   // packet numbers handed out so far
+    uint64_t expected = 0;      // reorder buffer: next packet to release
+    std::set<uint64_t> held;
+    bool timeout_pending = false;
+    DesStationStats stats;
+};
+
+/**
+ * The scenario: the Starlink shells propagated in time (circular
+ * Keplerian orbits under a rotating Earth), stations that hand off to
+ * the highest satellite with a free beam when theirs sets (their own
+ * online rule, not HandoffScheduler's offline plan), and a Poisson
+ * packet stream per station whose delay follows the serving satellite's
+ * slant range, through a reorder buffer with a gap timeout.
+ *
+ * Satellite positions are sampled every tick; in between, each pair's
+ * dot product is interpolated linearly, which places rise/set crossings
+ * and slant ranges well inside a second for 10 s ticks.
+ */
+class DesSimulation {
+public:
+    // Signal stand-in for the planner: 8 dB at the elevation mask up to
+    // 25 dB overhead, the range of the synthetic handoff windows
+    static constexpr double PASS_SIGNAL_MIN_DB = 8.0;
+    static constexpr double PASS_SIGNAL_MAX_DB = 25.0;
+
+    DesSimulation(const DesConfig& cfg, const std::vector<GroundStation>& stations)
+        : cfg_(cfg), packet_rng_(cfg.seed, DES_PACKET_STREAM) {
+        for (const auto& spec : STARLINK_SHELLS) {
+            double a = EARTH_RADIUS_KM + spec.altitude_km;
+            double inc = spec.inclination_deg * DEG_TO_RAD;
+            double phase_per_plane = 360.0 / (spec.num_planes * spec.sats_per_plane);
+            double threshold = coverageCos(spec.altitude_km, cfg.min_elevation_deg);
+            for (int p = 0; p < spec.num_planes; p++) {
+                for (int s = 0; s < spec.sats_per_plane; s++) {
+                    double u_deg = (360.0 / spec.sats_per_plane) * s + phase_per_plane * p;
+                    orbits_.push_back({(360.0 / spec.num_planes) * p, u_deg * DEG_TO_RAD,
+                                       std::sin(inc), std::cos(inc), spec.altitude_km,
+                                       std::sqrt(EARTH_MU / (a * a * a)), threshold});
+                }
+            }
+        }
+        for (const auto& gs : stations) {
+            DesStation st;
+            st.unit = geoTo3D<double>(gs.position.lat_deg, gs.position.lon_deg, 0.0);
+            stations_.push_back(std::move(st));
+        }
+        pos0_.resize(orbits_.size());
+        pos1_.resize(orbits_.size());
+        board_ = SatLoadBoard(orbits_.size());
+        propagate(0.0, pos1_);
+    }
+
+    size_t numStations() const { return stations_.size(); }
+    size_t numSatellites() const { return orbits_.size(); }
+    const DesStationStats& stats(size_t s) const { return stations_[s].stats; }
+    const DesConfig& config() const { return cfg_; }
+
+    // Shortest delay of any attach/release: straight up to the lowest shell
+    static double minLinkDelaySec() {
+        double lowest = STARLINK_SHELLS[0].altitude_km;
+        for (const auto& spec : STARLINK_SHELLS) lowest = std::min(lowest, spec.altitude_km);
+        return computeLatencyMs(lowest) / 1000.0;
+    }
+
+    // Parallel runs: messages from station s collect in its worker's
+    // outbox and reach the load board between windows
+    void partition(const std::vector<int>& owner, int workers) {
+        owner_ = owner;
+        outboxes_.assign(workers, {});
+    }
+
+    void deliverOutboxes() {
+        for (auto& box : outboxes_) {
+            for (const auto& m : box) board_.post(m.sat, m.arrival, m.delta);
+            box.clear();
+        }
+    }
+
+    void settleBoard(double t) { board_.settle(t); }
+
+    // Events every run starts with: the first tick, each first packet
+    void seed(DesEngine& eng) {
+        eng.schedule({0.0, -1, -1, tick_seq_++, 0, DesEventType::ORBIT_TICK});
+        for (size_t s = 0; s < stations_.size(); s++) seedStation(eng, static_cast<int>(s));
+    }
+
+    void seedStation(DesEngine& eng, int s) {
+        double t = packetGap(s, 0);
+        if (t < cfg_.duration_sec) post(eng, t, s, DesEventType::PACKET_SEND, -1, 0);
+    }
+
+    void handle(DesEngine& eng, const DesEvent& ev) {
+        if (ev.type == DesEventType::ORBIT_TICK) {
+            advanceOrbits(ev.time);
+            for (size_t s = 0; s < stations_.size(); s++) {
+                scheduleCrossings(eng, static_cast<int>(s), ev.time);
+            }
+            board_.settle(ev.time);
+            if (ev.time + cfg_.tick_sec < cfg_.duration_sec) {
+                eng.schedule({ev.time + cfg_.tick_sec, -1, -1, tick_seq_++, 0,
+                              DesEventType::ORBIT_TICK});
+            }
+            return;
+        }
+        handleStation(eng, ev);
+    }
+
+    // Tick, constellation half: snapshots for [t, t + tick]
+    void advanceOrbits(double t) {
+        tick_start_ = t;
+        std::swap(pos0_, pos1_);
+        propagate(t + cfg_.tick_sec, pos1_);
+    }
+
+    // Tick, station half: rise/set crossings of station `s` in (t, t + tick]
+    void scheduleCrossings(DesEngine& eng, int s, double t) {
+        DesStation& st = stations_[s];
+        const Vec3& u = st.unit;
+        for (size_t i = 0; i < st.visible.size(); i++) {
+            double& peak = st.peak_dot[st.open[i]];
+            peak = std::max(peak, dot(u, pos1_[st.visible[i]]));
+        }
+        for (size_t i = 0; i < orbits_.size(); i++) {
+            double thr = orbits_[i].threshold;
+            double d0 = dot(u, pos0_[i]);
+            double d1 = dot(u, pos1_[i]);
+            int sat = static_cast<int>(i);
+            if (t == 0.0 && d0 >= thr) post(eng, 0.0, s, DesEventType::RISE, sat, 0);
+            if (d0 < thr && d1 >= thr) {
+                post(eng, t + cfg_.tick_sec * (thr - d0) / (d1 - d0), s, DesEventType::RISE, sat, 0);
+            } else if (d0 >= thr && d1 < thr) {
+                post(eng, t + cfg_.tick_sec * (d0 - thr) / (d0 - d1), s, DesEventType::SET, sat, 0);
+            }
+        }
+    }
+
+    void handleStation(DesEngine& eng, const DesEvent& ev) {
+        DesStation& st = stations_[ev.station];
+        switch (ev.type) {
+        case DesEventType::RISE:
+            st.visible.push_back(ev.satellite);
+            st.open.push_back(st.passes.size());
+            st.passes.push_back({ev.satellite, ev.time, cfg_.duration_sec, 0.0, 0.0, 0.0});
+            st.peak_dot.push_back(std::max(orbits_[ev.satellite].threshold,
+                                           dot(st.unit, pos1_[ev.satellite])));
+            if (st.serving < 0) requestHandoff(eng, ev.station, ev.time);
+            break;
+        case DesEventType::SET: {
+            auto it = std::find(st.visible.begin(), st.visible.end(), ev.satellite);
+            if (it != st.visible.end()) {
+                size_t i = static_cast<size_t>(it - st.visible.begin());
+                st.passes[st.open[i]].end_time = ev.time;
+                st.visible.erase(it);
+                st.open.erase(st.open.begin() + static_cast<std::ptrdiff_t>(i));
+            }
+            if (st.serving == ev.satellite) requestHandoff(eng, ev.station, ev.time);
+            break;
+        }
+        case DesEventType::HANDOFF:
+            handoff(ev.station, ev.time);
+            break;
+        case DesEventType::PACKET_SEND:
+            sendPacket(eng, ev.station, ev.time, ev.data);
+            break;
+        case DesEventType::PACKET_ARRIVAL:
+            receivePacket(eng, ev.station, ev.time, ev.data);
+            break;
+        case DesEventType::TIMEOUT:
+            st.timeout_pending = false;
+            if (ev.data == st.expected && !st.held.empty()) {
+                st.stats.lost += *st.held.begin() - st.expected;
+                st.expected = *st.held.begin();
+                release(st);
+            }
+            armTimeout(eng, ev.station, ev.time);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // After a run: closes the last service interval and, with `plan`,
+    // runs HandoffScheduler over each station's passes (no beam limit).
+    // The plan is quadratic in a station's passes, hence opt-in
+    void finish() {
+        for (DesStation& st : stations_) {
+            if (st.serving >= 0) st.stats.served_sec += cfg_.duration_sec - st.serving_since;
+            if (!cfg_.plan) continue;
+            for (size_t k = 0; k < st.passes.size(); k++) {
+                VisibilityWindow& w = st.passes[k];
+                w.peak_signal_quality = passSignalDb(w.satellite_id, st.peak_dot[k]);
+                w.start_signal_quality = w.signalAt(w.start_time);
+                w.end_signal_quality = w.signalAt(w.end_time);
+            }
+            st.stats.planned_sec =
+                HandoffScheduler::schedule(st.passes, cfg_.duration_sec).total_coverage_time;
+        }
+    }
+
+private:
+    static constexpr double EARTH_MU = 398600.4418;                 // km^3/s^2
+    static constexpr double EARTH_ROTATION_DEG_S = 360.0 / 86164.0905;
+    static constexpr uint64_t DES_PACKET_STREAM = 1ull << 32;       // clear of MC streams
+
+    struct Orbit {
+        double raan_deg;
+        double u_rad;
+        double sin_inc, cos_inc;
+        double altitude_km;
+        double mean_motion;   // rad/s
+        double threshold;     // coverageCos at the elevation mask
+    };
+
+    static double dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+    // Pass signal from its highest elevation, given as the cosine of the
+    // station-satellite central angle
+    double passSignalDb(int sat, double peak_dot) const {
+        const double R = EARTH_RADIUS_KM;
+        double r = R + orbits_[sat].altitude_km;
+        double d = std::min(peak_dot, 1.0);
+        double elev_deg = std::atan2(r * d - R, r * std::sqrt(1.0 - d * d)) / DEG_TO_RAD;
+        double f = (elev_deg - cfg_.min_elevation_deg) / (90.0 - cfg_.min_elevation_deg);
+        return PASS_SIGNAL_MIN_DB +
+               (PASS_SIGNAL_MAX_DB - PASS_SIGNAL_MIN_DB) * std::clamp(f, 0.0, 1.0);
+    }
+
+    // Unit sub-satellite vectors at time t
+    void propagate(double t, std::vector<Vec3>& out) {
+        for (size_t i = 0; i < orbits_.size(); i++) {
+            const Orbit& o = orbits_[i];
+            Satellite sat = walkerSatellite<LibmTrig>(
+                static_cast<int>(i), 0, 0, o.altitude_km, o.sin_inc, o.cos_inc,
+                o.raan_deg - EARTH_ROTATION_DEG_S * t, o.u_rad + o.mean_motion * t);
+            out[i] = geoTo3D<double>(sat.position.lat_deg, sat.position.lon_deg, 0.0);
+        }
+    }
+
+    void post(DesEngine& eng, double t, int s, DesEventType type, int sat, uint64_t data) {
+        eng.schedule({t, s, sat, stations_[s].next_seq++, data, type});
+    }
+
+    // One-way delay station <-> satellite at time t within the current tick
+    double linkDelayMs(int s, int sat, double t) const {
+        double f = std::clamp((t - tick_start_) / cfg_.tick_sec, 0.0, 1.0);
+        const Vec3& u = stations_[s].unit;
+        double d = dot(u, pos0_[sat]) + (dot(u, pos1_[sat]) - dot(u, pos0_[sat])) * f;
+        const double R = EARTH_RADIUS_KM;
+        double r = R + orbits_[sat].altitude_km;
+        return computeLatencyMs(std::sqrt(R * R + r * r - 2.0 * R * r * d));
+    }
+
+    void requestHandoff(DesEngine& eng, int s, double t) {
+        if (stations_[s].handoff_pending) return;
+        stations_[s].handoff_pending = true;
+        post(eng, t, s, DesEventType::HANDOFF, -1, 0);
+    }
+
+    // Highest satellite (by end-of-tick elevation) with a free beam;
+    // release and attach are both sent now, make-before-break
+    void handoff(int s, double t) {
+        DesStation& st = stations_[s];
+        st.handoff_pending = false;
+        int best = -1;
+        double best_dot = -2.0;
+        for (int sat : st.visible) {
+            if (sat == st.serving) continue;
+            double d = dot(st.unit, pos1_[sat]);
+            if (d > best_dot && board_.loadAt(sat, t) < cfg_.beams) {
+                best = sat;
+                best_dot = d;
+            }
+        }
+        if (best < 0 && st.serving >= 0 &&
+            std::find(st.visible.begin(), st.visible.end(), st.serving) != st.visible.end()) {
+            return;  // nothing better and the current one is still up
+        }
+        if (st.serving >= 0) {
+            sendLoad(s, st.serving, t + linkDelayMs(s, st.serving, t) / 1000.0, -1);
+            st.stats.served_sec += t - st.serving_since;
+        }
+        if (best >= 0) {
+            sendLoad(s, best, t + linkDelayMs(s, best, t) / 1000.0, +1);
+            st.stats.handoffs++;
+        } else {
+            st.stats.blocked++;
+        }
+        st.serving = best;
+        st.serving_since = t;
+    }
+
+    void sendLoad(int s, int sat, double arrival, int delta) {
+        if (owner_.empty()) {
+            board_.post(sat, arrival, delta);
+        } else {
+            outboxes_[owner_[s]].push_back({sat, arrival, delta});
+        }
+    }
+
+    // Inter-arrival gap before packet k, from block k of the station's stream
+    double packetGap(int s, uint64_t k) const {
+        auto b = packet_rng_.at(packetIndex(s, k));
+        return -std::log(Philox4x32::unit(b[0])) / cfg_.packet_rate;
+    }
+
+    static uint64_t packetIndex(int s, uint64_t k) {
+        return (static_cast<uint64_t>(s) << 32) | k;
+    }
+
+    void sendPacket(DesEngine& eng, int s, double t, uint64_t k) {
+        DesStation& st = stations_[s];
+        auto b = packet_rng_.at(packetIndex(s, k));
+        if (st.serving < 0) {
+            st.stats.outage++;
+        } else {
+            uint64_t seq = st.next_packet++;
+            st.stats.sent++;
+            if (Philox4x32::unit(b[1]) >= cfg_.drop_prob) {
+                double delay_ms = linkDelayMs(s, st.serving, t) +
+                                  cfg_.jitter_ms * Philox4x32::unit(b[2]);
+                st.stats.carried++;
+                st.stats.latency_ms_sum += delay_ms;
+                post(eng, t + delay_ms / 1000.0, s, DesEventType::PACKET_ARRIVAL,
+                     st.serving, seq);
+            }
+        }
+        double next = t + packetGap(s, k + 1);
+        if (next < cfg_.duration_sec) post(eng, next, s, DesEventType::PACKET_SEND, -1, k + 1);
+    }
+
+    void receivePacket(DesEngine& eng, int s, double t, uint64_t seq) {
+        DesStation& st = stations_[s];
+        if (seq < st.expected) {
+            st.stats.late++;
+            return;
+        }
+        if (seq == st.expected) {
+            st.stats.delivered++;
+            st.expected++;
+            release(st);
+        } else {
+            st.held.insert(seq);
+            st.stats.reordered++;
+        }
+        armTimeout(eng, s, t);
+    }
+
+    // Releases the run of held packets that now continues the sequence
+    static void release(DesStation& st) {
+        while (!st.held.empty() && *st.held.begin() == st.expected) {
+            st.held.erase(st.held.begin());
+            st.stats.delivered++;
+            st.expected++;
+        }
+    }
+
+    // One timeout at a time, for the gap at the head of the buffer
+    void armTimeout(DesEngine& eng, int s, double t) {
+        DesStation& st = stations_[s];
+        if (st.timeout_pending || st.held.empty()) return;
+        st.timeout_pending = true;
+        post(eng, t + cfg_.reorder_timeout_ms / 1000.0, s, DesEventType::TIMEOUT, -1,
+             st.expected);
+    }
+
+    DesConfig cfg_;
+    Philox4x32 packet_rng_;
+    std::vector<Orbit> orbits_;
+    std::vector<DesStation> stations_;
+    std::vector<Vec3> pos0_, pos1_;   // unit vectors at tick start and end
+    double tick_start_ = 0.0;
+    uint64_t tick_seq_ = 0;
+    SatLoadBoard board_;
+
+    struct LoadMessage {
+        int sat;
+        double arrival;
+        int delta;
+    };
+    std::vector<int> owner_;                      // station -> worker, parallel runs only
+    std::vector<std::vector<LoadMessage>> outboxes_;
+};
+
+// Event counts and wall time of one run
+struct DesRun {
+    uint64_t counts[static_cast<int>(DesEventType::COUNT)] = {};
+    uint64_t windows = 0;   // parallel runs: synchronization rounds
+    double wall_sec = 0.0;
+
+    void add(const DesEngine& eng) {
+        for (int t = 0; t < static_cast<int>(DesEventType::COUNT); t++) {
+            counts[t] += eng.processed(static_cast<DesEventType>(t));
+        }
+    }
+
+    uint64_t events() const {
+        uint64_t n = 0;
+        for (uint64_t c : counts) n += c;
+        return n;
+    }
+};
+
+DesRun runDesSequential(DesSimulation& sim) {
+    DesRun run;
+    auto start = std::chrono::steady_clock::now();
+    DesEngine eng;
+    sim.seed(eng);
+    DesEvent ev;
+    while (eng.next(INFINITY, ev)) sim.handle(eng, ev);
+    run.wall_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    run.add(eng);
+    sim.finish();
+    return run;
+}
+
+// Reusable barrier; the last thread to arrive runs `serial` before
+// anyone is released
+class DesBarrier {
+public:
+    explicit DesBarrier(int parties) : parties_(parties) {}
+
+    template<typename F>
+    void wait(F&& serial) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        uint64_t generation = generation_;
+        if (++arrived_ == parties_) {
+            serial();
+            arrived_ = 0;
+            generation_++;
+            cv_.notify_all();
+            return;
+        }
+        cv_.wait(lock, [&] { return generation_ != generation; });
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    int parties_;
+    int arrived_ = 0;
+    uint64_t generation_ = 0;
+};
+
+/**
+ * Conservative parallel run. Stations are split into contiguous blocks,
+ * one event queue per worker; stations only affect each other through
+ * satellite load messages, which take at least minLinkDelaySec() to
+ * arrive. Each round every worker reports its earliest pending event
+ * that may send one (rise, set, handoff); no message sent from then on
+ * can arrive before that time plus the minimum delay, so all workers
+ * run freely up to the earliest such bound (or the next orbit tick),
+ * then meet at a barrier where the messages are handed to the load
+ * board and the tick, if due, is taken.
+ *
+ * Each station still sees its own events in (time, seq) order and the
+ * same board answers, so the results match runDesSequential bit for bit.
+ */
+DesRun runDesParallel(DesSimulation& sim, int workers) {
+    const DesConfig& cfg = sim.config();
+    const int n = static_cast<int>(sim.numStations());
+    workers = std::max(1, std::min(workers, n));
+    // A hair under the true minimum, so rounding in the slant range
+    // can never put a message inside the window that sent it
+    const double lookahead = 0.999 * DesSimulation::minLinkDelaySec();
+
+    std::vector<int> owner(n);
+    std::vector<std::vector<int>> mine(workers);
+    for (int s = 0; s < n; s++) {
+        owner[s] = static_cast<int>(static_cast<int64_t>(s) * workers / n);
+        mine[owner[s]].push_back(s);
+    }
+    sim.partition(owner, workers);
+
+    DesRun run;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<DesEngine> engines(workers);
+    for (int w = 0; w < workers; w++) {
+        for (int s : mine[w]) sim.seedStation(engines[w], s);
+    }
+
+    // Round state, written only by the barrier's serial step
+    auto tickAfter = [&](double t) {
+        return t + cfg.tick_sec < cfg.duration_sec ? t + cfg.tick_sec : INFINITY;
+    };
+    double tick = 0.0;                 // tick whose crossings this round schedules
+    bool tick_due = true;
+    double next_tick = tickAfter(0.0);
+    double window_end = 0.0;
+    bool done = false;
+    uint64_t ticks = 1;
+    sim.advanceOrbits(0.0);
+
+    auto openWindow = [&] {
+        double bound = INFINITY;
+        bool idle = true;
+        for (const auto& eng : engines) {
+            bound = std::min(bound, eng.nextMessageTime());
+            idle = idle && eng.pending() == 0;
+        }
+        window_end = std::min(next_tick, bound + lookahead);
+        done = idle && next_tick == INFINITY;
+        if (!done) run.windows++;
+    };
+    auto closeWindow = [&] {
+        sim.deliverOutboxes();
+        tick_due = next_tick != INFINITY && window_end == next_tick;
+        if (tick_due) {
+            tick = next_tick;
+            sim.advanceOrbits(tick);
+            sim.settleBoard(tick);
+            next_tick = tickAfter(tick);
+            ticks++;
+        }
+    };
+
+    DesBarrier barrier(workers);
+    auto work = [&](int w) {
+        DesEngine& eng = engines[w];
+        DesEvent ev;
+        for (;;) {
+            if (tick_due) {
+                for (int s : mine[w]) sim.scheduleCrossings(eng, s, tick);
+            }
+            barrier.wait(openWindow);
+            if (done) break;
+            while (eng.next(window_end, ev)) sim.handleStation(eng, ev);
+            barrier.wait(closeWindow);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int w = 1; w < workers; w++) threads.emplace_back(work, w);
+    work(0);
+    for (auto& t : threads) t.join();
+
+    run.wall_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (const auto& eng : engines) run.add(eng);
+    run.counts[static_cast<int>(DesEventType::ORBIT_TICK)] = ticks;
+    sim.finish();
+    return run;
 }
 
+}  // namespace viz
+
 // ============================================================
 // Test Cases
 // ============================================================
@@ -110,6 +3195,810 @@ void test_elevation_symmetry() {
     std::cout << "  PASS: elevation symmetry: " << elev1 << "° vs " << elev2 << "°\n";
 }
 
+// Error in units of the last place of the correctly rounded result
+double ulpError(double got, long double ref) {
+    double r = std::abs(static_cast<double>(ref));
+    if (r == 0.0) return got == 0.0 ? 0.0 : 1e300;
+    double ulp = std::nextafter(r, INFINITY) - r;
+    return static_cast<double>(std::fabs(static_cast<long double>(got) - ref)) / ulp;
+}
+
+// xorshift64: deterministic arguments without <random> distributions
+double uniform(uint64_t& s, double lo, double hi) {
+    s ^= s << 13;
+    s ^= s >> 7;
+    s ^= s << 17;
+    return lo + (hi - lo) * static_cast<double>(s >> 11) * (1.0 / 9007199254740992.0);
+}
+
+void test_poly_trig_ulp_bounds() {
+    constexpr int SAMPLES = 1000000;
+    uint64_t s = 88172645463325252ull;
+    double sin_err = 0, cos_err = 0, asin_err = 0, acos_err = 0, atan2_err = 0;
+    for (int i = 0; i < SAMPLES; i++) {
+        double x = uniform(s, -1.0, 1.0) * (i % 2 ? 10.0 : 1e5);
+        sin_err = std::max(sin_err, ulpError(PolyTrig::sin(x), std::sin(static_cast<long double>(x))));
+        cos_err = std::max(cos_err, ulpError(PolyTrig::cos(x), std::cos(static_cast<long double>(x))));
+        double a = uniform(s, -1.0, 1.0) * (i % 4 ? 1.0 : 1e-3);
+        asin_err = std::max(asin_err, ulpError(PolyTrig::asin(a), std::asin(static_cast<long double>(a))));
+        acos_err = std::max(acos_err, ulpError(PolyTrig::acos(a), std::acos(static_cast<long double>(a))));
+        double y = uniform(s, -100.0, 100.0), xx = uniform(s, -100.0, 100.0);
+        atan2_err = std::max(atan2_err, ulpError(PolyTrig::atan2(y, xx),
+            std::atan2(static_cast<long double>(y), static_cast<long double>(xx))));
+    }
+    assert(sin_err < 2.5 && cos_err < 2.5);
+    assert(asin_err < 3.0 && acos_err < 1.5);
+    assert(atan2_err < 4.5);
+    std::cout << "  PASS: max ulp sin " << sin_err << ", cos " << cos_err
+              << ", asin " << asin_err << ", acos " << acos_err
+              << ", atan2 " << atan2_err << "\n";
+}
+
+void test_poly_trig_edge_cases() {
+    assert(PolyTrig::sin(0.0) == 0.0 && PolyTrig::cos(0.0) == 1.0);
+    assert(PolyTrig::asin(1.0) == std::asin(1.0) && PolyTrig::asin(-1.0) == std::asin(-1.0));
+    assert(PolyTrig::acos(1.0) == 0.0 && PolyTrig::acos(-1.0) == std::acos(-1.0));
+    assert(PolyTrig::atan2(0.0, 0.0) == 0.0);
+    assert(PolyTrig::atan2(0.0, -1.0) == std::atan2(0.0, -1.0));
+    assert(PolyTrig::atan2(-0.0, -1.0) == std::atan2(-0.0, -1.0));
+    std::cout << "  PASS: exact at 0, +-1 and the atan2 axes\n";
+}
+
+void test_poly_elevation_matches_libm() {
+    uint64_t s = 1;
+    double max_diff = 0;
+    for (int i = 0; i < 100000; i++) {
+        GeoCoord station{uniform(s, -60, 60), uniform(s, -180, 180)};
+        GeoCoord sat{uniform(s, -53, 53), uniform(s, -180, 180)};
+        double libm = computeElevationAngle<LibmTrig>(station, sat, 550.0);
+        double poly = computeElevationAngle<PolyTrig>(station, sat, 550.0);
+        max_diff = std::max(max_diff, std::abs(libm - poly));
+    }
+    assert(max_diff < 1e-9);
+    std::cout << "  PASS: poly vs libm elevation, max diff " << max_diff << "°\n";
+}
+
+// Data packets 0..n-1 with distinct headers and payloads
+std::vector<Packet> fecStream(int n) {
+    std::vector<Packet> data;
+    for (int i = 0; i < n; i++) {
+        Packet pkt;
+        pkt.sequence_number = i;
+        pkt.priority = static_cast<Priority>(i % 4);
+        pkt.source_satellite_id = 100 + i;
+        pkt.destination_id = 7;
+        pkt.arrival_time = Clock::now();
+        pkt.payload.assign(20 + i % 5, static_cast<uint8_t>(i));
+        data.push_back(pkt);
+    }
+    return data;
+}
+
+// Encode k-packet blocks, drop `lost`, and decode; returns what came out
+std::vector<Packet> fecRoundTrip(const FecConfig& cfg, int n,
+                                 const std::vector<uint64_t>& lost,
+                                 FecStats& stats) {
+    std::vector<Packet> data = fecStream(n);
+    FecEncoder encoder(cfg);
+    FecDecoder decoder(cfg);
+    std::vector<Packet> out;
+    for (int base = 0; base < n; base += cfg.k) {
+        std::vector<const Packet*> block;
+        for (int i = base; i < std::min(n, base + cfg.k); i++) block.push_back(&data[i]);
+        std::vector<Packet> parity = encoder.encodeBlock(base / cfg.k, block);
+        for (int i = base; i < std::min(n, base + cfg.k); i++) {
+            if (std::count(lost.begin(), lost.end(), data[i].sequence_number)) continue;
+            decoder.receive(Packet(data[i]), out);
+        }
+        for (auto& p : parity) decoder.receive(std::move(p), out);
+    }
+    decoder.finish(n);
+    stats = decoder.stats();
+    return out;
+}
+
+void test_fec_partial_last_block() {
+    // 15 packets at k=8: the last block holds 7, so slot 7 is not a loss
+    for (FecMode mode : {FecMode::XOR, FecMode::REED_SOLOMON}) {
+        FecConfig cfg;
+        cfg.mode = mode;
+        FecStats stats;
+        auto out = fecRoundTrip(cfg, 15, {}, stats);
+        assert(out.size() == 15);
+        for (const Packet& pkt : out) assert(pkt.sequence_number < 15);
+        assert(stats.recovered == 0 && stats.unrecoverable == 0);
+    }
+    std::cout << "  PASS: complete short last block rebuilds nothing\n";
+}
+
+void test_fec_recovers_in_partial_block() {
+    std::vector<Packet> data = fecStream(15);
+    FecConfig cfg;
+    cfg.mode = FecMode::XOR;
+    FecStats stats;
+    auto out = fecRoundTrip(cfg, 15, {12}, stats);
+    assert(out.size() == 15 && stats.recovered == 1 && stats.repaired() == 1);
+    const Packet& rebuilt = out.back();
+    assert(rebuilt.sequence_number == 12);
+    assert(rebuilt.priority == data[12].priority);
+    assert(rebuilt.source_satellite_id == data[12].source_satellite_id);
+    assert(rebuilt.payload == data[12].payload);
+
+    cfg.mode = FecMode::REED_SOLOMON;
+    out = fecRoundTrip(cfg, 11, {8, 10}, stats);
+    assert(out.size() == 11 && stats.repaired() == 2 && stats.unrecoverable == 0);
+    for (const Packet& pkt : out) assert(pkt.sequence_number < 11);
+    std::cout << "  PASS: losses in the short last block rebuilt, XOR and RS\n";
+}
+
+void test_fec_early_rebuild_is_not_a_loss() {
+    // Parity overtakes data packet 3, which arrives after being rebuilt
+    FecConfig cfg;
+    cfg.mode = FecMode::XOR;
+    std::vector<Packet> data = fecStream(8);
+    std::vector<const Packet*> block;
+    for (const Packet& pkt : data) block.push_back(&pkt);
+    auto parity = FecEncoder(cfg).encodeBlock(0, block);
+    FecDecoder decoder(cfg);
+    std::vector<Packet> out;
+    for (int i = 0; i < 8; i++) {
+        if (i != 3) decoder.receive(Packet(data[i]), out);
+    }
+    decoder.receive(std::move(parity[0]), out);
+    decoder.receive(Packet(data[3]), out);
+    decoder.finish(8);
+    assert(out.size() == 8);
+    assert(decoder.stats().recovered == 1 && decoder.stats().rebuilt_early == 1);
+    assert(decoder.stats().repaired() == 0 && decoder.stats().duplicates == 0);
+    std::cout << "  PASS: reordered original counted as early rebuild, not repair\n";
+}
+
+void test_handoff_chain_covers_horizon() {
+    constexpr double HORIZON = 3600.0;
+    auto windows = generateWindows(30, HORIZON, 42);
+    auto result = HandoffScheduler::schedule(windows, HORIZON);
+    double first_start = windows.front().start_time;
+    assert(first_start <= 0.0);
+    // Consecutive handoffs, each inside its overlap, and service to the end
+    for (size_t k = 1; k < result.handoffs.size(); k++) {
+        assert(result.handoffs[k].handoff_time > result.handoffs[k - 1].handoff_time);
+        assert(result.handoffs[k].from_satellite == result.handoffs[k - 1].to_satellite);
+    }
+    for (const auto& h : result.handoffs) {
+        assert(h.overlap_duration >= HandoffScheduler::MIN_OVERLAP_SEC);
+    }
+    assert(std::abs(result.total_coverage_time - HORIZON) < 1e-6);
+    assert(result.total_gap_time < 1e-6);
+    std::cout << "  PASS: " << result.num_handoffs << " handoffs cover "
+              << result.total_coverage_time << " s of a " << HORIZON << " s horizon\n";
+}
+
+void test_handoff_prefers_coverage_over_signal() {
+    // Ranking by minimum signal alone would keep the strong first pass
+    // and leave the terminal dark after t=400
+    std::vector<VisibilityWindow> windows = {
+        {0, 0.0, 400.0, 25.0, 15.0, 12.5},
+        {1, 390.0, 800.0, 10.0, 6.0, 5.0},
+    };
+    auto result = HandoffScheduler::schedule(windows, 700.0);
+    assert(result.num_handoffs == 1);
+    assert(result.handoffs[0].from_satellite == 0 && result.handoffs[0].to_satellite == 1);
+    assert(std::abs(result.total_coverage_time - 700.0) < 1e-6);
+    std::cout << "  PASS: handoff to the weaker pass, coverage clipped to "
+              << result.total_coverage_time << " s\n";
+}
+
+void test_philox_known_answers() {
+    // Random123 kat_vectors for philox4x32-10: zeros, ones, digits of pi
+    using Block = Philox4x32::Block;
+    assert((Philox4x32::rounds({0, 0, 0, 0}, {0, 0}) ==
+            Block{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}));
+    assert((Philox4x32::rounds({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+                               {0xffffffff, 0xffffffff}) ==
+            Block{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}));
+    assert((Philox4x32::rounds({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+                               {0xa4093822, 0x299f31d0}) ==
+            Block{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}));
+    std::cout << "  PASS: philox4x32-10 matches the Random123 known answers\n";
+}
+
+void test_philox_counter_layout() {
+    // at(i) is rounds() on (index, stream) with the seed as key
+    Philox4x32 rng(0x0123456789abcdefULL, 7);
+    assert((rng.at(0x100000002ULL) ==
+            Philox4x32::rounds({2, 1, 7, 0}, {0x89abcdef, 0x01234567})));
+    assert(rng.at(0) != Philox4x32(0x0123456789abcdefULL, 8).at(0));
+    std::cout << "  PASS: counter = (index, stream), key = seed\n";
+}
+
+void test_edf_order_across_bucket_wrap() {
+    // 2.54 ms budget: 10 us buckets, so 20 ms of traffic laps the ring ~8 times
+    constexpr double BUDGET_MS = 2.54;
+    const auto width = std::chrono::microseconds(10);
+    EdfCalendarQueue queue(BUDGET_MS);
+    std::multiset<TimePoint> pending;
+    uint64_t s = 12345;
+    TimePoint now = TimePoint(std::chrono::seconds(1));
+    size_t pushed = 0, popped = 0, expired = 0;
+
+    auto popOne = [&]() {
+        int dropped = 0;
+        auto pkt = queue.pop(now, dropped);
+        expired += dropped;
+        if (!pkt) return false;
+        popped++;
+        // On time, and no on-time packet left behind by more than a bucket
+        assert(pkt->deadline >= now);
+        pending.erase(pending.find(pkt->deadline));
+        auto earliest = pending.lower_bound(now);
+        assert(earliest == pending.end() || pkt->deadline <= *earliest + width);
+        return true;
+    };
+
+    for (int step = 0; step < 20000; step++) {
+        now += std::chrono::nanoseconds(1000);
+        for (int n = static_cast<int>(uniform(s, 0.0, 3.0)); n > 0; n--) {
+            Packet pkt{};
+            pkt.sequence_number = pushed;
+            pkt.arrival_time = now - std::chrono::nanoseconds(
+                static_cast<int64_t>(uniform(s, 0.0, BUDGET_MS * 0.9e6)));
+            pending.insert(pkt.arrival_time + std::chrono::nanoseconds(2540000));
+            expired += queue.push(std::move(pkt), now);
+            pushed++;
+        }
+        if (uniform(s, 0.0, 1.0) < 0.9) popOne();
+    }
+    while (popOne()) {}
+    assert(queue.empty());
+    assert(popped + expired == pushed);
+    assert(popped > pushed / 2 && expired > 0);
+    std::cout << "  PASS: " << popped << " popped in deadline order across ring wraps, "
+              << expired << " expired\n";
+}
+
+// Times on a 1/8 s grid convert to whole ticks exactly
+double eighths(uint64_t& s, double lo, double hi) {
+    return std::floor(uniform(s, lo, hi) * 8.0) / 8.0;
+}
+
+void test_window_index_matches_scan() {
+    uint64_t s = 99;
+    size_t queries = 0;
+    for (size_t n : {0, 1, 2, 3, 5, 7, 8, 15, 16, 17, 31, 33, 100, 1000, 1023, 1025, 3000}) {
+        std::vector<VisibilityWindow> windows;
+        for (size_t i = 0; i < n; i++) {
+            double start = eighths(s, 0.0, 10000.0);
+            // Mostly short passes, a few long ones to exercise max_end
+            double len = i % 10 == 0 ? eighths(s, 0.0, 5000.0) : eighths(s, 0.0, 60.0);
+            windows.push_back({static_cast<int>(i), start, start + len, 10.0, 6.0, 5.0});
+        }
+        if (n > 4) {  // tied starts
+            windows[3].start_time = windows[2].start_time;
+            windows[3].end_time = windows[3].start_time + 10.0;
+        }
+        WindowIndex index = WindowIndex::fromWindows(windows);
+        assert(index.size() == n && index.rejected() == 0);
+
+        for (int q = 0; q < 300; q++) {
+            double t0 = eighths(s, -100.0, 15100.0);
+            double t1 = q % 3 == 0 ? t0 : t0 + eighths(s, 0.0, q % 3 == 1 ? 30.0 : 3000.0);
+            std::vector<uint32_t> got, want;
+            if (t0 == t1) {
+                index.stabbing(t0, got);
+            } else {
+                index.overlapping(t0, t1, got);
+            }
+            for (size_t i = 0; i < n; i++) {
+                if (windows[i].start_time <= t1 && t0 <= windows[i].end_time) {
+                    want.push_back(static_cast<uint32_t>(i));
+                }
+            }
+            std::sort(got.begin(), got.end());
+            assert(got == want);
+            queries++;
+        }
+    }
+    std::cout << "  PASS: " << queries << " stabbing and range queries match a linear scan\n";
+}
+
+void test_window_index_counts_out_of_range() {
+    // 49.7 days of millisecond ticks from the earliest start; past that
+    // a window is counted, not silently dropped
+    const double span = UINT32_MAX / WindowIndex::TICKS_PER_SEC;
+    std::vector<VisibilityWindow> windows = {
+        {0, 100.0, 400.0, 10.0, 6.0, 5.0},
+        {1, 50.0 * 86400.0, 50.0 * 86400.0 + 300.0, 10.0, 6.0, 5.0},
+        {2, 100.0 + span - 10.0, 100.0 + span + 10.0, 10.0, 6.0, 5.0},
+        {3, 100.0 + span - 400.0, 100.0 + span - 100.0, 10.0, 6.0, 5.0},
+    };
+    WindowIndex index = WindowIndex::fromWindows(windows);
+    assert(index.size() == 2 && index.rejected() == 2);
+    std::vector<uint32_t> got;
+    index.overlapping(0.0, 100.0 + span, got);
+    std::sort(got.begin(), got.end());
+    assert((got == std::vector<uint32_t>{0, 3}));
+    std::cout << "  PASS: windows past the 49-day range counted as rejected\n";
+}
+
+void test_codel_drop_state_entry_and_exit() {
+    // One packet in and one out per ms over a 50-packet standing queue:
+    // sojourn sits at ~50 ms until CoDel's drops shrink the queue
+    using std::chrono::milliseconds;
+    AqmConfig cfg;
+    CoDelQueue queue;
+    const TimePoint t0 = TimePoint(std::chrono::seconds(1));
+    auto packetAt = [](TimePoint t) {
+        Packet pkt{};
+        pkt.payload.assign(1000, 0);
+        pkt.enqueue_time = t;
+        return pkt;
+    };
+    for (int i = 0; i < 50; i++) queue.push(packetAt(t0));
+
+    std::vector<TimePoint> drop_times;
+    TimePoint last_late{};  // last delivery with sojourn above target
+    uint64_t drops = 0;
+    for (int ms = 1; ms <= 3000; ms++) {
+        TimePoint now = t0 + milliseconds(ms);
+        queue.push(packetAt(now));
+        uint64_t before = drops;
+        auto pkt = queue.pop(now, cfg, drops);
+        for (uint64_t d = before; d < drops; d++) drop_times.push_back(now);
+        assert(pkt);
+        if (now - pkt->enqueue_time >= cfg.target) last_late = now;
+    }
+
+    // Entry: no drop until sojourn has stayed above target for an interval
+    assert(!drop_times.empty());
+    // (the prefilled head first reaches target sojourn at t0 + target)
+    assert(drop_times.front() == t0 + cfg.target + cfg.interval);
+    // One drop state throughout: the control law spaces drops ever closer
+    // (to within the 1 ms step)
+    for (size_t i = 2; i < drop_times.size(); i++) {
+        assert(drop_times[i] - drop_times[i - 1] <=
+               drop_times[i - 1] - drop_times[i - 2] + milliseconds(1));
+    }
+    // Exit: the last drop clears the standing queue, and with sojourn
+    // back under target nothing more is dropped
+    assert(last_late <= drop_times.back());
+    assert(drop_times.back() < t0 + milliseconds(1500));
+    assert(queue.size() <= 5);
+    std::cout << "  PASS: " << drop_times.size() << " drops from "
+              << std::chrono::duration<double, std::milli>(drop_times.front() - t0).count()
+              << " ms to "
+              << std::chrono::duration<double, std::milli>(drop_times.back() - t0).count()
+              << " ms, then none with the queue at " << queue.size() << " packets\n";
+}
+
+void test_backup_chains_are_link_disjoint() {
+    // Two interleaved constellations: a second satellite is usually in view
+    constexpr double HORIZON = 3600.0;
+    auto windows = generateWindows(30, HORIZON, 42);
+    for (auto w : generateWindows(30, HORIZON, 7)) {
+        w.satellite_id += 100;
+        windows.push_back(w);
+    }
+    auto backups = HandoffScheduler::scheduleWithBackups(windows, 3, HORIZON);
+    assert(backups.chains.size() >= 2);
+    for (size_t r = 0; r < backups.serving.size(); r++) {
+        for (size_t q = r + 1; q < backups.serving.size(); q++) {
+            for (const auto& a : backups.serving[r]) {
+                for (const auto& b : backups.serving[q]) {
+                    assert(a.satellite_id != b.satellite_id ||
+                           a.end_time <= b.start_time || b.end_time <= a.start_time);
+                }
+            }
+        }
+    }
+    int failures = 0, covered = 0;
+    for (const auto& seg : backups.serving.front()) {
+        for (double t = seg.start_time; t < std::min(seg.end_time, HORIZON); t += 1.0) {
+            failures++;
+            const auto* backup = backups.failover(seg.satellite_id, t);
+            if (!backup) continue;
+            assert(backup->satellite_id != seg.satellite_id);
+            assert(backup->start_time <= t && t <= backup->end_time);
+            covered++;
+        }
+    }
+    assert(covered > failures / 2);
+    std::cout << "  PASS: " << backups.chains.size() << " disjoint chains, failover for "
+              << covered << " of " << failures << " primary failures\n";
+}
+
+void test_backup_uses_pass_outside_primary_segment() {
+    // One satellite at a time except around the handoff: the alternates
+    // can only use the overlap, on the pass the primary is not serving
+    std::vector<VisibilityWindow> windows = {
+        {0, 0.0, 400.0, 20.0, 12.0, 10.0},
+        {1, 300.0, 800.0, 20.0, 12.0, 10.0},
+    };
+    auto backups = HandoffScheduler::scheduleWithBackups(windows, 3, 800.0);
+    assert(backups.chains.size() == 3);
+    double handoff = backups.chains[0].handoffs.at(0).handoff_time;
+    assert(handoff > 300.0 && handoff < 400.0);
+    auto before = backups.failover(0, handoff - 10.0);
+    auto after = backups.failover(1, handoff + 10.0);
+    assert(before && before->satellite_id == 1);
+    assert(after && after->satellite_id == 0);
+    assert(!backups.failover(0, 200.0) && !backups.failover(1, 500.0));
+    std::cout << "  PASS: failover inside the overlap, on either side of the "
+              << handoff << " s handoff\n";
+}
+
+DesEvent desEvent(uint64_t& s, double t) {
+    DesEvent ev{};
+    ev.time = t;
+    ev.station = static_cast<int32_t>(uniform(s, -1.0, 4.0));
+    ev.seq = static_cast<uint64_t>(uniform(s, 0.0, 1e6));
+    ev.type = DesEventType::PACKET_SEND;
+    return ev;
+}
+
+void test_calendar_queue_pops_in_order() {
+    // A hold model like the DES: pop the earliest, schedule later ones.
+    // Bursts at one instant, long idle jumps and the growth and shrink
+    // of the ring (and the width re-estimate each time) all go through it
+    uint64_t s = 2024;
+    CalendarQueue queue;
+    std::multiset<DesEvent> ref;
+    auto push = [&](const DesEvent& ev) {
+        queue.push(ev);
+        ref.insert(ev);
+    };
+    for (int i = 0; i < 200; i++) push(desEvent(s, uniform(s, 0.0, 0.01)));
+
+    double now = 0.0;
+    size_t pops = 0, max_size = 0;
+    for (int step = 0; step < 60000; step++) {
+        bool grow = step < 20000 || (step >= 40000 && step < 45000);
+        int births = grow ? static_cast<int>(uniform(s, 0.0, 4.0)) : (step % 2);
+        for (int n = 0; n < births; n++) {
+            double r = uniform(s, 0.0, 1.0);
+            double t = r < 0.2 ? now : r < 0.25 ? now + uniform(s, 1.0, 50.0)
+                                                : now + uniform(s, 0.0, 0.05);
+            push(desEvent(s, t));
+        }
+        max_size = std::max(max_size, queue.size());
+        if (queue.empty()) continue;
+        DesEvent ev = queue.pop();
+        pops++;
+        assert(!(ev < *ref.begin()) && !(*ref.begin() < ev));
+        assert(ev.time >= now);
+        now = ev.time;
+        ref.erase(ref.begin());
+    }
+    while (!queue.empty()) {
+        DesEvent ev = queue.pop();
+        assert(!(ev < *ref.begin()) && !(*ref.begin() < ev));
+        ref.erase(ref.begin());
+        pops++;
+    }
+    assert(ref.empty() && max_size > 1000);
+    std::cout << "  PASS: " << pops << " events popped in (time, station, seq) order, "
+              << "up to " << max_size << " pending\n";
+}
+
+void test_calendar_queue_ignores_insertion_order() {
+    // Ties on time resolve by station and sequence, so the pop order is
+    // a function of the events alone
+    uint64_t s = 7;
+    std::vector<DesEvent> events;
+    for (int i = 0; i < 5000; i++) {
+        DesEvent ev = desEvent(s, std::floor(uniform(s, 0.0, 40.0)) * 0.25);
+        ev.seq = static_cast<uint64_t>(i);
+        ev.data = static_cast<uint64_t>(i);
+        events.push_back(ev);
+    }
+    auto drain = [](const std::vector<DesEvent>& in) {
+        CalendarQueue queue;
+        for (const auto& ev : in) queue.push(ev);
+        std::vector<uint64_t> order;
+        while (!queue.empty()) order.push_back(queue.pop().data);
+        return order;
+    };
+    auto expected = drain(events);
+    std::reverse(events.begin(), events.end());
+    assert(drain(events) == expected);
+    std::mt19937 rng(3);
+    for (int k = 0; k < 5; k++) {
+        std::shuffle(events.begin(), events.end(), rng);
+        assert(drain(events) == expected);
+    }
+    std::cout << "  PASS: 5000 events with tied times pop identically in 7 insertion orders\n";
+}
+
+// Point `dist_rad` of central angle from `from` along bearing `bearing_rad`
+viz::GeoCoord destination(const viz::GeoCoord& from, double bearing_rad, double dist_rad) {
+    double lat1 = from.lat_deg * DEG_TO_RAD;
+    double lat2 = std::asin(std::sin(lat1) * std::cos(dist_rad) +
+                            std::cos(lat1) * std::sin(dist_rad) * std::cos(bearing_rad));
+    double dlon = std::atan2(std::sin(bearing_rad) * std::sin(dist_rad) * std::cos(lat1),
+                             std::cos(dist_rad) - std::sin(lat1) * std::sin(lat2));
+    double lon = std::fmod(from.lon_deg + dlon * RAD_TO_DEG + 540.0, 360.0) - 180.0;
+    return {lat2 * RAD_TO_DEG, lon};
+}
+
+void test_fast_edges_match_double() {
+    // Random satellites over random stations, plus satellites placed on
+    // each mask's coverage circle and just either side of it: inside the
+    // float filter's COS_BAND they must be settled by the double recheck
+    constexpr double ALTITUDES[] = {525.0, 540.0, 550.0, 560.0, 570.0};
+    constexpr double MASKS[] = {10.0, 25.0, 40.0, 60.0};
+    constexpr double OFFSETS[] = {-1e-3, -1e-4, -3e-5, -1e-6, -1e-8, 0.0,
+                                  1e-8, 1e-6, 3e-5, 1e-4, 1e-3};
+    uint64_t s = 31337;
+    std::vector<viz::GroundStation> stations;
+    for (int g = 0; g < 40; g++) {
+        viz::GeoCoord pos{std::asin(uniform(s, -1.0, 1.0)) * RAD_TO_DEG, uniform(s, -180.0, 180.0)};
+        stations.push_back({g, pos, "station", 25.0, 10000.0, nullptr});
+    }
+    std::vector<viz::Satellite> sats;
+    auto addSat = [&](const viz::GeoCoord& pos, double alt) {
+        sats.push_back({static_cast<int>(sats.size()), pos, alt, 0, 0, 250.0, 0.0, 0.0, 0.0});
+    };
+    for (int i = 0; i < 3000; i++) {
+        addSat({std::asin(uniform(s, -1.0, 1.0)) * RAD_TO_DEG, uniform(s, -180.0, 180.0)},
+               ALTITUDES[i % 5]);
+    }
+    struct Placed {
+        int sat, station;
+        double mask, offset;
+    };
+    std::vector<Placed> placed;
+    for (double mask : MASKS) {
+        for (int k = 0; k < 20; k++) {
+            const auto& gs = stations[k];
+            double alt = ALTITUDES[k % 5];
+            double lambda = std::acos(viz::coverageCos(alt, mask));
+            double bearing = uniform(s, 0.0, 2.0 * M_PI);
+            for (double off : OFFSETS) {
+                placed.push_back({static_cast<int>(sats.size()), k, mask, off});
+                addSat(destination(gs.position, bearing, lambda + off), alt);
+            }
+        }
+    }
+
+    for (double mask : MASKS) {
+        viz::VisibilityStats ref_stats, fast_stats;
+        viz::FastVisibilityStats fast;
+        auto ref = viz::buildVisibilityEdges(sats, stations, mask, ref_stats);
+        auto got = viz::buildVisibilityEdgesFast(sats, stations, mask, fast_stats, fast);
+        assert(ref.size() == got.size());
+        std::set<std::pair<int, int>> seen;
+        for (size_t i = 0; i < ref.size(); i++) {
+            assert(ref[i].satellite_id == got[i].satellite_id);
+            assert(ref[i].station_id == got[i].station_id);
+            assert(ref[i].elevation_deg == got[i].elevation_deg);
+            assert(ref[i].slant_km == got[i].slant_km);
+            seen.insert({got[i].satellite_id, got[i].station_id});
+        }
+        assert(ref_stats.coverage_counts == fast_stats.coverage_counts);
+        assert(fast.band_rechecks > 0 && fast.float_rejected > 0);
+        // The placed satellites really straddle this mask's circle
+        for (const auto& p : placed) {
+            if (p.mask != mask || std::abs(p.offset) < 1e-6) continue;
+            assert(seen.count({p.sat, p.station}) == (p.offset < 0.0));
+        }
+        std::cout << "  PASS: mask " << mask << " deg: " << got.size()
+                  << " edges identical to double, " << fast.band_rechecks << " band rechecks\n";
+    }
+}
+
+bool sameDesStats(const viz::DesStationStats& a, const viz::DesStationStats& b) {
+    return a.sent == b.sent && a.carried == b.carried && a.outage == b.outage &&
+           a.delivered == b.delivered && a.reordered == b.reordered && a.late == b.late &&
+           a.lost == b.lost && a.handoffs == b.handoffs && a.blocked == b.blocked &&
+           a.latency_ms_sum == b.latency_ms_sum && a.served_sec == b.served_sec;
+}
+
+void test_des_parallel_matches_sequential() {
+    // Sixty stations within a degree share the two or three satellites
+    // above a 60 deg mask, one beam each, so handoffs find them full:
+    // load board messages between workers decide who gets the beam
+    viz::DesConfig cfg;
+    cfg.duration_sec = 120.0;
+    cfg.packet_rate = 10.0;
+    cfg.beams = 1;
+    cfg.min_elevation_deg = 60.0;
+    uint64_t s = 5;
+    std::vector<viz::GroundStation> stations;
+    for (int g = 0; g < 60; g++) {
+        stations.push_back({g, {47.6 + uniform(s, -1.0, 1.0), -122.3 + uniform(s, -1.0, 1.0)},
+                            "station", 25.0, 10000.0, nullptr});
+    }
+
+    viz::DesSimulation seq(cfg, stations), again(cfg, stations);
+    viz::DesRun seq_run = viz::runDesSequential(seq);
+    viz::DesRun again_run = viz::runDesSequential(again);
+    uint64_t blocked = 0, handoffs = 0;
+    for (size_t g = 0; g < stations.size(); g++) {
+        assert(sameDesStats(seq.stats(g), again.stats(g)));
+        blocked += seq.stats(g).blocked;
+        handoffs += seq.stats(g).handoffs;
+    }
+    assert(seq_run.events() == again_run.events());
+    assert(blocked > 0);
+
+    for (int workers : {2, 3, 5}) {
+        viz::DesSimulation par(cfg, stations);
+        viz::DesRun par_run = viz::runDesParallel(par, workers);
+        assert(par_run.windows > 0);
+        for (int t = 0; t < static_cast<int>(DesEventType::COUNT); t++) {
+            assert(par_run.counts[t] == seq_run.counts[t]);
+        }
+        for (size_t g = 0; g < stations.size(); g++) {
+            assert(sameDesStats(par.stats(g), seq.stats(g)));
+        }
+    }
+    std::cout << "  PASS: " << seq_run.events() << " events, " << handoffs << " handoffs ("
+              << blocked << " blocked): same per-station stats sequentially twice and on "
+              << "2, 3 and 5 workers\n";
+}
+
+// Where a satellite at `alt` km must be to appear at `az_deg`, `elev_deg`
+viz::GeoCoord placeAt(const viz::GeoCoord& station, double az_deg, double elev_deg, double alt) {
+    double e = elev_deg * DEG_TO_RAD;
+    double lambda = M_PI / 2 - e -
+                    std::asin(EARTH_RADIUS_KM * std::cos(e) / (EARTH_RADIUS_KM + alt));
+    return destination(station, az_deg * DEG_TO_RAD, lambda);
+}
+
+void test_horizon_filter_matches_reference() {
+    // One station per band of the SSE filter, each with satellites just
+    // either side of the decision it guards
+    constexpr double ALT = 550.0;
+    constexpr double GLOBAL_MASK = 10.0;
+    auto terrain = std::make_shared<viz::HorizonMask>();  // AZ_BAND: bins alternate 15/35 deg
+    for (int b = 0; b < viz::HorizonMask::BINS; b++) terrain->min_elev_deg[b] = b % 2 ? 35.0f : 15.0f;
+    auto wall = std::make_shared<viz::HorizonMask>();     // ELEV_BAND: 30 deg but for a gap
+    wall->min_elev_deg.fill(30.0f);                      // at north, which keeps the floor
+    wall->min_elev_deg[0] = 10.0f;                       // below 30 and the pairs in SSE
+    auto cone = std::make_shared<viz::HorizonMask>();     // COS_BAND: 30 deg cone at az 120, el 50
+    cone->boresight_az_deg = 120.0;
+    cone->boresight_el_deg = 50.0;
+    cone->fov_half_deg = 30.0;
+    auto zenith = std::make_shared<viz::HorizonMask>();   // HORIZ_SQ_MIN: every other bin
+    for (int b = 0; b < viz::HorizonMask::BINS; b++) {   // blocked short of the zenith, and
+        zenith->min_elev_deg[b] = b % 2 ? 90.0f : 15.0f;  // a 5 deg cone straight up
+    }
+    zenith->fov_half_deg = 5.0;
+
+    std::vector<viz::GroundStation> stations;
+    const std::shared_ptr<viz::HorizonMask> masks[] = {terrain, wall, cone, zenith};
+    for (int g = 0; g < 4; g++) {
+        stations.push_back({g, {10.0 + 15.0 * g, -40.0 + 50.0 * g}, "masked", 25.0, 100.0,
+                            masks[g]});
+    }
+    std::vector<viz::Satellite> sats;
+    auto addSat = [&](int g, double az, double elev) {
+        az = std::fmod(az + 360.0, 360.0);
+        sats.push_back({static_cast<int>(sats.size()), placeAt(stations[g].position, az, elev, ALT),
+                        ALT, 0, 0, 250.0, 0.0, 0.0, 0.0});
+    };
+    uint64_t s = 4242;
+    for (int b = 0; b < 360; b += 7) {
+        for (double d : {-0.02, -0.004, -1e-5, 1e-5, 0.004, 0.02}) addSat(0, b + d, 25.0);
+    }
+    for (int k = 0; k < 60; k++) {
+        double az = uniform(s, 10.0, 350.0);
+        for (double d : {-1e-2, -2e-4, -5e-5, -1e-6, -3e-7, 3e-7, 1e-6, 5e-5, 2e-4, 1e-2}) {
+            addSat(1, az, 30.0 + d);
+        }
+    }
+    for (int k = 0; k < 60; k++) {
+        // Rotate the boresight by 30 deg +- d toward a random side
+        double side = uniform(s, 0.0, 2.0 * M_PI);
+        for (double d : {-0.05, -1e-3, -1e-5, -1e-7, 1e-7, 1e-5, 1e-3, 0.05}) {
+            double a = cone->boresight_az_deg * DEG_TO_RAD, e = cone->boresight_el_deg * DEG_TO_RAD;
+            double th = (30.0 + d) * DEG_TO_RAD;
+            double b[3] = {std::cos(e) * std::sin(a), std::cos(e) * std::cos(a), std::sin(e)};
+            double p[3] = {std::cos(a), -std::sin(a), 0.0};   // horizontal, across the boresight
+            double q[3] = {b[1] * p[2] - b[2] * p[1], b[2] * p[0] - b[0] * p[2],
+                           b[0] * p[1] - b[1] * p[0]};
+            double v[3];
+            for (int i = 0; i < 3; i++) {
+                v[i] = std::cos(th) * b[i] + std::sin(th) * (std::cos(side) * p[i] + std::sin(side) * q[i]);
+            }
+            addSat(2, std::atan2(v[0], v[1]) * RAD_TO_DEG, std::asin(v[2]) * RAD_TO_DEG);
+        }
+    }
+    for (double elev : {83.0, 84.9, 84.99, 84.999, 85.001, 85.01, 85.1, 87.0, 90.0}) {
+        for (int k = 0; k < 8; k++) addSat(3, uniform(s, 0.0, 360.0), elev);
+    }
+    for (double elev : {89.6, 89.9, 89.99, 89.999, 89.9999}) {
+        for (int k = 0; k < 8; k++) {
+            double b = std::floor(uniform(s, 0.0, 360.0));
+            for (double d : {-0.1, -1e-3, 1e-3, 0.1}) addSat(3, b + d, elev);
+        }
+    }
+
+    // Stage every pair above the global mask, as forEachVisiblePair does
+    viz::HorizonFilter filter(sats, stations);
+    viz::FastVisibilityStats fast;
+    struct Staged {
+        size_t i, g;
+        double elev;
+        int slot;
+    };
+    std::vector<Staged> staged;
+    for (size_t i = 0; i < sats.size(); i++) {
+        auto u = viz::geoTo3D<float>(static_cast<float>(sats[i].position.lat_deg),
+                                     static_cast<float>(sats[i].position.lon_deg), 0.0f);
+        for (size_t g = 0; g < stations.size(); g++) {
+            double elev = viz::computeElevationAngle(stations[g].position, sats[i].position, ALT);
+            if (elev < GLOBAL_MASK) continue;
+            staged.push_back({i, g, elev, filter.stage(i, g, elev, u)});
+        }
+    }
+    filter.evaluate(fast);
+    int admitted[4] = {}, rejected[4] = {};
+    for (const auto& p : staged) {
+        bool want = viz::horizonAdmits(*stations[p.g].horizon, stations[p.g], sats[p.i], p.elev);
+        bool got = p.slot >= 0 && filter.admitted(p.slot);
+        assert(p.slot != viz::HorizonFilter::NO_MASK);
+        assert(got == want);
+        (want ? admitted : rejected)[p.g]++;
+    }
+    for (int g = 0; g < 4; g++) assert(admitted[g] > 0 && rejected[g] > 0);
+    assert(fast.horizon_rechecks > 0 && fast.horizon_rechecks < fast.horizon_lookups);
+
+    // And the whole float path against the double one
+    viz::VisibilityStats ref_stats, got_stats;
+    viz::FastVisibilityStats edge_fast;
+    auto ref = viz::buildVisibilityEdges(sats, stations, GLOBAL_MASK, ref_stats);
+    auto got = viz::buildVisibilityEdgesFast(sats, stations, GLOBAL_MASK, got_stats, edge_fast);
+    assert(ref.size() == got.size());
+    for (size_t i = 0; i < ref.size(); i++) {
+        assert(ref[i].satellite_id == got[i].satellite_id && ref[i].station_id == got[i].station_id);
+    }
+    std::cout << "  PASS: " << staged.size() << " pairs at bin edges, the mask, the cone edge "
+              << "and zenith agree with horizonAdmits (" << fast.horizon_rechecks
+              << " rechecked)\n";
+}
+
+void test_top_k_matches_full_sort() {
+    uint64_t s = 808;
+    std::vector<viz::GroundStation> stations;
+    for (int g = 0; g < 50; g++) {
+        viz::GeoCoord pos{std::asin(uniform(s, -0.8, 0.8)) * RAD_TO_DEG, uniform(s, -180.0, 180.0)};
+        stations.push_back({g, pos, "station", 25.0, 100.0, nullptr});
+    }
+    std::vector<viz::Satellite> sats;
+    for (int i = 0; i < 4000; i++) {
+        viz::GeoCoord pos{std::asin(uniform(s, -1.0, 1.0)) * RAD_TO_DEG, uniform(s, -180.0, 180.0)};
+        sats.push_back({i, pos, 540.0 + 10.0 * (i % 4), 0, 0, 250.0, 0.0, 0.0, 0.0});
+    }
+    viz::VisibilityStats stats;
+    auto all = viz::buildVisibilityEdges(sats, stations, 25.0, stats);
+
+    for (viz::TopKBy by : {viz::TopKBy::ELEVATION, viz::TopKBy::LATENCY}) {
+        std::vector<std::vector<viz::VisibilityEdge>> full(stations.size());
+        for (const auto& e : all) full[e.station_id].push_back(e);
+        for (auto& v : full) {
+            std::sort(v.begin(), v.end(), [by](const auto& a, const auto& b) {
+                return viz::ranksAhead(a, b, by);
+            });
+        }
+        for (int k : {0, 1, 3, 8, 1000}) {
+            viz::FastVisibilityStats fast;
+            auto top = viz::topKVisibility(sats, stations, 25.0, k, by, fast);
+            for (size_t g = 0; g < stations.size(); g++) {
+                size_t want = std::min(full[g].size(), static_cast<size_t>(std::max(k, 0)));
+                assert(static_cast<size_t>(top.count[g]) == want);
+                for (size_t r = 0; r < want; r++) {
+                    const auto& got = top.station(g)[r];
+                    assert(got.satellite_id == full[g][r].satellite_id);
+                    assert(got.elevation_deg == full[g][r].elevation_deg);
+                    assert(got.slant_km == full[g][r].slant_km);
+                }
+            }
+        }
+    }
+    std::cout << "  PASS: top-k for k = 0, 1, 3, 8, 1000 by elevation and latency matches "
+              << all.size() << " edges sorted per station\n";
+}
+
 int main() {
     std::cout << "=== Satellite Visibility Tests ===\n\n";
 
@@ -123,6 +4012,48 @@ int main() {
     test_elevation_at_starlink_altitude();
     test_elevation_symmetry();
 
+    std::cout << "\nPolynomial Trig:\n";
+    test_poly_trig_ulp_bounds();
+    test_poly_trig_edge_cases();
+    test_poly_elevation_matches_libm();
+
+    std::cout << "\nForward Error Correction:\n";
+    test_fec_partial_last_block();
+    test_fec_recovers_in_partial_block();
+    test_fec_early_rebuild_is_not_a_loss();
+
+    std::cout << "\nHandoff Scheduling:\n";
+    test_handoff_chain_covers_horizon();
+    test_handoff_prefers_coverage_over_signal();
+    test_backup_chains_are_link_disjoint();
+    test_backup_uses_pass_outside_primary_segment();
+
+    std::cout << "\nCounter-Based RNG:\n";
+    test_philox_known_answers();
+    test_philox_counter_layout();
+
+    std::cout << "\nEDF Egress:\n";
+    test_edf_order_across_bucket_wrap();
+
+    std::cout << "\nWindow Index:\n";
+    test_window_index_matches_scan();
+    test_window_index_counts_out_of_range();
+
+    std::cout << "\nActive Queue Management:\n";
+    test_codel_drop_state_entry_and_exit();
+
+    std::cout << "\nVisibility Edges:\n";
+    test_fast_edges_match_double();
+
+    test_horizon_filter_matches_reference();
+    test_top_k_matches_full_sort();
+
+    std::cout << "\nDiscrete-Event Queue:\n";
+    test_calendar_queue_pops_in_order();
+    test_calendar_queue_ignores_insertion_order();
+
+    test_des_parallel_matches_sequential();
+
     std::cout << "\n=== All tests passed ===\n";
     return 0;
 }